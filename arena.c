@@ -0,0 +1,83 @@
+// arena.c
+// Implementation of functions in arena.h
+
+#include "arena.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+struct arena ast_arena = {0, 0};
+
+// Bytes requested from malloc at a time
+size_t arena_chunk_size = 1 << 20;
+
+// Returns size bytes aligned for any node, valid until the arena is released
+void* arena_alloc(struct arena* a, size_t size) {
+
+	size = (size + 7) & ~(size_t) 7;
+
+	// Requests larger than a quarter chunk get a chunk of their own, kept
+	// behind the current one so its free space is not lost
+	if (size > arena_chunk_size / 4) {
+		struct arena_chunk* large = arena_new_chunk(size);
+		large->used = size;
+		if (a->chunks) {
+			large->next = a->chunks->next;
+			a->chunks->next = large;
+		}
+		else {
+			a->chunks = large;
+		}
+		a->bytes += size;
+		return large->data;
+	}
+
+	struct arena_chunk* c = a->chunks;
+	if (!c || c->used + size > c->size) {
+		c = arena_new_chunk(arena_chunk_size);
+		c->next = a->chunks;
+		a->chunks = c;
+	}
+
+	void* p = c->data + c->used;
+	c->used += size;
+	a->bytes += size;
+
+	return p;
+}
+
+struct arena_chunk* arena_new_chunk(size_t size) {
+
+	struct arena_chunk* c = malloc(sizeof(struct arena_chunk) + size);
+	if (!c) {
+		printf("Error: Out of memory. Exiting...\n");
+		exit(1);
+	}
+
+	c->next = 0;
+	c->size = size;
+	c->used = 0;
+
+	return c;
+}
+
+char* arena_strdup(struct arena* a, const char* s) {
+
+	size_t length = strlen(s) + 1;
+	char* copy = arena_alloc(a, length);
+	memcpy(copy, s, length);
+
+	return copy;
+}
+
+// Free everything allocated from a
+void arena_release(struct arena* a) {
+
+	while(a->chunks) {
+		struct arena_chunk* next = a->chunks->next;
+		free(a->chunks);
+		a->chunks = next;
+	}
+	a->bytes = 0;
+
+}
@@ -0,0 +1,32 @@
+// arena.h
+// Header file for arena allocation, which carves the nodes of a compilation
+// unit out of large chunks and releases them all at once
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+struct arena_chunk {
+	struct arena_chunk* next;
+	size_t size;
+	size_t used;
+	char data[];
+};
+
+struct arena {
+	struct arena_chunk* chunks;
+	size_t bytes;
+};
+
+// Holds the syntax tree, types, symbols and their strings
+extern struct arena ast_arena;
+
+extern size_t arena_chunk_size;
+
+void* arena_alloc(struct arena* a, size_t size);
+struct arena_chunk* arena_new_chunk(size_t size);
+char* arena_strdup(struct arena* a, const char* s);
+void arena_release(struct arena* a);
+
+#endif
@@ -0,0 +1,881 @@
+// cgen.c
+// Implementation of functions in cgen.h
+// Names are kept where C allows them. Names made by the optimizer contain
+// dots, and names that C reserves take a trailing underscore, as do names
+// that would then collide with another.
+// C leaves the order in which operands are evaluated unspecified, while the
+// generated assembly goes from left to right, except that an assignment
+// computes its value before the place it stores into. Where an operand has
+// side effects, whatever the assembly evaluates first is saved to a
+// temporary.
+
+#include "cgen.h"
+#include "type.h"
+#include "symbol.h"
+#include "param_list.h"
+#include "effects.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+// Names of globals and functions in the C source
+struct hash_table* cgen_globals = 0;
+
+// Names taken at file scope, which locals may not shadow
+struct hash_table* cgen_used = 0;
+
+// Keywords of C99 and names the translation declares itself
+const char* cgen_reserved[] = {
+	"auto", "break", "case", "char", "const", "continue", "default", "do", "double", "else", "enum", "extern",
+	"float", "for", "goto", "if", "inline", "int", "long", "register", "restrict", "return", "short", "signed",
+	"sizeof", "static", "struct", "switch", "typedef", "union", "unsigned", "void", "volatile", "while",
+	"_Bool", "_Complex", "_Imaginary", "bool", "true", "false", "main", "memcpy", "memset"
+};
+
+// Functions of library.c, with the types it defines them with
+const char* cgen_runtime[] = {
+	"void print_integer(long x);",
+	"void print_string(const char* s);",
+	"void print_boolean(int b);",
+	"void print_character(char c);",
+	"long integer_power(long x, long y);",
+	"long string_length(const char* s);",
+	"long string_hash(const char* s);",
+	"long string_equals(const char* s1, const char* s2);"
+};
+
+// Write the program as one C source file, to be compiled with library.c
+void cgen_program(struct decl* program, const char* source, FILE* fp) {
+
+	cgen_globals = hash_table_create(0, 0);
+	cgen_used = hash_table_create(0, 0);
+
+	int i;
+	for(i = 0; i < (int) (sizeof(cgen_reserved) / sizeof(cgen_reserved[0])); i++) {
+		hash_table_insert(cgen_used, cgen_reserved[i], (void*) 1);
+	}
+
+	// Names written in the program come first, so they keep their spelling
+	cgen_name_globals(program, 0);
+	cgen_name_globals(program, 1);
+
+	fprintf(fp, "// Generated by cminor -emit-c from %s\n", source);
+	fprintf(fp, "// Build with gcc -O2 -fwrapv, which makes integers wrap around as they\n");
+	fprintf(fp, "// do in the generated assembly, and link with library.c\n\n");
+	fprintf(fp, "#include <stdbool.h>\n");
+	fprintf(fp, "#include <string.h>\n\n");
+	for(i = 0; i < (int) (sizeof(cgen_runtime) / sizeof(cgen_runtime[0])); i++) {
+		fprintf(fp, "%s\n", cgen_runtime[i]);
+	}
+	fprintf(fp, "\n");
+
+	// Functions may be called before they are defined
+	struct decl* d;
+	for(d = program; d; d = d->next) {
+		if (d->type->kind == TYPE_FUNCTION && (d->code || (!decl_find_function(program, d->name) && !cgen_is_runtime(d->name)))) {
+			cgen_prototype(0, d, fp);
+			fprintf(fp, ";\n");
+		}
+	}
+	fprintf(fp, "\n");
+
+	for(d = program; d; d = d->next) {
+		if (d->type->kind != TYPE_FUNCTION) {
+			cgen_global(d, fp);
+		}
+	}
+
+	for(d = program; d; d = d->next) {
+		if (d->type->kind == TYPE_FUNCTION && d->code) {
+			fprintf(fp, "\n");
+			cgen_function(d, fp);
+		}
+	}
+
+	// The exit status is the low byte of what main returns, as with the
+	// generated assembly
+	struct decl* main_function = decl_find_function(program, "main");
+	if (main_function) {
+		const char* name = hash_table_lookup(cgen_globals, "main");
+		int with_arguments = main_function->type->params != 0;
+		fprintf(fp, "\nint main(int argc, char** argv) {\n");
+		if (main_function->type->subtype->kind == TYPE_VOID) {
+			fprintf(fp, "\t%s(%s);\n", name, (with_arguments) ? "argc, (const char**) argv" : "");
+			fprintf(fp, "\treturn 0;\n");
+		}
+		else {
+			fprintf(fp, "\treturn %s(%s);\n", name, (with_arguments) ? "argc, (const char**) argv" : "");
+		}
+		fprintf(fp, "}\n");
+	}
+
+	hash_table_delete(cgen_globals);
+	hash_table_delete(cgen_used);
+	cgen_globals = 0;
+	cgen_used = 0;
+
+}
+
+// Choose the C names of the globals whose names contain a dot if dotted is set,
+// or of the others if not
+void cgen_name_globals(struct decl* program, int dotted) {
+
+	struct decl* d;
+	for(d = program; d; d = d->next) {
+		if ((strchr(d->name, '.') != 0) != dotted || hash_table_lookup(cgen_globals, d->name)) {
+			continue;
+		}
+
+		// Functions defined elsewhere must keep their names to link
+		const char* name;
+		if (d->type->kind == TYPE_FUNCTION && !decl_find_function(program, d->name)) {
+			name = d->name;
+			hash_table_insert(cgen_used, name, (void*) 1);
+		}
+		else {
+			name = cgen_name(cgen_used, d->name);
+		}
+
+		hash_table_insert(cgen_globals, d->name, name);
+	}
+
+}
+
+// Write the signature of function d, naming its parameters if f is the
+// translation of its body
+void cgen_prototype(struct cgen_function* f, struct decl* d, FILE* fp) {
+
+	fprintf(fp, "%s%s %s(", (d->code) ? "static " : "", cgen_type(d->type->subtype), (const char*) hash_table_lookup(cgen_globals, d->name));
+
+	if (!d->type->params) {
+		fprintf(fp, "void");
+	}
+
+	struct param_list* p;
+	for(p = d->type->params; p; p = p->next) {
+		fprintf(fp, "%s%s", (p == d->type->params) ? "" : ", ", cgen_type(p->type));
+		if (f) {
+			fprintf(fp, " %s", cgen_variable(f, p->symbol));
+		}
+	}
+
+	fprintf(fp, ")");
+
+}
+
+void cgen_global(struct decl* d, FILE* fp) {
+
+	if (d->value && !decl_value_is_constant(d->value)) {
+		printf("codegen error: initializer of global %s is not a compile-time constant (", d->name);
+		expr_print(d->value, 0);
+		printf(")\n");
+		exit(1);
+	}
+
+	fprintf(fp, "static ");
+	cgen_declare(d->type, hash_table_lookup(cgen_globals, d->name), fp);
+
+	// Strings default to the empty string rather than a null pointer
+	if (d->type->kind == TYPE_ARRAY && d->value) {
+		fprintf(fp, " = {");
+		struct expr* e;
+		for(e = d->value->right; e; e = e->next) {
+			fprintf(fp, "%s", (e == d->value->right) ? "" : ", ");
+			cgen_literal(e, fp);
+		}
+		fprintf(fp, "}");
+	}
+	else if (d->type->kind == TYPE_ARRAY && d->type->subtype->kind == TYPE_STRING) {
+		fprintf(fp, " = {");
+		int i;
+		for(i = 0; i < d->type->size->literal_value; i++) {
+			fprintf(fp, "%s\"\"", (i) ? ", " : "");
+		}
+		fprintf(fp, "}");
+	}
+	else if (d->value) {
+		fprintf(fp, " = ");
+		cgen_literal(d->value, fp);
+	}
+	else if (d->type->kind == TYPE_STRING) {
+		fprintf(fp, " = \"\"");
+	}
+
+	fprintf(fp, ";\n");
+
+}
+
+void cgen_function(struct decl* d, FILE* fp) {
+
+	struct cgen_function f;
+	f.decl = d;
+	f.locals = hash_table_create(0, 0);
+	f.used = hash_table_create(0, 0);
+	f.temporaries = 0;
+	f.decls = open_memstream(&f.decls_text, &f.decls_size);
+
+	// Parameters are named first, keeping their spelling where they can
+	struct param_list* p;
+	for(p = d->type->params; p; p = p->next) {
+		cgen_variable(&f, p->symbol);
+	}
+
+	char* body_text;
+	size_t body_size;
+	FILE* body = open_memstream(&body_text, &body_size);
+	cgen_stmt(&f, d->code, body, 1);
+	fclose(body);
+	fclose(f.decls);
+
+	cgen_prototype(&f, d, fp);
+	fprintf(fp, " {\n");
+	if (f.decls_size) {
+		fprintf(fp, "%s\n", f.decls_text);
+	}
+	fprintf(fp, "%s}\n", body_text);
+
+	free(body_text);
+	free(f.decls_text);
+	hash_table_delete(f.locals);
+	hash_table_delete(f.used);
+
+}
+
+// Write the statements in list s
+void cgen_stmt(struct cgen_function* f, struct stmt* s, FILE* fp, int indent) {
+
+	for(; s; s = s->next) {
+		switch(s->kind) {
+			case STMT_DECL:
+				cgen_decl(f, s->decl, fp, indent);
+				break;
+			case STMT_EXPR:
+				cgen_indent(indent, fp);
+				cgen_expr(f, s->expr, fp, 1);
+				fprintf(fp, ";\n");
+				break;
+			case STMT_IF_ELSE:
+				cgen_indent(indent, fp);
+				fprintf(fp, "if (");
+				cgen_expr(f, s->expr, fp, 1);
+				fprintf(fp, ")");
+				cgen_body(f, s->body, fp, indent);
+				if (s->else_body) {
+					cgen_indent(indent, fp);
+					fprintf(fp, "else");
+					cgen_body(f, s->else_body, fp, indent);
+				}
+				break;
+			case STMT_FOR:
+				cgen_indent(indent, fp);
+				fprintf(fp, "for (");
+				if (s->init_expr) {
+					cgen_expr(f, s->init_expr, fp, 1);
+				}
+				fprintf(fp, ";");
+				if (s->expr) {
+					fprintf(fp, " ");
+					cgen_expr(f, s->expr, fp, 1);
+				}
+				fprintf(fp, ";");
+				if (s->next_expr) {
+					fprintf(fp, " ");
+					cgen_expr(f, s->next_expr, fp, 1);
+				}
+				fprintf(fp, ")");
+				cgen_body(f, s->body, fp, indent);
+				break;
+			case STMT_PRINT:
+				cgen_print(f, s->expr, fp, indent);
+				break;
+			case STMT_RETURN:
+				cgen_indent(indent, fp);
+				fprintf(fp, "return");
+				if (s->expr) {
+					fprintf(fp, " ");
+					cgen_expr(f, s->expr, fp, 1);
+				}
+				fprintf(fp, ";\n");
+				break;
+			case STMT_BLOCK:
+				cgen_indent(indent, fp);
+				fprintf(fp, "{\n");
+				cgen_stmt(f, s->body, fp, indent + 1);
+				cgen_indent(indent, fp);
+				fprintf(fp, "}\n");
+				break;
+		}
+	}
+
+}
+
+// Write the body of an if, else or for as a braced block
+void cgen_body(struct cgen_function* f, struct stmt* s, FILE* fp, int indent) {
+
+	fprintf(fp, " {\n");
+	if (s) {
+		cgen_stmt(f, (s->kind == STMT_BLOCK) ? s->body : s, fp, indent + 1);
+	}
+	cgen_indent(indent, fp);
+	fprintf(fp, "}\n");
+
+}
+
+// Write the initialization of local d, which is declared at the top
+void cgen_decl(struct cgen_function* f, struct decl* d, FILE* fp, int indent) {
+
+	const char* name = cgen_variable(f, d->symbol);
+
+	if (d->type->kind == TYPE_ARRAY) {
+		if (d->value && d->value->kind == EXPR_ARRAY_INITIALIZER) {
+			printf("codegen error: local arrays not supported\n");
+			exit(1);
+		}
+
+		cgen_indent(indent, fp);
+		if (d->value) {
+			fprintf(fp, "memcpy(%s, ", name);
+			cgen_expr(f, d->value, fp, 1);
+			fprintf(fp, ", sizeof(%s));\n", name);
+		}
+		else {
+			fprintf(fp, "memset(%s, 0, sizeof(%s));\n", name, name);
+		}
+	}
+	else if (d->value) {
+		cgen_indent(indent, fp);
+		fprintf(fp, "%s = ", name);
+		cgen_expr(f, d->value, fp, 0);
+		fprintf(fp, ";\n");
+	}
+
+}
+
+// Write expression e, in parentheses unless it is top, which is directly
+// under a statement or an argument list
+void cgen_expr(struct cgen_function* f, struct expr* e, FILE* fp, int top) {
+
+	struct expr* args[2];
+
+	switch(e->kind) {
+		case EXPR_INTEGER_LITERAL:
+		case EXPR_CHAR_LITERAL:
+		case EXPR_STRING_LITERAL:
+		case EXPR_TRUE:
+		case EXPR_FALSE:
+			if (e->kind == EXPR_INTEGER_LITERAL && e->literal_value < 0 && !top) {
+				fprintf(fp, "(");
+				cgen_literal(e, fp);
+				fprintf(fp, ")");
+			}
+			else {
+				cgen_literal(e, fp);
+			}
+			break;
+		case EXPR_NAME:
+			fprintf(fp, "%s", cgen_variable(f, e->symbol));
+			break;
+		case EXPR_PLUS:
+			cgen_binary(f, e, "+", fp, top);
+			break;
+		case EXPR_MINUS:
+			cgen_binary(f, e, "-", fp, top);
+			break;
+		case EXPR_MULT:
+			cgen_binary(f, e, "*", fp, top);
+			break;
+		case EXPR_DIVIDE:
+			cgen_binary(f, e, "/", fp, top);
+			break;
+		case EXPR_MODULUS:
+			cgen_binary(f, e, "%", fp, top);
+			break;
+		case EXPR_LT:
+			cgen_binary(f, e, "<", fp, top);
+			break;
+		case EXPR_LE:
+			cgen_binary(f, e, "<=", fp, top);
+			break;
+		case EXPR_GT:
+			cgen_binary(f, e, ">", fp, top);
+			break;
+		case EXPR_GE:
+			cgen_binary(f, e, ">=", fp, top);
+			break;
+		// Both sides of && and || are evaluated, as in the generated assembly
+		case EXPR_AND:
+			cgen_binary(f, e, "&", fp, top);
+			break;
+		case EXPR_OR:
+			cgen_binary(f, e, "|", fp, top);
+			break;
+		case EXPR_EQUAL:
+		case EXPR_NE:
+			if (cgen_is_string(e->left)) {
+				args[0] = e->left;
+				args[1] = e->right;
+				cgen_call(f, "string_equals", (e->kind == EXPR_NE) ? "!" : "", args, 2, fp);
+			}
+			else {
+				cgen_binary(f, e, (e->kind == EXPR_NE) ? "!=" : "==", fp, top);
+			}
+			break;
+		case EXPR_XOR:
+			args[0] = e->left;
+			args[1] = e->right;
+			cgen_call(f, "integer_power", "", args, 2, fp);
+			break;
+		case EXPR_UNARY_MINUS:
+		case EXPR_NOT:
+			fprintf(fp, "%s%s", (top) ? "" : "(", (e->kind == EXPR_NOT) ? "!" : "-");
+			cgen_expr(f, e->right, fp, 0);
+			fprintf(fp, "%s", (top) ? "" : ")");
+			break;
+		case EXPR_SUBSCRIPT:
+			cgen_expr(f, e->left, fp, 0);
+			fprintf(fp, "[");
+			cgen_expr(f, e->right, fp, 1);
+			fprintf(fp, "]");
+			break;
+		case EXPR_INCREMENT:
+		case EXPR_DECREMENT:
+			cgen_expr(f, e->left, fp, 0);
+			fprintf(fp, "%s", (e->kind == EXPR_INCREMENT) ? "++" : "--");
+			break;
+		case EXPR_ASSIGN:
+			// Assigning an array copies its elements
+			if (e->left->kind == EXPR_NAME && e->left->symbol->type->kind == TYPE_ARRAY) {
+				fprintf(fp, "memcpy(%s, ", cgen_variable(f, e->left->symbol));
+				cgen_expr(f, e->right, fp, 1);
+				fprintf(fp, ", %d)", expr_array_assignment_size(e));
+				break;
+			}
+
+			// A value with side effects is computed before the store, so it
+			// may change the variable it is stored into. Calls cannot change
+			// which variable that is. Likewise an index with side effects must
+			// not change what the value reads.
+			if (!cgen_has_effects(e->right, e->left->kind != EXPR_NAME) && !(e->left->kind == EXPR_SUBSCRIPT && cgen_has_effects(e->left->right, 1))) {
+				fprintf(fp, "%s", (top) ? "" : "(");
+				cgen_expr(f, e->left, fp, 0);
+				fprintf(fp, " = ");
+				cgen_expr(f, e->right, fp, 0);
+				fprintf(fp, "%s", (top) ? "" : ")");
+				break;
+			}
+
+			// As in the assembly, the value is held before the index is computed
+			fprintf(fp, "(");
+			const char* value = cgen_temporary(f, e->right);
+			fprintf(fp, "%s = ", value);
+			cgen_expr(f, e->right, fp, 0);
+			fprintf(fp, ", ");
+			cgen_expr(f, e->left, fp, 0);
+			fprintf(fp, " = %s)", value);
+			break;
+		case EXPR_CALL:
+			;
+			int n = 0;
+			struct expr* arg;
+			for(arg = e->right; arg; arg = arg->next) {
+				n++;
+			}
+			struct expr** call_args = malloc(sizeof(struct expr*) * (n + 1));
+			for(arg = e->right, n = 0; arg; arg = arg->next) {
+				call_args[n++] = arg;
+			}
+			cgen_call(f, hash_table_lookup(cgen_globals, e->left->name), "", call_args, n, fp);
+			free(call_args);
+			break;
+		case EXPR_ARRAY_INITIALIZER:
+			printf("codegen error: local arrays not supported\n");
+			exit(1);
+	}
+
+}
+
+void cgen_binary(struct cgen_function* f, struct expr* e, const char* op, FILE* fp, int top) {
+
+	// Neither side may change what the other reads
+	int hold = (cgen_has_effects(e->left, 1) || cgen_has_effects(e->right, 1)) && !expr_is_literal(e->left) && !expr_is_literal(e->right);
+
+	if (!top || hold) {
+		fprintf(fp, "(");
+	}
+
+	if (hold) {
+		const char* left = cgen_temporary(f, e->left);
+		fprintf(fp, "%s = ", left);
+		cgen_expr(f, e->left, fp, 0);
+		fprintf(fp, ", %s %s ", left, op);
+	}
+	else {
+		// Integers are 64 bits wide even where both operands are literals
+		if (e->left->kind == EXPR_INTEGER_LITERAL && e->right->kind == EXPR_INTEGER_LITERAL) {
+			fprintf(fp, "(long) ");
+		}
+		cgen_expr(f, e->left, fp, 0);
+		fprintf(fp, " %s ", op);
+	}
+	cgen_expr(f, e->right, fp, 0);
+
+	if (!top || hold) {
+		fprintf(fp, ")");
+	}
+
+}
+
+// Write a call of name, preceded by prefix, with the n arguments in args
+void cgen_call(struct cgen_function* f, const char* name, const char* prefix, struct expr** args, int n, FILE* fp) {
+
+	// Arguments are evaluated in no particular order in C, so if one has
+	// side effects, all but the last that is not a literal are saved first
+	int effects = 0;
+	int last = -1;
+	int i;
+	for(i = 0; i < n; i++) {
+		effects = effects || cgen_has_effects(args[i], 1);
+		if (!expr_is_literal(args[i])) {
+			last = i;
+		}
+	}
+
+	const char** held = calloc(n + 1, sizeof(const char*));
+	int holding = 0;
+	for(i = 0; i < last && effects; i++) {
+		if (!expr_is_literal(args[i])) {
+			if (!holding) {
+				fprintf(fp, "(");
+			}
+			held[i] = cgen_temporary(f, args[i]);
+			fprintf(fp, "%s = ", held[i]);
+			cgen_expr(f, args[i], fp, 0);
+			fprintf(fp, ", ");
+			holding = 1;
+		}
+	}
+
+	fprintf(fp, "%s%s(", prefix, name);
+	for(i = 0; i < n; i++) {
+		fprintf(fp, "%s", (i) ? ", " : "");
+		if (held[i]) {
+			fprintf(fp, "%s", held[i]);
+		}
+		else {
+			cgen_expr(f, args[i], fp, 1);
+		}
+	}
+	fprintf(fp, ")%s", (holding) ? ")" : "");
+
+	free(held);
+
+}
+
+// Write one call of the runtime library for each expression printed
+void cgen_print(struct cgen_function* f, struct expr* e, FILE* fp, int indent) {
+
+	for(; e; e = e->next) {
+		struct type* t = e->type;
+
+		cgen_indent(indent, fp);
+		switch(t->kind) {
+			case TYPE_BOOLEAN:
+				fprintf(fp, "print_boolean(");
+				break;
+			case TYPE_CHARACTER:
+				fprintf(fp, "print_character(");
+				break;
+			case TYPE_STRING:
+				fprintf(fp, "print_string(");
+				break;
+			default:
+				fprintf(fp, "print_integer(");
+				break;
+		}
+		cgen_expr(f, e, fp, 1);
+		fprintf(fp, ");\n");
+
+	}
+
+}
+
+// Determine whether evaluating e may change a variable or an array element,
+// or print, counting what calls do only if calls is set
+int cgen_has_effects(struct expr* e, int calls) {
+
+	if (!e) {
+		return 0;
+	}
+
+	if (e->kind == EXPR_ASSIGN || e->kind == EXPR_INCREMENT || e->kind == EXPR_DECREMENT) {
+		return 1;
+	}
+
+	if (e->kind == EXPR_CALL) {
+		if (calls && !effects_is_pure(e->left->name)) {
+			return 1;
+		}
+
+		struct expr* arg;
+		for(arg = e->right; arg; arg = arg->next) {
+			if (cgen_has_effects(arg, calls)) {
+				return 1;
+			}
+		}
+		return 0;
+	}
+
+	return cgen_has_effects(e->left, calls) || cgen_has_effects(e->right, calls);
+}
+
+int cgen_is_string(struct expr* e) {
+
+	return e->type->kind == TYPE_STRING;
+}
+
+int cgen_is_runtime(const char* name) {
+
+	int i;
+	for(i = 0; i < (int) (sizeof(cgen_runtime) / sizeof(cgen_runtime[0])); i++) {
+		const char* start = strchr(cgen_runtime[i], ' ') + 1;
+		int length = strchr(start, '(') - start;
+		if ((int) strlen(name) == length && !strncmp(start, name, length)) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+// Declare a new temporary holding the value of e and return its name
+const char* cgen_temporary(struct cgen_function* f, struct expr* e) {
+
+	char name[32];
+	do {
+		snprintf(name, sizeof(name), "t%d", ++f->temporaries);
+	} while(hash_table_lookup(f->used, name) || hash_table_lookup(cgen_used, name));
+
+	const char* result = cgen_name(f->used, name);
+
+	fprintf(f->decls, "\t%s %s;\n", cgen_type(e->type), result);
+
+	return result;
+}
+
+// Returns the C name of the variable of symbol s, declaring it if it is a
+// local not seen before
+// Locals sharing a frame slot, a name and a type share one C variable
+const char* cgen_variable(struct cgen_function* f, struct symbol* s) {
+
+	if (s->kind == SYMBOL_GLOBAL) {
+		return hash_table_lookup(cgen_globals, s->name);
+	}
+
+	char key[256];
+	int size = (s->type->size && s->type->size->kind == EXPR_INTEGER_LITERAL) ? s->type->size->literal_value : -1;
+	snprintf(key, sizeof(key), "%.200s/%d/%s/%d", s->name, s->which_total, cgen_type(s->type), size);
+
+	const char* name = hash_table_lookup(f->locals, key);
+	if (name) {
+		return name;
+	}
+
+	name = cgen_name(f->used, s->name);
+	hash_table_insert(f->locals, key, name);
+
+	if (s->kind == SYMBOL_LOCAL) {
+		fprintf(f->decls, "\t");
+		cgen_declare(s->type, name, f->decls);
+		if (s->type->kind == TYPE_STRING) {
+			fprintf(f->decls, " = \"\"");
+		}
+		else if (s->type->kind != TYPE_ARRAY) {
+			fprintf(f->decls, " = 0");
+		}
+		fprintf(f->decls, ";\n");
+	}
+
+	return name;
+}
+
+// Returns a name for name that is valid in C and not yet in used or at file
+// scope, and adds it to used
+const char* cgen_name(struct hash_table* used, const char* name) {
+
+	int length = strlen(name);
+	char* result = malloc(length + 16);
+
+	// Names made by the optimizer may start with a dot
+	while(*name == '.') {
+		name++;
+	}
+	strcpy(result, (*name) ? name : "t");
+
+	char* c;
+	for(c = result; *c; c++) {
+		if (*c == '.') {
+			*c = '_';
+		}
+	}
+
+	while(hash_table_lookup(used, result) || hash_table_lookup(cgen_used, result)) {
+		result = realloc(result, strlen(result) + 2);
+		strcat(result, "_");
+	}
+
+	hash_table_insert(used, result, (void*) 1);
+	return result;
+}
+
+// Returns the C type of values of type t, in which arrays are pointers
+const char* cgen_type(struct type* t) {
+
+	switch(t->kind) {
+		case TYPE_BOOLEAN:
+			return "bool";
+		case TYPE_CHARACTER:
+			return "char";
+		case TYPE_INTEGER:
+			return "long";
+		case TYPE_STRING:
+			return "const char*";
+		case TYPE_VOID:
+			return "void";
+		case TYPE_ARRAY:
+			switch(t->subtype->kind) {
+				case TYPE_BOOLEAN:
+					return "bool*";
+				case TYPE_CHARACTER:
+					return "char*";
+				case TYPE_INTEGER:
+					return "long*";
+				case TYPE_STRING:
+					return "const char**";
+				default:
+					break;
+			}
+		default:
+			printf("codegen error: no C type for ");
+			type_print(t);
+			printf("\n");
+			exit(1);
+	}
+}
+
+// Declare name as a variable of type t, which holds its elements if t is an
+// array of known size
+void cgen_declare(struct type* t, const char* name, FILE* fp) {
+
+	if (t->kind == TYPE_ARRAY && t->size) {
+		if (t->size->kind != EXPR_INTEGER_LITERAL) {
+			printf("codegen error: array %s must have constant size\n", name);
+			exit(1);
+		}
+
+		fprintf(fp, "%s %s[%d]", cgen_type(t->subtype), name, t->size->literal_value);
+	}
+	else {
+		fprintf(fp, "%s %s", cgen_type(t), name);
+	}
+
+}
+
+void cgen_literal(struct expr* e, FILE* fp) {
+
+	switch(e->kind) {
+		case EXPR_INTEGER_LITERAL:
+			// The most negative int has no literal of its own
+			if (e->literal_value == -2147483647 - 1) {
+				fprintf(fp, "(-2147483647 - 1)");
+			}
+			else {
+				fprintf(fp, "%d", e->literal_value);
+			}
+			break;
+		case EXPR_CHAR_LITERAL:
+			cgen_character(e->literal_value, fp);
+			break;
+		case EXPR_STRING_LITERAL:
+			;
+			int length = strlen(e->original_literal_value);
+			char* spelling = strndup(e->original_literal_value + 1, length - 2);
+			cgen_string(spelling, fp);
+			free(spelling);
+			break;
+		case EXPR_TRUE:
+			fprintf(fp, "true");
+			break;
+		case EXPR_FALSE:
+			fprintf(fp, "false");
+			break;
+		default:
+			break;
+	}
+
+}
+
+// Write the string with the given spelling as a C string literal
+void cgen_string(const char* spelling, FILE* fp) {
+
+	long length;
+	char* contents = expr_decode_string_spelling(spelling, &length);
+
+	fprintf(fp, "\"");
+	long i;
+	for(i = 0; i < length; i++) {
+		unsigned char c = contents[i];
+		if (c == '"' || c == '\\') {
+			fprintf(fp, "\\%c", c);
+		}
+		else if (c == '\n') {
+			fprintf(fp, "\\n");
+		}
+		else if (c == '\t') {
+			fprintf(fp, "\\t");
+		}
+		// Keep two question marks from starting a trigraph
+		else if (c == '?' && i + 1 < length && contents[i + 1] == '?') {
+			fprintf(fp, "\\?");
+		}
+		else if (c < ' ' || c > '~') {
+			fprintf(fp, "\\%03o", c);
+		}
+		else {
+			fprintf(fp, "%c", c);
+		}
+	}
+	fprintf(fp, "\"");
+
+	free(contents);
+
+}
+
+void cgen_character(int c, FILE* fp) {
+
+	c &= 0xFF;
+	if (c == '\'' || c == '\\') {
+		fprintf(fp, "'\\%c'", c);
+	}
+	else if (c == '\n') {
+		fprintf(fp, "'\\n'");
+	}
+	else if (c == '\t') {
+		fprintf(fp, "'\\t'");
+	}
+	else if (c < ' ' || c > '~') {
+		fprintf(fp, "'\\%03o'", c);
+	}
+	else {
+		fprintf(fp, "'%c'", c);
+	}
+
+}
+
+void cgen_indent(int indent, FILE* fp) {
+
+	int i;
+	for(i = 0; i < indent; i++) {
+		fprintf(fp, "\t");
+	}
+
+}
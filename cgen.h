@@ -0,0 +1,52 @@
+// cgen.h
+// Header file for the C backend, which translates the typed program into C99
+// that calls the runtime library the same way the generated assembly does
+
+#ifndef CGEN_H
+#define CGEN_H
+
+#include "decl.h"
+#include "stmt.h"
+#include "expr.h"
+#include "hash_table.h"
+#include <stdio.h>
+
+// Function being translated
+// Its locals and temporaries are all declared at the top, into decls, since
+// a local keeps its value between iterations of a loop that declares it
+struct cgen_function {
+	struct decl* decl;
+	FILE* decls;
+	char* decls_text;
+	size_t decls_size;
+	struct hash_table* locals;
+	struct hash_table* used;
+	int temporaries;
+};
+
+void cgen_program(struct decl* program, const char* source, FILE* fp);
+void cgen_name_globals(struct decl* program, int dotted);
+void cgen_prototype(struct cgen_function* f, struct decl* d, FILE* fp);
+void cgen_global(struct decl* d, FILE* fp);
+void cgen_function(struct decl* d, FILE* fp);
+void cgen_stmt(struct cgen_function* f, struct stmt* s, FILE* fp, int indent);
+void cgen_body(struct cgen_function* f, struct stmt* s, FILE* fp, int indent);
+void cgen_decl(struct cgen_function* f, struct decl* d, FILE* fp, int indent);
+void cgen_expr(struct cgen_function* f, struct expr* e, FILE* fp, int top);
+void cgen_binary(struct cgen_function* f, struct expr* e, const char* op, FILE* fp, int top);
+void cgen_call(struct cgen_function* f, const char* name, const char* prefix, struct expr** args, int n, FILE* fp);
+void cgen_print(struct cgen_function* f, struct expr* e, FILE* fp, int indent);
+int cgen_has_effects(struct expr* e, int calls);
+int cgen_is_string(struct expr* e);
+int cgen_is_runtime(const char* name);
+const char* cgen_temporary(struct cgen_function* f, struct expr* e);
+const char* cgen_variable(struct cgen_function* f, struct symbol* s);
+const char* cgen_name(struct hash_table* used, const char* name);
+const char* cgen_type(struct type* t);
+void cgen_declare(struct type* t, const char* name, FILE* fp);
+void cgen_literal(struct expr* e, FILE* fp);
+void cgen_string(const char* spelling, FILE* fp);
+void cgen_character(int c, FILE* fp);
+void cgen_indent(int indent, FILE* fp);
+
+#endif
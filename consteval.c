@@ -0,0 +1,570 @@
+// consteval.c
+// Implementation of functions in consteval.h
+// A small interpreter over the typed AST. Calls to pure functions whose
+// arguments are all literals are evaluated during compilation and replaced by
+// the resulting literal, as are operators applied to literals.
+
+#include "consteval.h"
+#include "decl.h"
+#include "stmt.h"
+#include "expr.h"
+#include "type.h"
+#include "symbol.h"
+#include "param_list.h"
+#include "effects.h"
+#include "arena.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+
+// Maximum number of statements and expressions evaluated for a single fold
+int consteval_step_budget = 100000;
+
+// Maximum call depth of the interpreter
+int consteval_max_depth = 256;
+
+int consteval_steps = 0;
+int consteval_depth = 0;
+struct decl* consteval_program = 0;
+
+// Set while folding global initializers, which are evaluated before the
+// program starts, when every global still holds its own initial value
+int consteval_in_global_initializer = 0;
+
+void consteval_fold(struct decl* program) {
+
+	consteval_program = program;
+
+	struct decl* d;
+	for(d = program; d; d = d->next) {
+		consteval_in_global_initializer = 1;
+		consteval_fold_expr(d->value);
+		consteval_in_global_initializer = 0;
+		consteval_fold_stmt(d->code);
+	}
+
+}
+
+void consteval_fold_stmt(struct stmt* s) {
+
+	if (!s) {
+		return;
+	}
+
+	switch(s->kind) {
+		case STMT_DECL:
+			consteval_fold_expr(s->decl->value);
+			break;
+		case STMT_IF_ELSE:
+			consteval_fold_expr(s->expr);
+			consteval_fold_stmt(s->body);
+			consteval_fold_stmt(s->else_body);
+			break;
+		case STMT_FOR:
+			consteval_fold_expr(s->init_expr);
+			consteval_fold_expr(s->expr);
+			consteval_fold_expr(s->next_expr);
+			consteval_fold_stmt(s->body);
+			break;
+		case STMT_BLOCK:
+			consteval_fold_stmt(s->body);
+			break;
+		case STMT_EXPR:
+		case STMT_PRINT:
+		case STMT_RETURN:
+			consteval_fold_expr(s->expr);
+			break;
+	}
+
+	consteval_fold_stmt(s->next);
+
+}
+
+void consteval_fold_expr(struct expr* e) {
+
+	if (!e) {
+		return;
+	}
+
+	// Fold bottom up so that operands become literals first
+	consteval_fold_expr(e->left);
+	consteval_fold_expr(e->right);
+	consteval_fold_expr(e->next);
+
+	if ((e->kind == EXPR_EQUAL || e->kind == EXPR_NE) && consteval_fold_string_comparison(e)) {
+		return;
+	}
+
+	switch(e->kind) {
+		case EXPR_PLUS:
+		case EXPR_MINUS:
+		case EXPR_MULT:
+		case EXPR_DIVIDE:
+		case EXPR_MODULUS:
+		case EXPR_XOR:
+		case EXPR_LT:
+		case EXPR_LE:
+		case EXPR_GT:
+		case EXPR_GE:
+		case EXPR_EQUAL:
+		case EXPR_NE:
+		case EXPR_AND:
+		case EXPR_OR:
+			if (!consteval_is_operand(e->left) || !consteval_is_operand(e->right)) {
+				return;
+			}
+			break;
+		case EXPR_UNARY_MINUS:
+		case EXPR_NOT:
+			if (!consteval_is_operand(e->right)) {
+				return;
+			}
+			break;
+		case EXPR_CALL:
+			;
+			struct expr* arg;
+			for(arg = e->right; arg; arg = arg->next) {
+				if (!consteval_is_operand(arg)) {
+					return;
+				}
+			}
+			break;
+		default:
+			return;
+	}
+
+	type_t kind = e->type->kind;
+
+	if (kind != TYPE_INTEGER && kind != TYPE_BOOLEAN && kind != TYPE_CHARACTER) {
+		return;
+	}
+
+	consteval_steps = 0;
+	consteval_depth = 0;
+
+	long value;
+	if (!consteval_expr(e, 0, 0, &value)) {
+		return;
+	}
+
+	// Literals are emitted as 32 bit immediates
+	if (value < INT_MIN || value > INT_MAX) {
+		return;
+	}
+
+	consteval_replace_with_literal(e, kind, value);
+
+}
+
+// Fold == and != between two string literals
+// Literals spelled the same are equal. Without escapes the spelling is the
+// contents, so differently spelled literals are unequal. Returns whether e was
+// folded.
+int consteval_fold_string_comparison(struct expr* e) {
+
+	if (e->left->kind != EXPR_STRING_LITERAL || e->right->kind != EXPR_STRING_LITERAL) {
+		return 0;
+	}
+
+	const char* left = e->left->original_literal_value;
+	const char* right = e->right->original_literal_value;
+
+	int equal;
+	if (!strcmp(left, right)) {
+		equal = 1;
+	}
+	else if (!strchr(left, '\\') && !strchr(right, '\\')) {
+		equal = 0;
+	}
+	else {
+		return 0;
+	}
+
+	consteval_replace_with_literal(e, TYPE_BOOLEAN, (e->kind == EXPR_EQUAL) ? equal : !equal);
+	return 1;
+}
+
+// Determine whether e has a value known at compile time
+int consteval_is_operand(struct expr* e) {
+
+	if (expr_is_literal(e)) {
+		return 1;
+	}
+
+	return consteval_in_global_initializer && e->kind == EXPR_NAME && e->symbol->kind == SYMBOL_GLOBAL;
+}
+
+// Find the initial value of a scalar global
+int consteval_global_value(const char* name, long* value) {
+
+	struct decl* d;
+	for(d = consteval_program; d; d = d->next) {
+		if (strcmp(d->name, name)) {
+			continue;
+		}
+
+		if (d->type->kind != TYPE_INTEGER && d->type->kind != TYPE_BOOLEAN) {
+			return 0;
+		}
+
+		if (!d->value) {
+			*value = 0;
+			return 1;
+		}
+
+		if (!expr_is_literal(d->value)) {
+			return 0;
+		}
+
+		*value = (d->value->kind == EXPR_TRUE) ? 1 : (d->value->kind == EXPR_FALSE) ? 0 : d->value->literal_value;
+		return 1;
+	}
+
+	return 0;
+}
+
+// Evaluate a call to f with the given argument values
+// Returns whether evaluation succeeded within the step budget
+int consteval_call(struct decl* f, long* args, long* result) {
+
+	if (consteval_depth >= consteval_max_depth) {
+		return 0;
+	}
+
+	int num_params = param_list_count_params(f->type->params);
+	int num_slots = num_params + f->num_locals + 1;
+	long* slots = calloc(num_slots, sizeof(long));
+	int* initialized = calloc(num_slots, sizeof(int));
+
+	// Parameters occupy slots 1 through num_params, like their stack slots
+	int i;
+	for(i = 0; i < num_params; i++) {
+		slots[i + 1] = args[i];
+		initialized[i + 1] = 1;
+	}
+
+	consteval_depth++;
+	int returned = 0;
+	*result = 0;
+	int ok = consteval_stmt(f->code, slots, initialized, result, &returned);
+	consteval_depth--;
+
+	// Falling off the end of a non-void function leaves an undefined value
+	if (ok && !returned && f->type->subtype->kind != TYPE_VOID) {
+		ok = 0;
+	}
+
+	free(slots);
+	free(initialized);
+
+	return ok;
+}
+
+int consteval_stmt(struct stmt* s, long* slots, int* initialized, long* result, int* returned) {
+
+	long value;
+
+	while(s && !*returned) {
+
+		if (++consteval_steps > consteval_step_budget) {
+			return 0;
+		}
+
+		switch(s->kind) {
+			case STMT_DECL:
+				;
+				struct decl* d = s->decl;
+				if (d->type->kind != TYPE_INTEGER && d->type->kind != TYPE_BOOLEAN && d->type->kind != TYPE_CHARACTER) {
+					return 0;
+				}
+				initialized[d->symbol->which_total] = 0;
+				if (d->value) {
+					if (!consteval_expr(d->value, slots, initialized, &value)) {
+						return 0;
+					}
+					slots[d->symbol->which_total] = value;
+					initialized[d->symbol->which_total] = 1;
+				}
+				break;
+			case STMT_EXPR:
+				if (!consteval_expr(s->expr, slots, initialized, &value)) {
+					return 0;
+				}
+				break;
+			case STMT_IF_ELSE:
+				if (!consteval_expr(s->expr, slots, initialized, &value)) {
+					return 0;
+				}
+				if (value) {
+					if (!consteval_stmt(s->body, slots, initialized, result, returned)) {
+						return 0;
+					}
+				}
+				else if (!consteval_stmt(s->else_body, slots, initialized, result, returned)) {
+					return 0;
+				}
+				break;
+			case STMT_FOR:
+				if (s->init_expr && !consteval_expr(s->init_expr, slots, initialized, &value)) {
+					return 0;
+				}
+				while(1) {
+					if (s->expr) {
+						if (!consteval_expr(s->expr, slots, initialized, &value)) {
+							return 0;
+						}
+						if (!value) {
+							break;
+						}
+					}
+					if (!consteval_stmt(s->body, slots, initialized, result, returned)) {
+						return 0;
+					}
+					if (*returned) {
+						break;
+					}
+					if (s->next_expr && !consteval_expr(s->next_expr, slots, initialized, &value)) {
+						return 0;
+					}
+					if (++consteval_steps > consteval_step_budget) {
+						return 0;
+					}
+				}
+				break;
+			case STMT_BLOCK:
+				if (!consteval_stmt(s->body, slots, initialized, result, returned)) {
+					return 0;
+				}
+				break;
+			case STMT_PRINT:
+				return 0;
+			case STMT_RETURN:
+				if (s->expr && !consteval_expr(s->expr, slots, initialized, result)) {
+					return 0;
+				}
+				*returned = 1;
+				break;
+		}
+
+		s = s->next;
+	}
+
+	return 1;
+}
+
+// Evaluate e to an integer, boolean (0 or 1) or character value
+// slots holds the locals and parameters of the current call, or is null when
+// evaluating outside of any function
+// Returns whether evaluation succeeded
+int consteval_expr(struct expr* e, long* slots, int* initialized, long* value) {
+
+	if (!e || ++consteval_steps > consteval_step_budget) {
+		return 0;
+	}
+
+	long l = 0;
+	long r = 0;
+
+	// Evaluate operands left to right, like expr_codegen
+	switch(e->kind) {
+		case EXPR_PLUS:
+		case EXPR_MINUS:
+		case EXPR_MULT:
+		case EXPR_DIVIDE:
+		case EXPR_MODULUS:
+		case EXPR_XOR:
+		case EXPR_LT:
+		case EXPR_LE:
+		case EXPR_GT:
+		case EXPR_GE:
+		case EXPR_EQUAL:
+		case EXPR_NE:
+		case EXPR_AND:
+		case EXPR_OR:
+			if (!consteval_expr(e->left, slots, initialized, &l) || !consteval_expr(e->right, slots, initialized, &r)) {
+				return 0;
+			}
+			break;
+		case EXPR_UNARY_MINUS:
+		case EXPR_NOT:
+			if (!consteval_expr(e->right, slots, initialized, &r)) {
+				return 0;
+			}
+			break;
+		default:
+			break;
+	}
+
+	switch(e->kind) {
+		case EXPR_INTEGER_LITERAL:
+		case EXPR_CHAR_LITERAL:
+			*value = e->literal_value;
+			return 1;
+		case EXPR_TRUE:
+			*value = 1;
+			return 1;
+		case EXPR_FALSE:
+			*value = 0;
+			return 1;
+		case EXPR_PLUS:
+			*value = (long) ((unsigned long) l + (unsigned long) r);
+			return 1;
+		case EXPR_MINUS:
+			*value = (long) ((unsigned long) l - (unsigned long) r);
+			return 1;
+		case EXPR_MULT:
+			*value = (long) ((unsigned long) l * (unsigned long) r);
+			return 1;
+		case EXPR_DIVIDE:
+			// Leave trapping divisions for run time
+			if (r == 0 || (l == LONG_MIN && r == -1)) {
+				return 0;
+			}
+			*value = l / r;
+			return 1;
+		case EXPR_MODULUS:
+			// IDIVQ traps here as it does for division
+			if (r == 0 || (l == LONG_MIN && r == -1)) {
+				return 0;
+			}
+			*value = l % r;
+			return 1;
+		case EXPR_XOR:
+			;
+			// Same result as integer_power, by repeated squaring
+			unsigned long base = (unsigned long) l;
+			unsigned long power = 1;
+			while(r > 0) {
+				if (r & 1) {
+					power *= base;
+				}
+				base *= base;
+				r >>= 1;
+			}
+			*value = (long) power;
+			return 1;
+		case EXPR_LT:
+			*value = l < r;
+			return 1;
+		case EXPR_LE:
+			*value = l <= r;
+			return 1;
+		case EXPR_GT:
+			*value = l > r;
+			return 1;
+		case EXPR_GE:
+			*value = l >= r;
+			return 1;
+		case EXPR_EQUAL:
+			*value = l == r;
+			return 1;
+		case EXPR_NE:
+			*value = l != r;
+			return 1;
+		case EXPR_AND:
+			*value = (l & r) & 1;
+			return 1;
+		case EXPR_OR:
+			*value = (l | r) & 1;
+			return 1;
+		case EXPR_UNARY_MINUS:
+			*value = (long) (0 - (unsigned long) r);
+			return 1;
+		case EXPR_NOT:
+			*value = (~r) & 1;
+			return 1;
+		case EXPR_NAME:
+			if (e->symbol->kind == SYMBOL_GLOBAL) {
+				return consteval_in_global_initializer && consteval_global_value(e->name, value);
+			}
+			if (!slots) {
+				return 0;
+			}
+			if (e->symbol->type->kind != TYPE_INTEGER && e->symbol->type->kind != TYPE_BOOLEAN && e->symbol->type->kind != TYPE_CHARACTER) {
+				return 0;
+			}
+			if (!initialized[e->symbol->which_total]) {
+				return 0;
+			}
+			*value = slots[e->symbol->which_total];
+			return 1;
+		case EXPR_ASSIGN:
+			if (!slots || e->left->kind != EXPR_NAME || e->left->symbol->kind == SYMBOL_GLOBAL) {
+				return 0;
+			}
+			if (!consteval_expr(e->right, slots, initialized, &r)) {
+				return 0;
+			}
+			slots[e->left->symbol->which_total] = r;
+			initialized[e->left->symbol->which_total] = 1;
+			*value = r;
+			return 1;
+		case EXPR_INCREMENT:
+		case EXPR_DECREMENT:
+			if (!consteval_expr(e->left, slots, initialized, &l) || e->left->kind != EXPR_NAME) {
+				return 0;
+			}
+			slots[e->left->symbol->which_total] = (long) ((unsigned long) l + (e->kind == EXPR_INCREMENT ? 1 : -1));
+			*value = l;
+			return 1;
+		case EXPR_CALL:
+			;
+			struct decl* f = decl_find_function(consteval_program, e->left->name);
+			if (!f || !effects_is_pure(e->left->name)) {
+				return 0;
+			}
+
+			long args[6];
+			int num_args = 0;
+			struct expr* arg;
+			for(arg = e->right; arg; arg = arg->next) {
+				if (num_args >= 6 || !consteval_expr(arg, slots, initialized, &args[num_args])) {
+					return 0;
+				}
+				num_args++;
+			}
+
+			return consteval_call(f, args, value);
+		default:
+			// Strings, arrays and subscripts are left for run time
+			return 0;
+	}
+
+}
+
+// Turn e into a literal of the given type holding value
+void consteval_replace_with_literal(struct expr* e, type_t kind, long value) {
+
+	e->left = 0;
+	e->right = 0;
+	e->name = 0;
+	e->symbol = 0;
+	e->precedence = 10;
+
+	if (kind == TYPE_BOOLEAN) {
+		e->kind = value ? EXPR_TRUE : EXPR_FALSE;
+	}
+	else if (kind == TYPE_CHARACTER) {
+		e->kind = EXPR_CHAR_LITERAL;
+		e->literal_value = value;
+
+		// Spelling used when printing the folded literal
+		char* spelling = arena_alloc(&ast_arena, sizeof(char) * 5);
+		if (value == '\n') {
+			snprintf(spelling, 5, "'\\n'");
+		}
+		else if (value == '\0') {
+			snprintf(spelling, 5, "'\\0'");
+		}
+		else {
+			snprintf(spelling, 5, "'%c'", (char) value);
+		}
+		e->original_literal_value = spelling;
+	}
+	else {
+		e->kind = EXPR_INTEGER_LITERAL;
+		e->literal_value = value;
+	}
+
+}
@@ -0,0 +1,23 @@
+// consteval.h
+// Header file for the compile-time evaluator, which interprets calls to pure
+// functions with constant arguments and folds them into literals
+
+#ifndef CONSTEVAL_H
+#define CONSTEVAL_H
+
+#include "decl.h"
+#include "expr.h"
+#include "stmt.h"
+
+void consteval_fold(struct decl* program);
+void consteval_fold_stmt(struct stmt* s);
+void consteval_fold_expr(struct expr* e);
+int consteval_fold_string_comparison(struct expr* e);
+int consteval_is_operand(struct expr* e);
+int consteval_global_value(const char* name, long* value);
+int consteval_call(struct decl* f, long* args, long* result);
+int consteval_expr(struct expr* e, long* slots, int* initialized, long* value);
+int consteval_stmt(struct stmt* s, long* slots, int* initialized, long* result, int* returned);
+void consteval_replace_with_literal(struct expr* e, type_t kind, long value);
+
+#endif
@@ -5,12 +5,29 @@
 #include "scope.h"
 #include "param_list.h"
 #include "scratch.h"
+#include "utils.h"
+#include "hash_table.h"
+#include "arena.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+
+// Alignment of global arrays, one cache line
+int decl_array_alignment = 64;
+
+// Alignment of local arrays within the frame
+int decl_local_array_alignment = 64;
+
+// Local arrays up to this many bytes are zeroed with vector stores, larger
+// ones with REP STOSQ
+int decl_vector_zero_limit = 128;
+
+// Names of globals that the program may write, or null if not yet known
+struct hash_table* decl_written_globals = 0;
 
 // Function to create a struct decl (as part of the abstract syntax tree) and return it
 struct decl* decl_create(char* name, struct type* type, struct expr* value, struct stmt* code, struct decl* next) {
-	struct decl* d = malloc(sizeof(*d));
+	struct decl* d = arena_alloc(&ast_arena, sizeof(*d));
 
 	// Add values to d
 	d->name = name;
@@ -18,11 +35,30 @@ struct decl* decl_create(char* name, struct type* type, struct expr* value, stru
 	d->value = value;
 	d->code = code;
 	d->num_locals = 0;
+	d->array_offset = 0;
+	d->array_bytes = 0;
 	d->next = next;
 
 	return d;
 }
 
+// Copy the single declaration d, without the declarations that follow it
+// The copy shares its type and symbol with d
+struct decl* decl_copy(struct decl* d) {
+
+	if (!d) {
+		return 0;
+	}
+
+	struct decl* new_d = decl_create(d->name, d->type, expr_copy(d->value), stmt_copy(d->code), 0);
+	new_d->num_locals = d->num_locals;
+	new_d->array_offset = d->array_offset;
+	new_d->array_bytes = d->array_bytes;
+	new_d->symbol = d->symbol;
+
+	return new_d;
+}
+
 void decl_print(struct decl* d, int tabLevel) {
 
 	// If d is null, don't print anything and return
@@ -113,8 +149,9 @@ int decl_resolve_helper(struct decl* d, int decl_num, int total_decl_num, int ve
 	if(d->code) {
 		scope_enter();
 		result = param_list_resolve(d->type->params, verbose) && result;
-		total_decl_num += param_list_count_params(d->type->params);
-		result = stmt_resolve(d->code, total_decl_num, verbose, d) && result;
+
+		// Locals are numbered after the parameters of this function only
+		result = stmt_resolve(d->code, param_list_count_params(d->type->params) + 1, verbose, d) && result;
 		scope_exit();
 	}
 
@@ -132,6 +169,7 @@ int decl_typecheck(struct decl* d) {
 	}
 
 	int result = 1;
+	int errors = expr_type_errors;
 
 	if (d->value) {
 		struct type* right_type = expr_typecheck(d->value);
@@ -190,10 +228,9 @@ int decl_typecheck(struct decl* d) {
 
 		} 		
 
-		if(!right_type->errorless) {
+		if(expr_type_errors != errors) {
 			result = 0;
 		}
-		type_delete(right_type);
 	}
 
 	if (d->code) {
@@ -221,17 +258,50 @@ void decl_codegen_globals(struct decl* d, FILE* fp) {
 
 	if (d->symbol->kind == SYMBOL_GLOBAL) {
 		if(d->type->kind == TYPE_BOOLEAN || d->type->kind == TYPE_INTEGER || d->type->kind == TYPE_CHARACTER || d->type->kind == TYPE_STRING || d->type->kind == TYPE_ARRAY) {
-			const char* x86_type = type_get_x86_type_string(d->type);
-			const char* literal_value;
-			if(d->value) {
-				literal_value = expr_get_literal_value(d->value);
+			if(d->value && !decl_value_is_constant(d->value)) {
+				printf("codegen error: initializer of global %s is not a compile-time constant (", d->name);
+				expr_print(d->value, 0);
+				printf(")\n");
+				exit(1);
+			}
+
+			// Zero filled globals take no space in the binary, and globals the
+			// program never writes can share read-only pages
+			int alignment = (d->type->kind == TYPE_ARRAY) ? decl_array_alignment : 8;
+			int written = !decl_written_globals || hash_table_lookup(decl_written_globals, d->name);
+			int is_string = d->type->kind == TYPE_STRING || (d->type->kind == TYPE_ARRAY && d->type->subtype->kind == TYPE_STRING);
+
+			if(!is_string && decl_value_is_zero(d->value)) {
+				fprintf(fp, ".bss\n");
+				fprintf(fp, ".align %d\n", alignment);
+				fprintf(fp, "%s: .zero %d\n", d->name, decl_global_size(d->type));
 			}
 			else {
-				literal_value = type_generate_default_literal_value(d->type);
+				// Read-only pointers are relocated when a position independent
+				// executable is loaded, so they cannot live in .rodata
+				if (written) {
+					fprintf(fp, ".data\n");
+				}
+				else if (is_string) {
+					fprintf(fp, ".section .data.rel.ro, \"aw\"\n");
+				}
+				else {
+					fprintf(fp, ".section .rodata\n");
+				}
+				fprintf(fp, ".align %d\n", alignment);
+
+				const char* x86_type = type_get_x86_type_string(d->type);
+				const char* literal_value;
+				if(d->value) {
+					literal_value = expr_get_literal_value(d->value);
+				}
+				else {
+					literal_value = type_generate_default_literal_value(d->type);
+				}
+				fprintf(fp, "%s: %s %s\n", d->name, x86_type, literal_value);
+				free((char*) x86_type);
+				free((char*) literal_value);
 			}
-			fprintf(fp, "%s: %s %s\n", d->name, x86_type, literal_value);
-			free((char*) x86_type);
-			free((char*) literal_value);
 		}
 		else if (d->type->kind == TYPE_FUNCTION) {
 			stmt_codegen_globals(d->code, fp);
@@ -268,8 +338,24 @@ void decl_codegen(struct decl* d, FILE* fp) {
 			// Store function parameters
 			param_list_save_parameters_codegen(d->type->params, fp);
 
-			// Allocate space for local variables
-			fprintf(fp, "SUBQ $%d, %%rsp\n", (8 * d->num_locals));
+			// Allocate space for local variables, as sized by frame_layout
+			if (d->array_bytes) {
+				// Local arrays live in an aligned area below the slots, which
+				// hold pointers to them
+				fprintf(fp, "SUBQ $%d, %%rsp\n", (8 * d->num_locals) + d->array_bytes);
+				fprintf(fp, "ANDQ $-%d, %%rsp\n", decl_local_array_alignment);
+				stmt_codegen_local_array_pointers(d->code, fp);
+
+				// The five callee-saved registers below and the two
+				// caller-saved ones pushed around each call take 56 bytes, so
+				// 8 more leave %rsp 16 byte aligned at every CALL
+				fprintf(fp, "SUBQ $8, %%rsp\n");
+			}
+			else {
+				// Likewise pad an even number of parameter and local slots
+				int slots = param_list_count_params(d->type->params) + d->num_locals;
+				fprintf(fp, "SUBQ $%d, %%rsp\n", (8 * d->num_locals) + ((slots % 2) ? 0 : 8));
+			}
 
 			// Store callee-saved function parameters
 			fprintf(fp, "PUSHQ %%rbx\n");
@@ -316,9 +402,21 @@ void decl_codegen(struct decl* d, FILE* fp) {
 				scratch_free(d->value->register_number);
 			}
 		}
+		else if (d->value) {
+			// Copy the elements of the initializing array
+			expr_codegen(d->value, fp);
+			const char* var_loc = symbol_codegen(d->symbol);
+			fprintf(fp, "MOVQ %s, %%rdi\n", var_loc);
+			fprintf(fp, "MOVQ %s, %%rsi\n", scratch_name(d->value->register_number));
+			free((char*) var_loc);
+			expr_copy_elements_codegen(decl_local_array_size(d), fp);
+			scratch_free(d->value->register_number);
+		}
 		else {
-			printf("codegen error: local arrays not implemented\n");
-			exit(1);
+			// Local arrays start out zeroed each time their declaration runs
+			const char* var_loc = symbol_codegen(d->symbol);
+			decl_zero_fill_codegen(var_loc, decl_local_array_size(d), fp);
+			free((char*) var_loc);
 		}
 	}
 
@@ -327,3 +425,141 @@ void decl_codegen(struct decl* d, FILE* fp) {
 
 
 }
+
+// Determine whether a global initializer was folded down to literals
+int decl_value_is_constant(struct expr* e) {
+
+	if (e->kind == EXPR_STRING_LITERAL) {
+		return 1;
+	}
+
+	if (e->kind == EXPR_ARRAY_INITIALIZER) {
+		struct expr* curr;
+		for(curr = e->right; curr; curr = curr->next) {
+			if (!decl_value_is_constant(curr)) {
+				return 0;
+			}
+		}
+		return 1;
+	}
+
+	return expr_is_literal(e);
+}
+
+// Find the definition (the decl with a body) of the function with the given name
+struct decl* decl_find_function(struct decl* program, const char* name) {
+
+	struct decl* d;
+	for(d = program; d; d = d->next) {
+		if (d->code && d->type->kind == TYPE_FUNCTION && !strcmp(d->name, name)) {
+			return d;
+		}
+	}
+
+	return 0;
+}
+
+// Number of bytes used by the elements of local array d
+int decl_local_array_size(struct decl* d) {
+
+	if (!d->type->size || d->type->size->kind != EXPR_INTEGER_LITERAL) {
+		printf("codegen error: local array %s must have constant size\n", d->name);
+		exit(1);
+	}
+
+	return d->type->size->literal_value * type_element_size(d->type);
+}
+
+// Give local array d the next aligned part of the array area, whose size so
+// far is bytes
+void decl_layout_local_array(struct decl* d, int* bytes) {
+
+	int size = decl_local_array_size(d);
+	d->array_offset = *bytes;
+	d->array_bytes = (size + decl_local_array_alignment - 1) / decl_local_array_alignment * decl_local_array_alignment;
+	*bytes += d->array_bytes;
+
+}
+
+// Zero the bytes of the local array whose pointer is at var_loc
+// The storage of local arrays is rounded up to their alignment, so bytes may
+// be rounded up to whole vectors and quadwords
+void decl_zero_fill_codegen(const char* var_loc, int bytes, FILE* fp) {
+
+	if (bytes <= decl_vector_zero_limit) {
+		fprintf(fp, "MOVQ %s, %%rax\n", var_loc);
+		fprintf(fp, "PXOR %%xmm0, %%xmm0\n");
+		int offset;
+		for(offset = 0; offset < bytes; offset += 16) {
+			fprintf(fp, "MOVAPS %%xmm0, %d(%%rax)\n", offset);
+		}
+	}
+	else {
+		fprintf(fp, "MOVQ %s, %%rdi\n", var_loc);
+		fprintf(fp, "MOVQ $%d, %%rcx\n", (bytes + 7) / 8);
+		fprintf(fp, "XORQ %%rax, %%rax\n");
+		fprintf(fp, "REP STOSQ\n");
+	}
+
+}
+
+// Determine whether a global initializer only holds zeros
+int decl_value_is_zero(struct expr* e) {
+
+	if (!e) {
+		return 1;
+	}
+
+	switch(e->kind) {
+		case EXPR_INTEGER_LITERAL:
+		case EXPR_CHAR_LITERAL:
+			return e->literal_value == 0 && decl_value_is_zero(e->next);
+		case EXPR_FALSE:
+			return decl_value_is_zero(e->next);
+		case EXPR_ARRAY_INITIALIZER:
+			return decl_value_is_zero(e->right) && decl_value_is_zero(e->next);
+		default:
+			return 0;
+	}
+
+}
+
+// Number of bytes a global of type t occupies
+int decl_global_size(struct type* t) {
+
+	if (t->kind == TYPE_ARRAY) {
+		return t->size->literal_value * type_element_size(t);
+	}
+
+	return 8;
+}
+
+// Record which globals any function in program may write
+// Arrays passed to a function may be written through the parameter
+void decl_find_written_globals(struct decl* program) {
+
+	decl_written_globals = hash_table_create(0, 0);
+
+	struct decl* d;
+	for(d = program; d; d = d->next) {
+		stmt_collect_written_globals(d->code, decl_written_globals);
+	}
+
+}
+
+// Allocate a new stack slot in function f for a compiler generated local of
+// type t and return its symbol
+struct symbol* decl_create_temporary(struct decl* f, struct type* t) {
+
+	static int number = 1;
+
+	int slot = param_list_count_params(f->type->params) + f->num_locals + 1;
+	f->num_locals++;
+
+	int bufsize = digits_in_integer(number) + 3;
+	char* name = arena_alloc(&ast_arena, sizeof(char) * bufsize);
+	snprintf(name, bufsize, ".t%d", number);
+	number++;
+
+	return symbol_create(SYMBOL_LOCAL, t, name, f->num_locals, slot);
+}
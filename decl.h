@@ -13,11 +13,14 @@ struct decl {
 	struct expr *value;
 	struct stmt *code;
 	int num_locals;
+	int array_offset;
+	int array_bytes;
 	struct symbol* symbol;
 	struct decl *next;
 };
 
 struct decl* decl_create(char* name, struct type* type, struct expr* value, struct stmt* code, struct decl* next);
+struct decl* decl_copy(struct decl* d);
 void decl_print(struct decl* d, int tabLevel);
 int decl_resolve(struct decl* d, int verbose);
 int decl_resolve_helper(struct decl* d, int decl_num, int total_decl_num, int verbose);
@@ -25,5 +28,14 @@ int decl_typecheck(struct decl* d);
 void printTabsDecl(int tabLevel);
 void decl_codegen_globals(struct decl* d, FILE* fp);
 void decl_codegen(struct decl* d, FILE* fp);
+int decl_value_is_constant(struct expr* e);
+int decl_local_array_size(struct decl* d);
+void decl_layout_local_array(struct decl* d, int* bytes);
+void decl_zero_fill_codegen(const char* var_loc, int bytes, FILE* fp);
+int decl_value_is_zero(struct expr* e);
+int decl_global_size(struct type* t);
+void decl_find_written_globals(struct decl* program);
+struct decl* decl_find_function(struct decl* program, const char* name);
+struct symbol* decl_create_temporary(struct decl* f, struct type* t);
 
 #endif
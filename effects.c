@@ -0,0 +1,892 @@
+// effects.c
+// Implementation of functions in effects.h
+
+#include "effects.h"
+#include "decl.h"
+#include "stmt.h"
+#include "expr.h"
+#include "type.h"
+#include "symbol.h"
+#include "hash_table.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+// Maps the names of defined functions to their struct effects_function
+struct hash_table* effects_table = 0;
+struct decl* effects_program = 0;
+
+void effects_analyze(struct decl* program) {
+
+	effects_program = program;
+	effects_table = hash_table_create(0, 0);
+
+	// Collect the direct effects and callees of every defined function
+	struct decl* d;
+	for(d = program; d; d = d->next) {
+		if (d->code && d->type->kind == TYPE_FUNCTION && !hash_table_lookup(effects_table, d->name)) {
+			struct effects_function* f = calloc(1, sizeof(*f));
+			f->decl = d;
+			hash_table_insert(effects_table, d->name, f);
+		}
+	}
+
+	for(d = program; d; d = d->next) {
+		struct effects_function* f = hash_table_lookup(effects_table, d->name);
+		if (f && f->decl == d) {
+			effects_collect_stmt(f, d->code);
+		}
+	}
+
+	// Propagate the effects of callees to callers until nothing changes
+	int changed = 1;
+	while(changed) {
+		changed = 0;
+		for(d = program; d; d = d->next) {
+			struct effects_function* f = hash_table_lookup(effects_table, d->name);
+			if (!f || f->decl != d) {
+				continue;
+			}
+
+			struct effects_callee* c;
+			for(c = f->callees; c; c = c->next) {
+				struct effects_function* callee = hash_table_lookup(effects_table, c->name);
+				if (callee) {
+					changed = effects_merge(&f->effects, &callee->effects) || changed;
+				}
+			}
+		}
+	}
+
+	for(d = program; d; d = d->next) {
+		struct effects_function* f = hash_table_lookup(effects_table, d->name);
+		if (f && f->decl == d) {
+			struct hash_table* visited = hash_table_create(0, 0);
+			f->effects.recursive = effects_reaches(d->name, d->name, visited);
+			hash_table_delete(visited);
+		}
+	}
+
+}
+
+void effects_collect_stmt(struct effects_function* f, struct stmt* s) {
+
+	if (!s) {
+		return;
+	}
+
+	switch(s->kind) {
+		case STMT_DECL:
+			effects_collect_expr(f, s->decl->value);
+			break;
+		case STMT_IF_ELSE:
+			effects_collect_expr(f, s->expr);
+			effects_collect_stmt(f, s->body);
+			effects_collect_stmt(f, s->else_body);
+			break;
+		case STMT_FOR:
+			f->effects.loops = 1;
+			effects_collect_expr(f, s->init_expr);
+			effects_collect_expr(f, s->expr);
+			effects_collect_expr(f, s->next_expr);
+			effects_collect_stmt(f, s->body);
+			break;
+		case STMT_BLOCK:
+			effects_collect_stmt(f, s->body);
+			break;
+		case STMT_PRINT:
+			f->effects.prints = 1;
+			effects_collect_expr(f, s->expr);
+			break;
+		case STMT_EXPR:
+		case STMT_RETURN:
+			effects_collect_expr(f, s->expr);
+			break;
+	}
+
+	effects_collect_stmt(f, s->next);
+
+}
+
+void effects_collect_expr(struct effects_function* f, struct expr* e) {
+
+	if (!e) {
+		return;
+	}
+
+	switch(e->kind) {
+		case EXPR_NAME:
+			if (e->symbol->kind == SYMBOL_GLOBAL && e->symbol->type->kind != TYPE_FUNCTION) {
+				f->effects.reads_globals = 1;
+			}
+			break;
+		case EXPR_SUBSCRIPT:
+			f->effects.reads_globals = 1;
+			f->effects.may_trap = 1;
+			effects_collect_expr(f, e->left);
+			effects_collect_expr(f, e->right);
+			break;
+		case EXPR_DIVIDE:
+		case EXPR_MODULUS:
+			// IDIV traps on a zero divisor and on dividing the minimum by -1
+			if (e->right->kind != EXPR_INTEGER_LITERAL || e->right->literal_value == 0 || e->right->literal_value == -1) {
+				f->effects.may_trap = 1;
+			}
+			effects_collect_expr(f, e->left);
+			effects_collect_expr(f, e->right);
+			break;
+		case EXPR_ASSIGN:
+			if (e->left->kind == EXPR_NAME) {
+				if (e->left->symbol->kind == SYMBOL_GLOBAL) {
+					f->effects.writes_globals = 1;
+				}
+				else if (e->left->symbol->kind == SYMBOL_PARAM && e->left->symbol->type->kind == TYPE_ARRAY) {
+					// Copying into an array parameter writes the caller's array
+					f->effects.writes_globals = 1;
+					f->effects.may_trap = 1;
+				}
+				if (e->left->symbol->type->kind == TYPE_ARRAY) {
+					// And the copy reads the elements of its source
+					f->effects.reads_globals = 1;
+				}
+			}
+			else {
+				// Element stores write through a pointer that may alias a global
+				f->effects.writes_globals = 1;
+				f->effects.may_trap = 1;
+				effects_collect_expr(f, e->left->left);
+				effects_collect_expr(f, e->left->right);
+			}
+			effects_collect_expr(f, e->right);
+			break;
+		case EXPR_INCREMENT:
+		case EXPR_DECREMENT:
+			if (e->left->kind != EXPR_NAME || e->left->symbol->kind == SYMBOL_GLOBAL) {
+				f->effects.writes_globals = 1;
+			}
+			effects_collect_expr(f, e->left);
+			break;
+		case EXPR_CALL:
+			if (hash_table_lookup(effects_table, e->left->name)) {
+				struct effects_callee* c = malloc(sizeof(*c));
+				c->name = e->left->name;
+				c->next = f->callees;
+				f->callees = c;
+			}
+			else {
+				// Nothing is known about functions defined elsewhere
+				f->effects.reads_globals = 1;
+				f->effects.writes_globals = 1;
+				f->effects.prints = 1;
+				f->effects.may_trap = 1;
+				f->effects.loops = 1;
+				f->effects.unknown = 1;
+			}
+			effects_collect_expr(f, e->right);
+			break;
+		default:
+			effects_collect_expr(f, e->left);
+			effects_collect_expr(f, e->right);
+			break;
+	}
+
+	effects_collect_expr(f, e->next);
+
+}
+
+// Add the effects in from to into, returning whether into changed
+int effects_merge(struct effects* into, struct effects* from) {
+
+	int changed = 0;
+
+	if (from->reads_globals && !into->reads_globals) {
+		into->reads_globals = 1;
+		changed = 1;
+	}
+	if (from->writes_globals && !into->writes_globals) {
+		into->writes_globals = 1;
+		changed = 1;
+	}
+	if (from->prints && !into->prints) {
+		into->prints = 1;
+		changed = 1;
+	}
+	if (from->may_trap && !into->may_trap) {
+		into->may_trap = 1;
+		changed = 1;
+	}
+	if (from->loops && !into->loops) {
+		into->loops = 1;
+		changed = 1;
+	}
+	if (from->unknown && !into->unknown) {
+		into->unknown = 1;
+		changed = 1;
+	}
+
+	return changed;
+}
+
+// Determine whether the function named to can be called, directly or
+// indirectly, from the function named from
+int effects_reaches(const char* from, const char* to, struct hash_table* visited) {
+
+	struct effects_function* f = hash_table_lookup(effects_table, from);
+	if (!f) {
+		return 0;
+	}
+
+	struct effects_callee* c;
+	for(c = f->callees; c; c = c->next) {
+		if (!strcmp(c->name, to)) {
+			return 1;
+		}
+		if (!hash_table_lookup(visited, c->name)) {
+			hash_table_insert(visited, c->name, (void*) 1);
+			if (effects_reaches(c->name, to, visited)) {
+				return 1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+struct effects* effects_lookup(const char* name) {
+
+	if (!effects_table) {
+		return 0;
+	}
+
+	struct effects_function* f = hash_table_lookup(effects_table, name);
+	return (f) ? &f->effects : 0;
+}
+
+// A pure function does not write globals or print, so calling it twice with the
+// same arguments gives the same result
+int effects_is_pure(const char* name) {
+
+	struct effects* e = effects_lookup(name);
+	return e && !e->writes_globals && !e->prints && !e->unknown;
+}
+
+// Calls to pure functions that are not recursive can be dropped when unused
+int effects_is_removable(const char* name) {
+
+	struct effects* e = effects_lookup(name);
+	return effects_is_pure(name) && !e->recursive;
+}
+
+// A call can be evaluated where the original program might not have evaluated
+// it only if it always finishes without trapping
+int effects_can_speculate(const char* name) {
+
+	struct effects* e = effects_lookup(name);
+	return effects_is_removable(name) && !e->may_trap && !e->loops;
+}
+
+void effects_print(struct decl* program, FILE* fp) {
+
+	struct decl* d;
+	for(d = program; d; d = d->next) {
+		struct effects_function* f = effects_table ? hash_table_lookup(effects_table, d->name) : 0;
+		if (!f || f->decl != d) {
+			continue;
+		}
+
+		struct effects* e = &f->effects;
+		fprintf(fp, "%s: reads globals: %s, writes globals: %s, prints: %s, recursive: %s%s\n",
+				d->name,
+				e->reads_globals ? "yes" : "no",
+				e->writes_globals ? "yes" : "no",
+				e->prints ? "yes" : "no",
+				e->recursive ? "yes" : "no",
+				effects_is_pure(d->name) ? " (pure)" : "");
+	}
+
+}
+
+void effects_optimize(struct decl* program) {
+
+	struct decl* d;
+	for(d = program; d; d = d->next) {
+		if (d->code && d->type->kind == TYPE_FUNCTION) {
+			effects_optimize_stmt(d->code, d);
+		}
+	}
+
+}
+
+void effects_optimize_stmt(struct stmt* s, struct decl* f) {
+
+	while(s) {
+		switch(s->kind) {
+			case STMT_FOR:
+				// Hoisting places temporaries in front of the loop
+				s = effects_hoist_loop(s, f);
+				effects_optimize_stmt(s->body, f);
+				break;
+			case STMT_IF_ELSE:
+				s = effects_cse_stmt(s, f);
+				effects_optimize_stmt(s->body, f);
+				effects_optimize_stmt(s->else_body, f);
+				break;
+			case STMT_BLOCK:
+				effects_optimize_stmt(s->body, f);
+				break;
+			case STMT_DECL:
+			case STMT_EXPR:
+			case STMT_PRINT:
+			case STMT_RETURN:
+				s = effects_cse_stmt(s, f);
+				effects_remove_dead_call(s);
+				break;
+		}
+
+		s = s->next;
+	}
+
+}
+
+// Determine whether evaluating e can only produce a value
+int effects_expr_is_side_effect_free(struct expr* e) {
+
+	if (!e) {
+		return 1;
+	}
+
+	switch(e->kind) {
+		case EXPR_ASSIGN:
+		case EXPR_INCREMENT:
+		case EXPR_DECREMENT:
+			return 0;
+		case EXPR_CALL:
+			if (!effects_is_pure(e->left->name)) {
+				return 0;
+			}
+			break;
+		default:
+			break;
+	}
+
+	return effects_expr_is_side_effect_free(e->left) && effects_expr_is_side_effect_free(e->right) && effects_expr_is_side_effect_free(e->next);
+}
+
+// Like effects_expr_is_side_effect_free, but also allow stores to locals,
+// which nothing outside the function can observe
+int effects_expr_is_quiet(struct expr* e) {
+
+	if (!e) {
+		return 1;
+	}
+
+	switch(e->kind) {
+		case EXPR_ASSIGN:
+		case EXPR_INCREMENT:
+		case EXPR_DECREMENT:
+			if (e->left->kind != EXPR_NAME || e->left->symbol->kind == SYMBOL_GLOBAL) {
+				return 0;
+			}
+			break;
+		case EXPR_CALL:
+			if (!effects_is_pure(e->left->name)) {
+				return 0;
+			}
+			break;
+		default:
+			break;
+	}
+
+	return effects_expr_is_quiet(e->left) && effects_expr_is_quiet(e->right) && effects_expr_is_quiet(e->next);
+}
+
+// Determine whether a and b always evaluate to the same value within a
+// statement that has no side effects
+int effects_expr_equals(struct expr* a, struct expr* b) {
+
+	if (!a || !b) {
+		return a == b;
+	}
+
+	if (a->kind != b->kind) {
+		return 0;
+	}
+
+	switch(a->kind) {
+		case EXPR_INTEGER_LITERAL:
+		case EXPR_CHAR_LITERAL:
+			return a->literal_value == b->literal_value;
+		case EXPR_TRUE:
+		case EXPR_FALSE:
+			return 1;
+		case EXPR_STRING_LITERAL:
+			return !strcmp(a->original_literal_value, b->original_literal_value);
+		case EXPR_NAME:
+			return a->symbol == b->symbol || (a->symbol->kind == SYMBOL_GLOBAL && b->symbol->kind == SYMBOL_GLOBAL && !strcmp(a->name, b->name));
+		case EXPR_CALL:
+			if (strcmp(a->left->name, b->left->name)) {
+				return 0;
+			}
+
+			struct expr* arg_a = a->right;
+			struct expr* arg_b = b->right;
+			while(arg_a && arg_b) {
+				if (!effects_expr_equals(arg_a, arg_b)) {
+					return 0;
+				}
+				arg_a = arg_a->next;
+				arg_b = arg_b->next;
+			}
+			return !arg_a && !arg_b;
+		default:
+			return 0;
+	}
+
+}
+
+// A call can be shared or moved if its function is pure and its arguments are
+// literals or scalar variables
+int effects_call_is_candidate(struct expr* e) {
+
+	if (e->kind != EXPR_CALL || !effects_is_pure(e->left->name)) {
+		return 0;
+	}
+
+	struct expr* arg;
+	for(arg = e->right; arg; arg = arg->next) {
+		if (arg->kind == EXPR_NAME) {
+			type_t kind = arg->symbol->type->kind;
+			if (kind == TYPE_ARRAY || kind == TYPE_FUNCTION) {
+				return 0;
+			}
+		}
+		else if (!expr_is_literal(arg) && arg->kind != EXPR_STRING_LITERAL) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+// Find a candidate call in e that occurs more than once in root
+// Calls on the right of && and || are guarded and might not run at all
+struct expr* effects_find_repeated_call(struct expr* e, struct expr* root, int guarded) {
+
+	if (!e) {
+		return 0;
+	}
+
+	if (effects_call_is_candidate(e) && (!guarded || effects_can_speculate(e->left->name)) && effects_count_calls(root, e) > 1) {
+		return e;
+	}
+
+	int right_guarded = guarded || e->kind == EXPR_AND || e->kind == EXPR_OR;
+
+	struct expr* found = effects_find_repeated_call(e->left, root, guarded);
+	if (!found) {
+		found = effects_find_repeated_call(e->right, root, right_guarded);
+	}
+	if (!found) {
+		found = effects_find_repeated_call(e->next, root, guarded);
+	}
+
+	return found;
+}
+
+int effects_count_calls(struct expr* e, struct expr* call) {
+
+	if (!e) {
+		return 0;
+	}
+
+	if (e->kind == EXPR_CALL && effects_expr_equals(e, call)) {
+		return 1 + effects_count_calls(e->next, call);
+	}
+
+	return effects_count_calls(e->left, call) + effects_count_calls(e->right, call) + effects_count_calls(e->next, call);
+}
+
+// Replace every call in e equal to call with a read of temporary
+void effects_replace_calls(struct expr* e, struct expr* call, struct symbol* temporary) {
+
+	if (!e) {
+		return;
+	}
+
+	if (e->kind == EXPR_CALL && effects_expr_equals(e, call)) {
+		e->kind = EXPR_NAME;
+		e->precedence = 10;
+		e->left = 0;
+		e->right = 0;
+		e->name = temporary->name;
+		e->symbol = temporary;
+	}
+	else {
+		effects_replace_calls(e->left, call, temporary);
+		effects_replace_calls(e->right, call, temporary);
+	}
+
+	effects_replace_calls(e->next, call, temporary);
+
+}
+
+void effects_replace_stmt_calls(struct stmt* s, struct expr* call, struct symbol* temporary) {
+
+	if (!s) {
+		return;
+	}
+
+	switch(s->kind) {
+		case STMT_DECL:
+			effects_replace_calls(s->decl->value, call, temporary);
+			break;
+		case STMT_IF_ELSE:
+			effects_replace_calls(s->expr, call, temporary);
+			effects_replace_stmt_calls(s->body, call, temporary);
+			effects_replace_stmt_calls(s->else_body, call, temporary);
+			break;
+		case STMT_FOR:
+			effects_replace_calls(s->init_expr, call, temporary);
+			effects_replace_calls(s->expr, call, temporary);
+			effects_replace_calls(s->next_expr, call, temporary);
+			effects_replace_stmt_calls(s->body, call, temporary);
+			break;
+		case STMT_BLOCK:
+			effects_replace_stmt_calls(s->body, call, temporary);
+			break;
+		case STMT_EXPR:
+		case STMT_PRINT:
+		case STMT_RETURN:
+			effects_replace_calls(s->expr, call, temporary);
+			break;
+	}
+
+	effects_replace_stmt_calls(s->next, call, temporary);
+
+}
+
+// Evaluate call into a new temporary of function f just before statement s
+// The statement itself moves to a new node, which is returned, so that any
+// pointer to s now reaches the temporary's assignment first
+struct stmt* effects_insert_temporary(struct stmt* s, struct expr* call, struct decl* f, struct symbol** temporary) {
+
+	struct stmt* moved = stmt_create(s->kind, s->decl, s->init_expr, s->expr, s->next_expr, s->body, s->else_body, s->next);
+
+	*temporary = decl_create_temporary(f, call->type);
+
+	struct expr* value = expr_create(EXPR_CALL, call->precedence, call->left, call->right, 0, 0, 0);
+	value->type = call->type;
+
+	// Declared in place so that its slot is only held until the last use
+	s->kind = STMT_DECL;
+	s->decl = decl_create((char*) (*temporary)->name, (*temporary)->type, value, 0, 0);
+	s->decl->symbol = *temporary;
+	s->init_expr = 0;
+	s->expr = 0;
+	s->next_expr = 0;
+	s->body = 0;
+	s->else_body = 0;
+	s->next = moved;
+
+	return moved;
+}
+
+// Share repeated pure calls in the expressions of statement s
+// Returns the node now holding s
+struct stmt* effects_cse_stmt(struct stmt* s, struct decl* f) {
+
+	struct expr* root;
+	struct expr* checked;
+
+	switch(s->kind) {
+		case STMT_DECL:
+			if (s->decl->type->kind == TYPE_ARRAY) {
+				return s;
+			}
+			root = s->decl->value;
+			checked = root;
+			break;
+		case STMT_EXPR:
+			root = s->expr;
+			checked = root;
+
+			// The store of a top level assignment happens after every call
+			if (root->kind == EXPR_ASSIGN) {
+				if (root->left->kind == EXPR_SUBSCRIPT && !effects_expr_is_side_effect_free(root->left)) {
+					return s;
+				}
+				checked = root->right;
+			}
+			break;
+		case STMT_IF_ELSE:
+		case STMT_PRINT:
+		case STMT_RETURN:
+			root = s->expr;
+			checked = root;
+			break;
+		default:
+			return s;
+	}
+
+	if (!root || !effects_expr_is_side_effect_free(checked)) {
+		return s;
+	}
+
+	struct expr* call;
+	while((call = effects_find_repeated_call(root, root, 0))) {
+		struct symbol* temporary;
+		struct stmt* moved = effects_insert_temporary(s, call, f, &temporary);
+		effects_replace_calls(root, s->decl->value, temporary);
+		s = moved;
+	}
+
+	return s;
+}
+
+// Move pure calls whose arguments do not change inside loop s in front of it
+// Returns the node now holding the loop
+struct stmt* effects_hoist_loop(struct stmt* s, struct decl* f) {
+
+	struct effects_writes w;
+	w.symbols = 0;
+	w.count = 0;
+	w.capacity = 0;
+	w.globals = 0;
+
+	effects_collect_writes_expr(s->init_expr, &w);
+	effects_collect_writes_expr(s->expr, &w);
+	effects_collect_writes_expr(s->next_expr, &w);
+	effects_collect_writes_stmt(s->body, &w);
+
+	// The condition runs at least once, so its calls only need to be guarded
+	// when something observable happens before it
+	int cond_guarded = !effects_expr_is_quiet(s->init_expr);
+
+	struct expr* call;
+	while((call = effects_find_invariant_call_expr(s->expr, &w, cond_guarded))
+			|| (call = effects_find_invariant_call_expr(s->next_expr, &w, 1))
+			|| (call = effects_find_invariant_call(s->body, &w))) {
+		struct symbol* temporary;
+		struct stmt* moved = effects_insert_temporary(s, call, f, &temporary);
+		effects_replace_calls(moved->init_expr, s->decl->value, temporary);
+		effects_replace_calls(moved->expr, s->decl->value, temporary);
+		effects_replace_calls(moved->next_expr, s->decl->value, temporary);
+		effects_replace_stmt_calls(moved->body, s->decl->value, temporary);
+		s = moved;
+	}
+
+	free(w.symbols);
+
+	return s;
+}
+
+// Find an invariant call in the statements of a loop body
+struct expr* effects_find_invariant_call(struct stmt* s, struct effects_writes* w) {
+
+	if (!s) {
+		return 0;
+	}
+
+	struct expr* found = 0;
+
+	switch(s->kind) {
+		case STMT_DECL:
+			found = effects_find_invariant_call_expr(s->decl->value, w, 1);
+			break;
+		case STMT_IF_ELSE:
+			found = effects_find_invariant_call_expr(s->expr, w, 1);
+			if (!found) {
+				found = effects_find_invariant_call(s->body, w);
+			}
+			if (!found) {
+				found = effects_find_invariant_call(s->else_body, w);
+			}
+			break;
+		case STMT_FOR:
+			found = effects_find_invariant_call_expr(s->init_expr, w, 1);
+			if (!found) {
+				found = effects_find_invariant_call_expr(s->expr, w, 1);
+			}
+			if (!found) {
+				found = effects_find_invariant_call_expr(s->next_expr, w, 1);
+			}
+			if (!found) {
+				found = effects_find_invariant_call(s->body, w);
+			}
+			break;
+		case STMT_BLOCK:
+			found = effects_find_invariant_call(s->body, w);
+			break;
+		case STMT_EXPR:
+		case STMT_PRINT:
+		case STMT_RETURN:
+			found = effects_find_invariant_call_expr(s->expr, w, 1);
+			break;
+	}
+
+	if (!found) {
+		found = effects_find_invariant_call(s->next, w);
+	}
+
+	return found;
+}
+
+// Find a call in e that can be evaluated once before the loop that wrote w
+// A guarded call might never run inside the loop, so it must not be able to
+// trap or run forever
+struct expr* effects_find_invariant_call_expr(struct expr* e, struct effects_writes* w, int guarded) {
+
+	if (!e) {
+		return 0;
+	}
+
+	if (effects_call_is_candidate(e) && (!guarded || effects_can_speculate(e->left->name))) {
+		struct effects* effects = effects_lookup(e->left->name);
+		int invariant = !(effects->reads_globals && w->globals);
+
+		struct expr* arg;
+		for(arg = e->right; arg && invariant; arg = arg->next) {
+			if (arg->kind == EXPR_NAME) {
+				if (effects_writes_contains(w, arg->symbol) || (arg->symbol->kind == SYMBOL_GLOBAL && w->globals)) {
+					invariant = 0;
+				}
+			}
+		}
+
+		if (invariant) {
+			return e;
+		}
+	}
+
+	int right_guarded = guarded || e->kind == EXPR_AND || e->kind == EXPR_OR;
+
+	struct expr* found = effects_find_invariant_call_expr(e->left, w, guarded);
+	if (!found) {
+		found = effects_find_invariant_call_expr(e->right, w, right_guarded);
+	}
+	if (!found) {
+		found = effects_find_invariant_call_expr(e->next, w, guarded);
+	}
+
+	return found;
+}
+
+void effects_collect_writes_stmt(struct stmt* s, struct effects_writes* w) {
+
+	if (!s) {
+		return;
+	}
+
+	switch(s->kind) {
+		case STMT_DECL:
+			effects_writes_add(w, s->decl->symbol);
+			effects_collect_writes_expr(s->decl->value, w);
+			break;
+		case STMT_IF_ELSE:
+			effects_collect_writes_expr(s->expr, w);
+			effects_collect_writes_stmt(s->body, w);
+			effects_collect_writes_stmt(s->else_body, w);
+			break;
+		case STMT_FOR:
+			effects_collect_writes_expr(s->init_expr, w);
+			effects_collect_writes_expr(s->expr, w);
+			effects_collect_writes_expr(s->next_expr, w);
+			effects_collect_writes_stmt(s->body, w);
+			break;
+		case STMT_BLOCK:
+			effects_collect_writes_stmt(s->body, w);
+			break;
+		case STMT_EXPR:
+		case STMT_PRINT:
+		case STMT_RETURN:
+			effects_collect_writes_expr(s->expr, w);
+			break;
+	}
+
+	effects_collect_writes_stmt(s->next, w);
+
+}
+
+void effects_collect_writes_expr(struct expr* e, struct effects_writes* w) {
+
+	if (!e) {
+		return;
+	}
+
+	switch(e->kind) {
+		case EXPR_ASSIGN:
+		case EXPR_INCREMENT:
+		case EXPR_DECREMENT:
+			if (e->left->kind == EXPR_NAME) {
+				effects_writes_add(w, e->left->symbol);
+				if (e->left->symbol->kind == SYMBOL_GLOBAL) {
+					w->globals = 1;
+				}
+			}
+			else {
+				w->globals = 1;
+			}
+			break;
+		case EXPR_CALL:
+			;
+			struct effects* effects = effects_lookup(e->left->name);
+			if (!effects || effects->writes_globals || effects->unknown) {
+				w->globals = 1;
+			}
+			break;
+		default:
+			break;
+	}
+
+	effects_collect_writes_expr(e->left, w);
+	effects_collect_writes_expr(e->right, w);
+	effects_collect_writes_expr(e->next, w);
+
+}
+
+void effects_writes_add(struct effects_writes* w, struct symbol* s) {
+
+	if (effects_writes_contains(w, s)) {
+		return;
+	}
+
+	if (w->count == w->capacity) {
+		w->capacity = (w->capacity) ? 2 * w->capacity : 8;
+		w->symbols = realloc(w->symbols, sizeof(struct symbol*) * w->capacity);
+	}
+
+	w->symbols[w->count] = s;
+	w->count++;
+
+}
+
+int effects_writes_contains(struct effects_writes* w, struct symbol* s) {
+
+	int i;
+	for(i = 0; i < w->count; i++) {
+		if (w->symbols[i] == s) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+// Drop an expression statement that only calls a removable function
+// Like loops without side effects in C++, such calls are assumed to finish
+void effects_remove_dead_call(struct stmt* s) {
+
+	if (s->kind != STMT_EXPR || s->expr->kind != EXPR_CALL) {
+		return;
+	}
+
+	struct effects* effects = effects_lookup(s->expr->left->name);
+	if (!effects_is_removable(s->expr->left->name) || effects->may_trap || !effects_expr_is_side_effect_free(s->expr->right)) {
+		return;
+	}
+
+	s->kind = STMT_BLOCK;
+	s->expr = 0;
+	s->body = 0;
+
+}
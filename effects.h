@@ -0,0 +1,79 @@
+// effects.h
+// Header file for the side effect analysis, which summarizes what each
+// function may do over the whole call graph, and the call optimizations
+// that rely on those summaries
+
+#ifndef EFFECTS_H
+#define EFFECTS_H
+
+#include "decl.h"
+#include "stmt.h"
+#include "expr.h"
+#include "symbol.h"
+#include "hash_table.h"
+#include <stdio.h>
+
+// Array elements are reached through pointers that may alias globals, so
+// subscript reads and stores count as reading and writing globals
+struct effects {
+	int reads_globals;
+	int writes_globals;
+	int prints;
+	int recursive;
+	int may_trap;
+	int loops;
+	int unknown;
+};
+
+struct effects_callee {
+	const char* name;
+	struct effects_callee* next;
+};
+
+struct effects_function {
+	struct decl* decl;
+	struct effects effects;
+	struct effects_callee* callees;
+};
+
+// Set of variables written inside a loop
+struct effects_writes {
+	struct symbol** symbols;
+	int count;
+	int capacity;
+	int globals;
+};
+
+void effects_analyze(struct decl* program);
+void effects_collect_stmt(struct effects_function* f, struct stmt* s);
+void effects_collect_expr(struct effects_function* f, struct expr* e);
+int effects_merge(struct effects* into, struct effects* from);
+int effects_reaches(const char* from, const char* to, struct hash_table* visited);
+struct effects* effects_lookup(const char* name);
+int effects_is_pure(const char* name);
+int effects_is_removable(const char* name);
+int effects_can_speculate(const char* name);
+void effects_print(struct decl* program, FILE* fp);
+
+void effects_optimize(struct decl* program);
+void effects_optimize_stmt(struct stmt* s, struct decl* f);
+int effects_expr_is_side_effect_free(struct expr* e);
+int effects_expr_is_quiet(struct expr* e);
+int effects_expr_equals(struct expr* a, struct expr* b);
+int effects_call_is_candidate(struct expr* e);
+struct expr* effects_find_repeated_call(struct expr* e, struct expr* root, int guarded);
+int effects_count_calls(struct expr* e, struct expr* call);
+void effects_replace_calls(struct expr* e, struct expr* call, struct symbol* temporary);
+void effects_replace_stmt_calls(struct stmt* s, struct expr* call, struct symbol* temporary);
+struct stmt* effects_insert_temporary(struct stmt* s, struct expr* call, struct decl* f, struct symbol** temporary);
+struct stmt* effects_cse_stmt(struct stmt* s, struct decl* f);
+struct stmt* effects_hoist_loop(struct stmt* s, struct decl* f);
+struct expr* effects_find_invariant_call(struct stmt* s, struct effects_writes* w);
+struct expr* effects_find_invariant_call_expr(struct expr* e, struct effects_writes* w, int guarded);
+void effects_collect_writes_stmt(struct stmt* s, struct effects_writes* w);
+void effects_collect_writes_expr(struct expr* e, struct effects_writes* w);
+void effects_writes_add(struct effects_writes* w, struct symbol* s);
+int effects_writes_contains(struct effects_writes* w, struct symbol* s);
+void effects_remove_dead_call(struct stmt* s);
+
+#endif
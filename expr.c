@@ -5,13 +5,32 @@
 #include "param_list.h"
 #include "scratch.h"
 #include "label.h"
+#include "hash_table.h"
+#include "select.h"
+#include "arena.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <ctype.h>
+
+// Alignment of each pooled string literal, so the runtime may compare them a
+// word at a time
+int expr_string_alignment = 8;
+
+// Maps the spelling of each distinct string literal to its label, and lists
+// the spellings in the order they were first seen
+struct hash_table* expr_string_pool = 0;
+char** expr_string_pool_spellings = 0;
+int expr_string_pool_count = 0;
+int expr_string_pool_capacity = 0;
+
+// Number of expressions found ill typed so far, which callers compare before
+// and after checking to learn whether anything inside went wrong
+int expr_type_errors = 0;
 
 // Create and return expr struct
-struct expr* expr_create(expr_t kind, int precedence, struct expr* left, struct expr* right, const char* name, int literal_value, const char* string_literal, const char* original_literal_value) {
-	struct expr* e = malloc(sizeof(*e));
+struct expr* expr_create(expr_t kind, int precedence, struct expr* left, struct expr* right, const char* name, int literal_value, const char* original_literal_value) {
+	struct expr* e = arena_alloc(&ast_arena, sizeof(*e));
 
 	// Add values to e
 	e->kind = kind;
@@ -20,8 +39,11 @@ struct expr* expr_create(expr_t kind, int precedence, struct expr* left, struct
 	e->right = right;
 	e->name = name;
 	e->literal_value = literal_value;
-	e->string_literal = string_literal;
 	e->original_literal_value = original_literal_value;
+	e->symbol = 0;
+	e->type = 0;
+	e->register_number = 0;
+	e->next = 0;
 
 	return e;
 }
@@ -274,40 +296,26 @@ struct expr* expr_copy(struct expr* e) {
 		return 0;
 	}
 
-	struct expr* new_e = malloc(sizeof(*new_e));
+	struct expr* new_e = arena_alloc(&ast_arena, sizeof(*new_e));
 
 	new_e->kind = e->kind;
 	new_e->precedence = e->precedence;
 	new_e->left = expr_copy(e->left);
 	new_e->right = expr_copy(e->right);
-	new_e->name = (e->name) ? strdup(e->name) : 0;
-	new_e->symbol = symbol_copy(e->symbol);
+	// Strings last as long as the tree, so copies share them
+	new_e->name = e->name;
+	// Resolved names keep referring to the same variable
+	new_e->symbol = e->symbol;
 	new_e->literal_value = e->literal_value;
-	new_e->string_literal = (e->string_literal) ? strdup(e->string_literal) : 0;
-	new_e->original_literal_value = (e->original_literal_value) ? strdup(e->original_literal_value) : 0;
+	new_e->original_literal_value = e->original_literal_value;
+	new_e->type = e->type;
+	new_e->register_number = 0;
 	new_e->next = expr_copy(e->next);
 
 	return new_e;
 
 }
 
-void expr_delete(struct expr* e) {
-
-	if(!e) {
-		return;
-	}
-
-	expr_delete(e->left);
-	expr_delete(e->right);
-	free((char*) e->name);
-	symbol_delete(e->symbol);
-	free((char*) e->string_literal);
-	free((char*) e->original_literal_value);
-	expr_delete(e->next);
-
-	free(e);
-}
-
 struct type* expr_typecheck(struct expr* e) {
 
 	if (!e) {
@@ -320,13 +328,6 @@ struct type* expr_typecheck(struct expr* e) {
 	struct type* result;
 	int errorless_value = 1;
 
-	if(lt) {
-		errorless_value = errorless_value && lt->errorless;
-	}
-	if(rt) {
-		errorless_value = errorless_value && rt->errorless;
-	}
-
 	switch(e->kind) {
 		case EXPR_ASSIGN:
 			if(!type_equals(lt, rt)) {
@@ -341,7 +342,16 @@ struct type* expr_typecheck(struct expr* e) {
 				printf(")\n");
 				errorless_value = 0;
 			}
-			result = type_copy(rt);
+			// Arrays are copied whole, so known sizes must agree
+			else if (lt->kind == TYPE_ARRAY && lt->size && rt->size && lt->size->kind == EXPR_INTEGER_LITERAL && rt->size->kind == EXPR_INTEGER_LITERAL && lt->size->literal_value != rt->size->literal_value) {
+				printf("type error: cannot assign array ");
+				expr_print(e->right, 0);
+				printf(" of size %d to array ", rt->size->literal_value);
+				expr_print(e->left, 0);
+				printf(" of size %d\n", lt->size->literal_value);
+				errorless_value = 0;
+			}
+			result = rt;
 			break;
 		case EXPR_OR:
 		case EXPR_AND:
@@ -379,7 +389,7 @@ struct type* expr_typecheck(struct expr* e) {
 				printf(")\n");
 				errorless_value = 0;
 			}
-			result = type_create(TYPE_BOOLEAN, 0, 0, 0);;
+			result = type_create(TYPE_BOOLEAN, 0, 0, 0);
 			break;
 		case EXPR_PLUS:
 		case EXPR_MINUS:
@@ -401,7 +411,7 @@ struct type* expr_typecheck(struct expr* e) {
 				printf(")\n");
 				errorless_value = 0;
 			}
-			result = type_create(TYPE_INTEGER, 0, 0, 0);;
+			result = type_create(TYPE_INTEGER, 0, 0, 0);
 			break;
 		case EXPR_EQUAL:
 		case EXPR_NE:
@@ -442,7 +452,7 @@ struct type* expr_typecheck(struct expr* e) {
 				errorless_value = 0;
 			}
 
-			result = type_create(TYPE_BOOLEAN, 0, 0, 0);;
+			result = type_create(TYPE_BOOLEAN, 0, 0, 0);
 			break;
 		case EXPR_UNARY_MINUS:
 			if(rt->kind != TYPE_INTEGER) {
@@ -507,10 +517,10 @@ struct type* expr_typecheck(struct expr* e) {
 			}
 
 			if(local_error == 0 || local_error == 2) {
-				result = type_copy(lt->subtype);
+				result = lt->subtype;
 			}
 			else {
-				result = type_copy(lt);
+				result = lt;
 			}
 			break;
 		case EXPR_ARRAY_INITIALIZER:
@@ -531,14 +541,13 @@ struct type* expr_typecheck(struct expr* e) {
 					printf(")\n");
 					errorless_value = 0;
 				}
-				type_delete(curr_type);
 				counter += 1;
 				curr = curr->next;
 			}
-			result = type_create(TYPE_ARRAY, type_copy(rt), expr_create(EXPR_INTEGER_LITERAL, 10, 0, 0, 0, counter, 0, 0), 0);
+			result = type_array(rt, counter);
 			break;
 		case EXPR_NAME:
-			result = type_copy(e->symbol->type);
+			result = e->symbol->type;
 			break;
 		case EXPR_CALL:
 			if(lt->kind != TYPE_FUNCTION) {
@@ -554,10 +563,10 @@ struct type* expr_typecheck(struct expr* e) {
 			errorless_value = param_list_check_types(lt->params, e->right) && errorless_value;
 
 			if (lt->kind == TYPE_FUNCTION) {
-				result = type_copy(lt->subtype);
+				result = lt->subtype;
 			}
 			else {
-				result = type_copy(lt);
+				result = lt;
 			}
 			break;
 		case EXPR_INTEGER_LITERAL:
@@ -575,10 +584,11 @@ struct type* expr_typecheck(struct expr* e) {
 			break;
 	}
 
-	result->errorless = errorless_value;
-	
-	type_delete(lt);
-	type_delete(rt);
+	if (!errorless_value) {
+		expr_type_errors++;
+	}
+
+	e->type = result;
 
 	return result;
 
@@ -594,6 +604,11 @@ int expr_list_all_constants(struct type* t, struct expr* e) {
 	int result = expr_list_all_constants(t, e->next);
 	int currentResult = 1;
 
+	// Calls and operators on literals are folded into literals by consteval
+	if (expr_is_constant_expression(e)) {
+		return result;
+	}
+
 	if ((t->kind == TYPE_INTEGER && e->kind != EXPR_INTEGER_LITERAL) || (t->kind == TYPE_CHARACTER && e->kind != EXPR_CHAR_LITERAL) || (t->kind == TYPE_STRING && e->kind != EXPR_STRING_LITERAL) || (t->kind == TYPE_BOOLEAN && !(e->kind == EXPR_TRUE || e->kind == EXPR_FALSE)) || t->kind == TYPE_ARRAY || t->kind == TYPE_FUNCTION || t->kind == TYPE_VOID) {
 		currentResult = 0;
 	}
@@ -619,7 +634,8 @@ const char* expr_get_literal_value(struct expr* e) {
 	char* literal_value;
 	int bufsize;
 	if(e->kind == EXPR_INTEGER_LITERAL) {
-		bufsize = digits_in_integer(e->literal_value) + 1;
+		// Leave room for a minus sign
+		bufsize = digits_in_integer(e->literal_value) + 2;
 		literal_value = malloc(sizeof(char) * bufsize);
 		snprintf(literal_value, bufsize, "%d", e->literal_value);		
 	}
@@ -629,9 +645,9 @@ const char* expr_get_literal_value(struct expr* e) {
 		snprintf(literal_value, bufsize, "%d", e->literal_value);
 	}
 	else if(e->kind == EXPR_STRING_LITERAL) {
-		bufsize = strlen(e->string_literal) + 3;
-		literal_value = malloc(sizeof(char) * bufsize);
-		snprintf(literal_value, bufsize, "\"%s\"", e->string_literal);
+		// Strings are pointers to the interned literal
+		literal_value = strdup(expr_intern_string_literal(e));
+		bufsize = strlen(literal_value);
 	}
 	else if(e->kind == EXPR_TRUE || e->kind == EXPR_FALSE) {
 		bufsize = 2;
@@ -666,17 +682,8 @@ void expr_codegen_globals(struct expr* e, FILE* fp) {
 
 	switch(e->kind) {
 		case EXPR_STRING_LITERAL:
-			e->global_name = expr_generate_string_global_name();
-
-			// Remove quotes from original_literal_value
-			int length = strlen(e->original_literal_value);
-			char* newbuf = malloc(sizeof(char) * (length + 1));
-			memcpy(newbuf, e->original_literal_value + 1, length-2);
-			newbuf[length-2] = '\0';
-			
-			// Print the new value
-			fprintf(fp, "%s: .string \"%s\"\n", e->global_name, newbuf);
-			free(newbuf);
+			// The literal itself is emitted with the string pool
+			e->name = expr_intern_string_literal(e);
 			break;
 		case EXPR_CHAR_LITERAL:
 		case EXPR_ASSIGN:
@@ -715,6 +722,222 @@ void expr_codegen_globals(struct expr* e, FILE* fp) {
 
 }
 
+// Return the label of the pooled copy of string literal e, adding it to the
+// pool the first time its spelling is seen
+const char* expr_intern_string_literal(struct expr* e) {
+
+	// Remove quotes from original_literal_value
+	int length = strlen(e->original_literal_value);
+	char* spelling = malloc(sizeof(char) * (length - 1));
+	memcpy(spelling, e->original_literal_value + 1, length - 2);
+	spelling[length - 2] = '\0';
+
+	const char* label = expr_intern_string(spelling);
+	free(spelling);
+
+	return label;
+}
+
+// Return the label of the pooled string with the given assembler spelling
+const char* expr_intern_string(const char* spelling) {
+
+	if (!expr_string_pool) {
+		expr_string_pool = hash_table_create(0, 0);
+	}
+
+	const char* label = hash_table_lookup(expr_string_pool, spelling);
+	if (label) {
+		return label;
+	}
+
+	label = expr_generate_string_global_name();
+	hash_table_insert(expr_string_pool, spelling, (void*) label);
+
+	if (expr_string_pool_count == expr_string_pool_capacity) {
+		expr_string_pool_capacity = (expr_string_pool_capacity) ? 2 * expr_string_pool_capacity : 16;
+		expr_string_pool_spellings = realloc(expr_string_pool_spellings, sizeof(char*) * expr_string_pool_capacity);
+	}
+	expr_string_pool_spellings[expr_string_pool_count] = strdup(spelling);
+	expr_string_pool_count++;
+
+	return label;
+}
+
+// Emit every interned string literal once, in a read-only section of its own
+// Each literal is preceded by its length and hash. The linker gathers the
+// pools of every unit into that section, so the runtime can tell pooled
+// strings from others by its bounds
+void expr_codegen_string_pool(FILE* fp) {
+
+	if (!expr_string_pool_count) {
+		return;
+	}
+
+	fprintf(fp, ".section cminor_strings, \"a\"\n");
+
+	int i;
+	for(i = 0; i < expr_string_pool_count; i++) {
+		const char* spelling = expr_string_pool_spellings[i];
+
+		long length;
+		char* contents = expr_decode_string_spelling(spelling, &length);
+		unsigned long hash = expr_string_hash(contents, length);
+		free(contents);
+
+		fprintf(fp, ".align %d\n", expr_string_alignment);
+		fprintf(fp, ".quad %ld, 0x%lx\n", length, hash);
+		fprintf(fp, "%s: .string \"%s\"\n", (const char*) hash_table_lookup(expr_string_pool, spelling), spelling);
+	}
+
+}
+
+// Decode the escapes of a string spelling the way the assembler does
+// length receives the number of bytes before the first NUL
+char* expr_decode_string_spelling(const char* spelling, long* length) {
+
+	char* contents = malloc(sizeof(char) * (strlen(spelling) + 1));
+	int i = 0;
+	int j = 0;
+
+	while(spelling[i]) {
+		char c = spelling[i++];
+		if (c == '\\' && spelling[i]) {
+			c = spelling[i++];
+			if (c >= '0' && c <= '7') {
+				// Up to three octal digits
+				int value = c - '0';
+				int digits = 1;
+				while(digits < 3 && spelling[i] >= '0' && spelling[i] <= '7') {
+					value = value * 8 + (spelling[i++] - '0');
+					digits++;
+				}
+				c = (char) value;
+			}
+			else if (c == 'x') {
+				int value = 0;
+				while(isxdigit(spelling[i])) {
+					char h = spelling[i++];
+					value = value * 16 + (isdigit(h) ? h - '0' : tolower(h) - 'a' + 10);
+				}
+				c = (char) value;
+			}
+			else if (c == 'n') {
+				c = '\n';
+			}
+			else if (c == 't') {
+				c = '\t';
+			}
+			else if (c == 'r') {
+				c = '\r';
+			}
+			else if (c == 'b') {
+				c = '\b';
+			}
+			else if (c == 'f') {
+				c = '\f';
+			}
+		}
+		contents[j++] = c;
+	}
+	contents[j] = '\0';
+
+	*length = strlen(contents);
+
+	return contents;
+}
+
+// 64 bit FNV-1a, which string_hash in library.c also uses
+unsigned long expr_string_hash(const char* contents, long length) {
+
+	unsigned long hash = 14695981039346656037UL;
+
+	long i;
+	for(i = 0; i < length; i++) {
+		hash ^= (unsigned char) contents[i];
+		hash *= 1099511628211UL;
+	}
+
+	return hash;
+}
+
+// Add the names of the globals that e may write to written
+void expr_collect_written_globals(struct expr* e, struct hash_table* written) {
+
+	if (!e) {
+		return;
+	}
+
+	switch(e->kind) {
+		case EXPR_ASSIGN:
+		case EXPR_INCREMENT:
+		case EXPR_DECREMENT:
+			;
+			// Element stores write the array named in the subscript
+			struct expr* target = e->left;
+			while(target->kind == EXPR_SUBSCRIPT) {
+				target = target->left;
+			}
+			if (target->kind == EXPR_NAME && target->symbol->kind == SYMBOL_GLOBAL && !hash_table_lookup(written, target->name)) {
+				hash_table_insert(written, target->name, (void*) 1);
+			}
+			break;
+		case EXPR_CALL:
+			;
+			// The callee may store into arrays passed to it
+			struct expr* arg;
+			for(arg = e->right; arg; arg = arg->next) {
+				if (arg->kind == EXPR_NAME && arg->symbol->kind == SYMBOL_GLOBAL && arg->symbol->type->kind == TYPE_ARRAY && !hash_table_lookup(written, arg->name)) {
+					hash_table_insert(written, arg->name, (void*) 1);
+				}
+			}
+			break;
+		default:
+			break;
+	}
+
+	expr_collect_written_globals(e->left, written);
+	expr_collect_written_globals(e->right, written);
+	expr_collect_written_globals(e->next, written);
+
+}
+
+// Number of bytes copied by the array assignment e, taken from whichever
+// side has a known size
+int expr_array_assignment_size(struct expr* e) {
+
+	struct type* t = e->left->symbol->type;
+	if (!t->size || t->size->kind != EXPR_INTEGER_LITERAL) {
+		t = e->right->type;
+	}
+
+	if (!t->size || t->size->kind != EXPR_INTEGER_LITERAL) {
+		printf("codegen error: cannot assign to array %s of unknown size\n", e->left->name);
+		exit(1);
+	}
+
+	return t->size->literal_value * type_element_size(t);
+}
+
+// Copy bytes from the array at %rsi to the array at %rdi
+void expr_copy_elements_codegen(int bytes, FILE* fp) {
+
+	if (bytes % 8 == 0) {
+		fprintf(fp, "MOVQ $%d, %%rcx\n", bytes / 8);
+		fprintf(fp, "REP MOVSQ\n");
+	}
+	else {
+		fprintf(fp, "MOVQ $%d, %%rcx\n", bytes);
+		fprintf(fp, "REP MOVSB\n");
+	}
+
+}
+
+// Number of bytes taken by each element of the array subscripted by e
+int expr_subscript_element_size(struct expr* e) {
+
+	return type_element_size(e->left->type);
+}
+
 const char* expr_generate_string_global_name() {
 
 	static int number = 1;
@@ -824,296 +1047,10 @@ char* translate_expr_t_to_string(expr_t num) {
 
 }
 
+// Instructions are chosen by the tiling selector in select.c
 void expr_codegen(struct expr* e, FILE* fp) {
 
-	if(!e) {
-		return;
-	}
-
-	switch(e->kind) {
-		case EXPR_STRING_LITERAL:
-			e->register_number = scratch_alloc();
-			fprintf(fp, "MOVQ $%s, %s\n", e->global_name, scratch_name(e->register_number));
-			break;
-		case EXPR_CHAR_LITERAL:
-			e->register_number = scratch_alloc();
-			fprintf(fp, "MOVQ $%d, %s\n", e->literal_value, scratch_name(e->register_number));
-			break;
-		case EXPR_ASSIGN:
-			expr_codegen(e->right, fp);
-			if(e->left->kind == EXPR_SUBSCRIPT) {
-				expr_codegen(e->left->left, fp);
-				expr_codegen(e->left->right, fp);
-				fprintf(fp, "MOVQ %s, 0(%s,%s,8)\n", scratch_name(e->right->register_number), scratch_name(e->left->left->register_number), scratch_name(e->left->right->register_number));
-				scratch_free(e->left->left->register_number);
-				scratch_free(e->left->right->register_number);
-			}
-			else {
-				const char* left_symbol = symbol_codegen(e->left->symbol);
-				fprintf(fp, "MOVQ %s, %s\n", scratch_name(e->right->register_number), left_symbol);
-				free((char*) left_symbol);
-			}
-			e->register_number = e->right->register_number;
-			break;
-		case EXPR_OR:
-			expr_codegen(e->left, fp);
-			expr_codegen(e->right, fp);
-			fprintf(fp, "OR %s, %s\n", scratch_name(e->left->register_number), scratch_name(e->right->register_number));
-			fprintf(fp, "AND $1, %s\n", scratch_name(e->right->register_number));
-			scratch_free(e->left->register_number);
-			e->register_number = e->right->register_number;
-			break;
-		case EXPR_AND:
-			expr_codegen(e->left, fp);
-			expr_codegen(e->right, fp);
-			fprintf(fp, "AND %s, %s\n", scratch_name(e->left->register_number), scratch_name(e->right->register_number));
-			fprintf(fp, "AND $1, %s\n", scratch_name(e->right->register_number));
-			scratch_free(e->left->register_number);
-			e->register_number = e->right->register_number;	
-			break;
-		case EXPR_LT:
-			expr_codegen(e->left, fp);
-			expr_codegen(e->right, fp);
-			int lt_label1 = label_create();
-			int lt_label2 = label_create();
-			fprintf(fp, "CMP %s, %s\n", scratch_name(e->right->register_number), scratch_name(e->left->register_number));
-			fprintf(fp, "JL %s\n", label_name(lt_label1));
-			fprintf(fp, "MOVQ $0, %s\n", scratch_name(e->right->register_number));
-			fprintf(fp, "JMP %s\n", label_name(lt_label2));
-			fprintf(fp, "%s:\n", label_name(lt_label1));
-			fprintf(fp, "MOVQ $1, %s\n", scratch_name(e->right->register_number));
-			fprintf(fp, "%s:\n", label_name(lt_label2));
-			e->register_number = e->right->register_number;
-			scratch_free(e->left->register_number);
-			break;
-		case EXPR_LE:
-			expr_codegen(e->left, fp);
-			expr_codegen(e->right, fp);
-			int le_label1 = label_create();
-			int le_label2 = label_create();
-			fprintf(fp, "CMP %s, %s\n", scratch_name(e->right->register_number), scratch_name(e->left->register_number));
-			fprintf(fp, "JLE %s\n", label_name(le_label1));
-			fprintf(fp, "MOVQ $0, %s\n", scratch_name(e->right->register_number));
-			fprintf(fp, "JMP %s\n", label_name(le_label2));
-			fprintf(fp, "%s:\n", label_name(le_label1));
-			fprintf(fp, "MOVQ $1, %s\n", scratch_name(e->right->register_number));
-			fprintf(fp, "%s:\n", label_name(le_label2));
-			e->register_number = e->right->register_number;
-			scratch_free(e->left->register_number);
-			break;
-		case EXPR_GT:
-			expr_codegen(e->left, fp);
-			expr_codegen(e->right, fp);
-			int gt_label1 = label_create();
-			int gt_label2 = label_create();
-			fprintf(fp, "CMP %s, %s\n", scratch_name(e->right->register_number), scratch_name(e->left->register_number));
-			fprintf(fp, "JG %s\n", label_name(gt_label1));
-			fprintf(fp, "MOVQ $0, %s\n", scratch_name(e->right->register_number));
-			fprintf(fp, "JMP %s\n", label_name(gt_label2));
-			fprintf(fp, "%s:\n", label_name(gt_label1));
-			fprintf(fp, "MOVQ $1, %s\n", scratch_name(e->right->register_number));
-			fprintf(fp, "%s:\n", label_name(gt_label2));
-			e->register_number = e->right->register_number;
-			scratch_free(e->left->register_number);
-			break;
-		case EXPR_GE:
-			expr_codegen(e->left, fp);
-			expr_codegen(e->right, fp);
-			int ge_label1 = label_create();
-			int ge_label2 = label_create();
-			fprintf(fp, "CMP %s, %s\n", scratch_name(e->right->register_number), scratch_name(e->left->register_number));
-			fprintf(fp, "JGE %s\n", label_name(ge_label1));
-			fprintf(fp, "MOVQ $0, %s\n", scratch_name(e->right->register_number));
-			fprintf(fp, "JMP %s\n", label_name(ge_label2));
-			fprintf(fp, "%s:\n", label_name(ge_label1));
-			fprintf(fp, "MOVQ $1, %s\n", scratch_name(e->right->register_number));
-			fprintf(fp, "%s:\n", label_name(ge_label2));
-			e->register_number = e->right->register_number;
-			scratch_free(e->left->register_number);
-			break;
-		case EXPR_PLUS:
-			expr_codegen(e->left, fp);
-			expr_codegen(e->right, fp);
-			fprintf(fp, "ADDQ %s, %s\n", scratch_name(e->left->register_number), scratch_name(e->right->register_number));
-			e->register_number = e->right->register_number;
-			scratch_free(e->left->register_number);
-			break;
-		case EXPR_MINUS:
-			expr_codegen(e->left, fp);
-			expr_codegen(e->right, fp);
-			fprintf(fp, "SUBQ %s, %s\n", scratch_name(e->right->register_number), scratch_name(e->left->register_number));
-			e->register_number = e->left->register_number;
-			scratch_free(e->right->register_number);	
-			break;
-		case EXPR_MULT:
-			expr_codegen(e->left, fp);
-			expr_codegen(e->right, fp);
-			fprintf(fp, "MOVQ %s, %%rax\n", scratch_name(e->left->register_number));
-			fprintf(fp, "IMULQ %s\n", scratch_name(e->right->register_number));
-			fprintf(fp, "MOVQ %%rax, %s\n", scratch_name(e->right->register_number));
-			e->register_number = e->right->register_number;
-			scratch_free(e->left->register_number);
-			break;
-		case EXPR_DIVIDE:
-			expr_codegen(e->left, fp);
-			expr_codegen(e->right, fp);
-			fprintf(fp, "MOVQ %s, %%rax\n", scratch_name(e->left->register_number));
-			fprintf(fp, "CQO\n");
-			fprintf(fp, "IDIVQ %s\n", scratch_name(e->right->register_number));
-			fprintf(fp, "MOVQ %%rax, %s\n", scratch_name(e->right->register_number));
-			scratch_free(e->left->register_number);
-			e->register_number = e->right->register_number;
-			break;
-		case EXPR_MODULUS:
-			expr_codegen(e->left, fp);
-			expr_codegen(e->right, fp);
-			fprintf(fp, "MOVQ %s, %%rax\n", scratch_name(e->left->register_number));
-			fprintf(fp, "CDQ\n");
-			fprintf(fp, "IDIVQ %s\n", scratch_name(e->right->register_number));
-			fprintf(fp, "MOVQ %%rdx, %s\n", scratch_name(e->right->register_number));
-			scratch_free(e->left->register_number);
-			e->register_number = e->right->register_number;
-			break;
-		case EXPR_XOR:
-			expr_codegen(e->left, fp);
-			expr_codegen(e->right, fp);
-			param_list_move_register_to_function_argument_register(e->left->register_number, 0, fp);
-			param_list_move_register_to_function_argument_register(e->right->register_number, 1, fp);
-			e->register_number = expr_call_function_codegen("integer_power", fp);
-			scratch_free(e->left->register_number);
-			scratch_free(e->right->register_number);
-			break;
-		case EXPR_EQUAL:
-			expr_codegen(e->left, fp);
-			expr_codegen(e->right, fp);
-			struct type* t = expr_typecheck(e->right);
-
-			if (t->kind == TYPE_STRING) {
-				param_list_move_register_to_function_argument_register(e->left->register_number, 0, fp);
-				param_list_move_register_to_function_argument_register(e->right->register_number, 1, fp);
-				e->register_number = expr_call_function_codegen("string_equals", fp);
-				scratch_free(e->left->register_number);
-				scratch_free(e->left->register_number);
-			}
-			else {
-				int eq_label1 = label_create();
-				int eq_label2 = label_create();
-				fprintf(fp, "CMP %s, %s\n", scratch_name(e->right->register_number), scratch_name(e->left->register_number));
-				fprintf(fp, "JE %s\n", label_name(eq_label1));
-				fprintf(fp, "MOVQ $0, %s\n", scratch_name(e->right->register_number));
-				fprintf(fp, "JMP %s\n", label_name(eq_label2));
-				fprintf(fp, "%s:\n", label_name(eq_label1));
-				fprintf(fp, "MOVQ $1, %s\n", scratch_name(e->right->register_number));
-				fprintf(fp, "%s:\n", label_name(eq_label2));
-				e->register_number = e->right->register_number;
-				scratch_free(e->left->register_number);
-			}
-			break;
-		case EXPR_NE:
-			expr_codegen(e->left, fp);
-			expr_codegen(e->right, fp);
-			struct type* ne_t = expr_typecheck(e->right);
-
-			if (ne_t->kind == TYPE_STRING) {
-				param_list_move_register_to_function_argument_register(e->left->register_number, 0, fp);
-				param_list_move_register_to_function_argument_register(e->right->register_number, 1, fp);
-				e->register_number = expr_call_function_codegen("string_equals", fp);
-				scratch_free(e->left->register_number);
-				scratch_free(e->left->register_number);
-			}
-			else {
-				int eq_label1 = label_create();
-				int eq_label2 = label_create();
-				fprintf(fp, "CMP %s, %s\n", scratch_name(e->right->register_number), scratch_name(e->left->register_number));
-				fprintf(fp, "JE %s\n", label_name(eq_label1));
-				fprintf(fp, "MOVQ $0, %s\n", scratch_name(e->right->register_number));
-				fprintf(fp, "JMP %s\n", label_name(eq_label2));
-				fprintf(fp, "%s:\n", label_name(eq_label1));
-				fprintf(fp, "MOVQ $1, %s\n", scratch_name(e->right->register_number));
-				fprintf(fp, "%s:\n", label_name(eq_label2));
-				e->register_number = e->right->register_number;
-				scratch_free(e->left->register_number);
-			}
-
-			fprintf(fp, "NOT %s\n", scratch_name(e->register_number));
-			fprintf(fp, "AND $1, %s\n", scratch_name(e->register_number));
-			break;
-		case EXPR_UNARY_MINUS:
-			expr_codegen(e->right, fp);
-			fprintf(fp, "MOVQ $-1, %%rax\n");
-			fprintf(fp, "IMULQ %s\n", scratch_name(e->right->register_number));
-			fprintf(fp, "MOVQ %%rax, %s\n", scratch_name(e->right->register_number));
-			e->register_number = e->right->register_number;
-			break;
-		case EXPR_NOT:
-			expr_codegen(e->right, fp);
-			fprintf(fp, "NOT %s\n", scratch_name(e->right->register_number));
-			fprintf(fp, "AND $1, %s\n", scratch_name(e->right->register_number));
-			e->register_number = e->right->register_number;
-			break;
-		case EXPR_INCREMENT:
-			expr_codegen(e->left, fp);
-			int increment_reg = scratch_alloc();
-			fprintf(fp, "MOVQ %s, %s\n", scratch_name(e->left->register_number), scratch_name(increment_reg));
-			fprintf(fp, "ADDQ $1, %s\n", scratch_name(increment_reg));
-			const char* left_symbol2 = symbol_codegen(e->left->symbol);
-			fprintf(fp, "MOVQ %s, %s\n", scratch_name(increment_reg), left_symbol2);
-			free((char*) left_symbol2);
-			scratch_free(increment_reg);
-			e->register_number = e->left->register_number;
-			break;
-		case EXPR_DECREMENT:
-			expr_codegen(e->left, fp);
-			int decrement_reg = scratch_alloc();
-			fprintf(fp, "MOVQ %s, %s\n", scratch_name(e->left->register_number), scratch_name(decrement_reg));
-			fprintf(fp, "SUBQ $1, %s\n", scratch_name(decrement_reg));
-			const char* left_symbol3 = symbol_codegen(e->left->symbol);
-			fprintf(fp, "MOVQ %s, %s\n", scratch_name(decrement_reg), left_symbol3);
-			free((char*) left_symbol3);
-			scratch_free(decrement_reg);
-			e->register_number = e->left->register_number;	
-			break;
-		case EXPR_SUBSCRIPT:
-			expr_codegen(e->left, fp);
-			expr_codegen(e->right, fp);
-			fprintf(fp, "MOVQ 0(%s,%s,8), %s\n", scratch_name(e->left->register_number), scratch_name(e->right->register_number), scratch_name(e->right->register_number));
-			e->register_number = e->right->register_number;
-			scratch_free(e->left->register_number);
-			break;
-		case EXPR_ARRAY_INITIALIZER:
-			printf("codegen error: local arrays not supported\n");
-			exit(1);
-			break;
-		case EXPR_NAME:
-			e->register_number = scratch_alloc();
-			const char* var_loc = symbol_codegen(e->symbol);
-			const char* register_name = scratch_name(e->register_number);
-			fprintf(fp, "MOVQ %s, %s\n", var_loc, register_name);
-			free((char*) var_loc);
-			break;
-		case EXPR_CALL:
-			// Generate argument list code
-			param_list_expr_argument_list_codegen(e->right, fp);
-
-			// Call the function and store the return value in a new register
-			e->register_number = expr_call_function_codegen(e->left->name, fp);
-			break;
-		case EXPR_INTEGER_LITERAL:
-			;
-			int reg = scratch_alloc();
-			const char* reg_name = scratch_name(reg);
-			fprintf(fp, "MOVQ $%d, %s\n", e->literal_value, reg_name);
-			e->register_number = reg;
-			break;
-		case EXPR_TRUE:
-			e->register_number = scratch_alloc();
-			fprintf(fp, "MOVQ $%d, %s\n", 1, scratch_name(e->register_number));
-			break;
-		case EXPR_FALSE:
-			e->register_number = scratch_alloc();
-			fprintf(fp, "MOVQ $%d, %s\n", 0, scratch_name(e->register_number));
-			break;
-	}
+	select_codegen(e, fp);
 
 }
 
@@ -1139,3 +1076,125 @@ int expr_call_function_codegen(const char* function_name, FILE* fp) {
 	// Return register
 	return register_number;
 }
+
+// Determine whether e can be evaluated unconditionally: it must have no side
+// effects, must not be able to trap, and may contain at most *budget nodes
+int expr_is_cheap_and_pure(struct expr* e, int* budget) {
+
+	if (!e) {
+		return 1;
+	}
+
+	(*budget)--;
+	if (*budget < 0) {
+		return 0;
+	}
+
+	switch(e->kind) {
+		case EXPR_INTEGER_LITERAL:
+		case EXPR_CHAR_LITERAL:
+		case EXPR_TRUE:
+		case EXPR_FALSE:
+			return 1;
+		case EXPR_NAME:
+			return e->symbol->type->kind == TYPE_INTEGER || e->symbol->type->kind == TYPE_BOOLEAN || e->symbol->type->kind == TYPE_CHARACTER;
+		case EXPR_EQUAL:
+		case EXPR_NE:
+			;
+			// String comparisons call into the runtime
+			if (e->left->type->kind == TYPE_STRING) {
+				return 0;
+			}
+			return expr_is_cheap_and_pure(e->left, budget) && expr_is_cheap_and_pure(e->right, budget);
+		case EXPR_PLUS:
+		case EXPR_MINUS:
+		case EXPR_MULT:
+		case EXPR_AND:
+		case EXPR_OR:
+		case EXPR_LT:
+		case EXPR_LE:
+		case EXPR_GT:
+		case EXPR_GE:
+		case EXPR_UNARY_MINUS:
+		case EXPR_NOT:
+			return expr_is_cheap_and_pure(e->left, budget) && expr_is_cheap_and_pure(e->right, budget);
+		default:
+			return 0;
+	}
+
+}
+
+// Return the number of scratch registers expr_codegen needs to evaluate e
+int expr_register_need(struct expr* e) {
+
+	if (!e) {
+		return 0;
+	}
+
+	int left_need = expr_register_need(e->left);
+	int right_need = expr_register_need(e->right);
+
+	// The left operand is held in a register while the right one is evaluated
+	int need = (left_need > right_need + 1) ? left_need : right_need + 1;
+	if (!e->left) {
+		need = right_need;
+	}
+
+	return (need > 1) ? need : 1;
+}
+
+// Determine whether e is an integer, character or boolean literal
+int expr_is_literal(struct expr* e) {
+
+	if (!e) {
+		return 0;
+	}
+
+	return e->kind == EXPR_INTEGER_LITERAL || e->kind == EXPR_CHAR_LITERAL || e->kind == EXPR_TRUE || e->kind == EXPR_FALSE;
+}
+
+// Determine whether e is built only from literals, operators and calls, so that
+// it may be evaluated at compile time
+int expr_is_constant_expression(struct expr* e) {
+
+	if (!e) {
+		return 1;
+	}
+
+	switch(e->kind) {
+		case EXPR_INTEGER_LITERAL:
+		case EXPR_CHAR_LITERAL:
+		case EXPR_TRUE:
+		case EXPR_FALSE:
+			return 1;
+		case EXPR_CALL:
+			;
+			struct expr* arg;
+			for(arg = e->right; arg; arg = arg->next) {
+				if (!expr_is_constant_expression(arg)) {
+					return 0;
+				}
+			}
+			return 1;
+		case EXPR_PLUS:
+		case EXPR_MINUS:
+		case EXPR_MULT:
+		case EXPR_DIVIDE:
+		case EXPR_MODULUS:
+		case EXPR_XOR:
+		case EXPR_LT:
+		case EXPR_LE:
+		case EXPR_GT:
+		case EXPR_GE:
+		case EXPR_EQUAL:
+		case EXPR_NE:
+		case EXPR_AND:
+		case EXPR_OR:
+		case EXPR_UNARY_MINUS:
+		case EXPR_NOT:
+			return expr_is_constant_expression(e->left) && expr_is_constant_expression(e->right);
+		default:
+			return 0;
+	}
+
+}
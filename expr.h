@@ -5,6 +5,7 @@
 #include "stmt.h"
 #include "decl.h"
 #include "symbol.h"
+#include "hash_table.h"
 #include <stdio.h>
 
 typedef enum {
@@ -38,35 +39,52 @@ typedef enum {
 	EXPR_ARRAY_INITIALIZER
 } expr_t;
 
+// Small fields are packed ahead of the pointers so that a node fills one
+// 64 byte cache line
 struct expr {
-	expr_t kind;
-	int precedence;
+	expr_t kind : 8;
+	int precedence : 8;
+	int register_number : 16;
+	int literal_value;
 	struct expr* left;
 	struct expr* right;
-	const char* name;
+	struct expr* next;
 	struct symbol* symbol;
-	int literal_value;
-	const char* string_literal;
+	// Set by expr_typecheck; later rewrites of the node keep its type
+	struct type* type;
+	// Variable named, or label of a string literal once it is pooled
+	const char* name;
 	const char* original_literal_value;
-	int register_number;
-	const char* global_name;
-	struct expr* next;
 };
 
-struct expr* expr_create(expr_t kind, int precedence, struct expr* left, struct expr* right, const char* name, int literal_value, const char* string_literal, const char* original_literal_value);
+extern int expr_type_errors;
+
+struct expr* expr_create(expr_t kind, int precedence, struct expr* left, struct expr* right, const char* name, int literal_value, const char* original_literal_value);
 void expr_print(struct expr* e, int parentPrecedence);
 void expr_print_single(struct expr* e);
 void expr_print_operator(expr_t e);
 int expr_resolve(struct expr* e, int verbose);
 struct expr* expr_copy(struct expr* e);
-void expr_delete(struct expr* e);
 struct type* expr_typecheck(struct expr* e);
 int expr_list_all_constants(struct type* t, struct expr* e);
 const char* expr_get_literal_value(struct expr* e);
 void expr_codegen_globals(struct expr* e, FILE* fp);
+const char* expr_intern_string_literal(struct expr* e);
+const char* expr_intern_string(const char* spelling);
+void expr_codegen_string_pool(FILE* fp);
+char* expr_decode_string_spelling(const char* spelling, long* length);
+unsigned long expr_string_hash(const char* contents, long length);
+void expr_collect_written_globals(struct expr* e, struct hash_table* written);
+int expr_array_assignment_size(struct expr* e);
+void expr_copy_elements_codegen(int bytes, FILE* fp);
+int expr_subscript_element_size(struct expr* e);
 const char* expr_generate_string_global_name();
 char* translate_expr_t_to_string(expr_t num);
 void expr_codegen(struct expr* e, FILE* fp);
 int expr_call_function_codegen(const char* function_name, FILE* fp);
+int expr_is_cheap_and_pure(struct expr* e, int* budget);
+int expr_register_need(struct expr* e);
+int expr_is_literal(struct expr* e);
+int expr_is_constant_expression(struct expr* e);
 
 #endif
@@ -0,0 +1,305 @@
+// frame.c
+// Implementation of functions in frame.h
+// The lifetime of a local runs from its declaration to the last statement of
+// the same statement list that refers to it. Loops are single statements of
+// the list around them, so a local used inside a loop lives through all of
+// its iterations. Slots are handed out lowest first as lifetimes begin and
+// return to the pool as they end, so locals of sibling blocks and the
+// temporaries made by the call optimizations share the same few slots.
+// Local array storage is released when the list declaring the array ends.
+
+#include "frame.h"
+#include "decl.h"
+#include "stmt.h"
+#include "expr.h"
+#include "type.h"
+#include "symbol.h"
+#include "param_list.h"
+#include <stdlib.h>
+
+// Lay out the frames of every function defined in program
+void frame_layout(struct decl* program) {
+
+	struct frame_owned owned;
+	owned.symbols = 0;
+	owned.count = 0;
+	owned.capacity = 0;
+
+	struct decl* d;
+	for(d = program; d; d = d->next) {
+		if (d->type->kind == TYPE_FUNCTION && d->code) {
+			frame_layout_function(d, &owned);
+		}
+	}
+
+	free(owned.symbols);
+
+}
+
+// Assign frame slots to the locals of function f and size its frame
+void frame_layout_function(struct decl* f, struct frame_owned* owned) {
+
+	frame_own_symbols(f->code, f->code, owned);
+
+	struct frame fr;
+	fr.params = param_list_count_params(f->type->params);
+	fr.capacity = frame_count_decls(f->code);
+	fr.in_use = calloc(fr.capacity + 1, sizeof(int));
+	fr.slots = 0;
+	fr.array_top = 0;
+	fr.array_bytes = 0;
+
+	// The prologue points the slots of local arrays at their storage, so
+	// those slots are never shared
+	frame_reserve_arrays(f->code, &fr);
+	frame_layout_list(f->code, &fr);
+
+	f->num_locals = fr.slots;
+	f->array_bytes = fr.array_bytes;
+
+	free(fr.in_use);
+
+}
+
+// Give function code its own copy of every local symbol declared in s that
+// another function already uses, which happens for specialized copies
+void frame_own_symbols(struct stmt* s, struct stmt* code, struct frame_owned* owned) {
+
+	if (!s) {
+		return;
+	}
+
+	if (s->kind == STMT_DECL) {
+		struct symbol* sym = s->decl->symbol;
+
+		int i;
+		for(i = 0; i < owned->count; i++) {
+			if (owned->symbols[i] == sym) {
+				struct symbol* own = symbol_create(sym->kind, sym->type, sym->name, sym->which, sym->which_total);
+				frame_rename_stmt(code, sym, own);
+				sym = own;
+				break;
+			}
+		}
+
+		if (owned->count == owned->capacity) {
+			owned->capacity = owned->capacity ? 2 * owned->capacity : 16;
+			owned->symbols = realloc(owned->symbols, sizeof(struct symbol*) * owned->capacity);
+		}
+		owned->symbols[owned->count++] = sym;
+	}
+
+	frame_own_symbols(s->body, code, owned);
+	frame_own_symbols(s->else_body, code, owned);
+	frame_own_symbols(s->next, code, owned);
+
+}
+
+// Make everything in s that refers to symbol from refer to symbol to
+void frame_rename_stmt(struct stmt* s, struct symbol* from, struct symbol* to) {
+
+	if (!s) {
+		return;
+	}
+
+	if (s->decl) {
+		if (s->decl->symbol == from) {
+			s->decl->symbol = to;
+		}
+		frame_rename_expr(s->decl->value, from, to);
+	}
+
+	frame_rename_expr(s->init_expr, from, to);
+	frame_rename_expr(s->expr, from, to);
+	frame_rename_expr(s->next_expr, from, to);
+	frame_rename_stmt(s->body, from, to);
+	frame_rename_stmt(s->else_body, from, to);
+	frame_rename_stmt(s->next, from, to);
+
+}
+
+void frame_rename_expr(struct expr* e, struct symbol* from, struct symbol* to) {
+
+	if (!e) {
+		return;
+	}
+
+	if (e->symbol == from) {
+		e->symbol = to;
+	}
+
+	frame_rename_expr(e->left, from, to);
+	frame_rename_expr(e->right, from, to);
+	frame_rename_expr(e->next, from, to);
+
+}
+
+// Count the local declarations in s, which bounds the number of slots
+int frame_count_decls(struct stmt* s) {
+
+	if (!s) {
+		return 0;
+	}
+
+	return (s->kind == STMT_DECL) + frame_count_decls(s->body) + frame_count_decls(s->else_body) + frame_count_decls(s->next);
+
+}
+
+// Give every local array declared in s a slot for the whole function
+void frame_reserve_arrays(struct stmt* s, struct frame* fr) {
+
+	if (!s) {
+		return;
+	}
+
+	if (s->kind == STMT_DECL && s->decl->type->kind == TYPE_ARRAY) {
+		s->decl->symbol->which_total = fr->params + frame_allocate(fr);
+	}
+
+	frame_reserve_arrays(s->body, fr);
+	frame_reserve_arrays(s->else_body, fr);
+	frame_reserve_arrays(s->next, fr);
+
+}
+
+// Assign slots to the locals declared in statement list s and in the lists
+// nested inside it
+void frame_layout_list(struct stmt* s, struct frame* fr) {
+
+	int count = 0;
+	struct stmt* curr;
+	for(curr = s; curr; curr = curr->next) {
+		count++;
+	}
+
+	if (!count) {
+		return;
+	}
+
+	// Slot taken by the declaration at each position and the position of the
+	// last statement using it
+	int* slot = calloc(count, sizeof(int));
+	int* last = calloc(count, sizeof(int));
+	int array_top = fr->array_top;
+
+	int i = 0;
+	int j;
+	for(curr = s; curr; curr = curr->next, i++) {
+		if (curr->kind == STMT_DECL) {
+			struct decl* d = curr->decl;
+			if (d->type->kind == TYPE_ARRAY) {
+				decl_layout_local_array(d, &fr->array_top);
+				if (fr->array_top > fr->array_bytes) {
+					fr->array_bytes = fr->array_top;
+				}
+			}
+			else {
+				slot[i] = frame_allocate(fr);
+				d->symbol->which_total = fr->params + slot[i];
+
+				// Without an initializer, a read in a loop may expect the
+				// value left by the previous iteration, so the slot is kept
+				// to the end of the list
+				last[i] = d->value ? i : count;
+
+				struct stmt* later;
+				j = i + 1;
+				for(later = curr->next; later && d->value; later = later->next, j++) {
+					if (frame_stmt_uses(later, d->symbol)) {
+						last[i] = j;
+					}
+				}
+			}
+		}
+
+		frame_layout_nested(curr, fr);
+
+		// Release the slots whose lifetimes end with this statement
+		for(j = 0; j <= i; j++) {
+			if (slot[j] && last[j] <= i) {
+				fr->in_use[slot[j]] = 0;
+				slot[j] = 0;
+			}
+		}
+	}
+
+	for(j = 0; j < count; j++) {
+		if (slot[j]) {
+			fr->in_use[slot[j]] = 0;
+		}
+	}
+	fr->array_top = array_top;
+
+	free(slot);
+	free(last);
+
+}
+
+// Lay out the statement lists nested inside statement s
+void frame_layout_nested(struct stmt* s, struct frame* fr) {
+
+	switch(s->kind) {
+		case STMT_IF_ELSE:
+			frame_layout_list(s->body, fr);
+			frame_layout_list(s->else_body, fr);
+			break;
+		case STMT_BLOCK:
+		case STMT_FOR:
+			frame_layout_list(s->body, fr);
+			break;
+		default:
+			break;
+	}
+
+}
+
+// Take the lowest free slot
+int frame_allocate(struct frame* fr) {
+
+	int k;
+	for(k = 1; k <= fr->capacity; k++) {
+		if (!fr->in_use[k]) {
+			fr->in_use[k] = 1;
+			if (k > fr->slots) {
+				fr->slots = k;
+			}
+			return k;
+		}
+	}
+
+	// Every declaration has a slot of its own at worst
+	return 0;
+}
+
+// Determine whether the single statement s refers to sym
+int frame_stmt_uses(struct stmt* s, struct symbol* sym) {
+
+	return (s->decl && frame_expr_uses(s->decl->value, sym))
+		|| frame_expr_uses(s->init_expr, sym)
+		|| frame_expr_uses(s->expr, sym)
+		|| frame_expr_uses(s->next_expr, sym)
+		|| frame_list_uses(s->body, sym)
+		|| frame_list_uses(s->else_body, sym);
+
+}
+
+int frame_list_uses(struct stmt* s, struct symbol* sym) {
+
+	for(; s; s = s->next) {
+		if (frame_stmt_uses(s, sym)) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+int frame_expr_uses(struct expr* e, struct symbol* sym) {
+
+	if (!e) {
+		return 0;
+	}
+
+	return e->symbol == sym || frame_expr_uses(e->left, sym) || frame_expr_uses(e->right, sym) || frame_expr_uses(e->next, sym);
+
+}
@@ -0,0 +1,45 @@
+// frame.h
+// Header file for the stack frame layout, which lets locals whose lifetimes
+// do not overlap share frame slots and local array storage
+
+#ifndef FRAME_H
+#define FRAME_H
+
+#include "decl.h"
+#include "stmt.h"
+#include "expr.h"
+#include "symbol.h"
+
+// Slots handed out while laying out one function, numbered from 1 after the
+// parameters
+struct frame {
+	int params;
+	int* in_use;
+	int capacity;
+	int slots;
+	int array_top;
+	int array_bytes;
+};
+
+// Local symbols that already belong to a laid out function
+struct frame_owned {
+	struct symbol** symbols;
+	int count;
+	int capacity;
+};
+
+void frame_layout(struct decl* program);
+void frame_layout_function(struct decl* f, struct frame_owned* owned);
+void frame_own_symbols(struct stmt* s, struct stmt* code, struct frame_owned* owned);
+void frame_rename_stmt(struct stmt* s, struct symbol* from, struct symbol* to);
+void frame_rename_expr(struct expr* e, struct symbol* from, struct symbol* to);
+int frame_count_decls(struct stmt* s);
+void frame_reserve_arrays(struct stmt* s, struct frame* fr);
+void frame_layout_list(struct stmt* s, struct frame* fr);
+void frame_layout_nested(struct stmt* s, struct frame* fr);
+int frame_allocate(struct frame* fr);
+int frame_stmt_uses(struct stmt* s, struct symbol* sym);
+int frame_list_uses(struct stmt* s, struct symbol* sym);
+int frame_expr_uses(struct expr* e, struct symbol* sym);
+
+#endif
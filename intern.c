@@ -0,0 +1,79 @@
+// intern.c
+// Implementation of functions in intern.h
+
+#include "intern.h"
+#include "arena.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+struct intern_pool intern_strings = {0, 0, 0};
+
+// Pooled strings are kept for the whole run, past the release of the tree
+struct arena intern_arena = {0, 0};
+
+// Returns the pooled copy of the length bytes at text, adding it the first
+// time it is seen
+const char* intern_string(const char* text, int length) {
+
+	struct intern_pool* p = &intern_strings;
+
+	// FNV-1a
+	unsigned hash = 2166136261u;
+	int i;
+	for(i = 0; i < length; i++) {
+		hash = (hash ^ (unsigned char) text[i]) * 16777619u;
+	}
+
+	if (2 * (p->count + 1) > p->capacity) {
+		intern_grow(p);
+	}
+
+	unsigned mask = p->capacity - 1;
+	unsigned slot = hash & mask;
+	struct intern_entry* e;
+	while((e = p->entries[slot])) {
+		if (e->hash == hash && e->length == length && !memcmp(e->text, text, length)) {
+			return e->text;
+		}
+		slot = (slot + 1) & mask;
+	}
+
+	e = arena_alloc(&intern_arena, sizeof(*e) + length + 1);
+	e->hash = hash;
+	e->length = length;
+	memcpy(e->text, text, length);
+	e->text[length] = '\0';
+
+	p->entries[slot] = e;
+	p->count++;
+
+	return e->text;
+}
+
+// Double the table, keeping it at most half full
+void intern_grow(struct intern_pool* p) {
+
+	int capacity = (p->capacity) ? 2 * p->capacity : 1024;
+	struct intern_entry** entries = calloc(capacity, sizeof(*entries));
+	if (!entries) {
+		printf("Error: Out of memory. Exiting...\n");
+		exit(1);
+	}
+
+	int i;
+	for(i = 0; i < p->capacity; i++) {
+		struct intern_entry* e = p->entries[i];
+		if (e) {
+			unsigned slot = e->hash & (capacity - 1);
+			while(entries[slot]) {
+				slot = (slot + 1) & (capacity - 1);
+			}
+			entries[slot] = e;
+		}
+	}
+
+	free(p->entries);
+	p->entries = entries;
+	p->capacity = capacity;
+}
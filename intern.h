@@ -0,0 +1,30 @@
+// intern.h
+// Header file for the pool of identifiers and literal spellings, which keeps
+// one copy of each distinct string so they may be compared by address
+
+#ifndef INTERN_H
+#define INTERN_H
+
+#include "arena.h"
+
+// A pooled string, with its text stored right after it
+struct intern_entry {
+	unsigned hash;
+	int length;
+	char text[];
+};
+
+// Open addressed table of every pooled string
+struct intern_pool {
+	struct intern_entry** entries;
+	int capacity;
+	int count;
+};
+
+extern struct intern_pool intern_strings;
+extern struct arena intern_arena;
+
+const char* intern_string(const char* text, int length);
+void intern_grow(struct intern_pool* p);
+
+#endif
@@ -0,0 +1,447 @@
+// ipcp.c
+// Implementation of functions in ipcp.h
+// The whole program is compiled at once, so the call sites found here are the
+// only callers of each function apart from main, which the runtime calls.
+
+#include "ipcp.h"
+#include "decl.h"
+#include "stmt.h"
+#include "expr.h"
+#include "type.h"
+#include "symbol.h"
+#include "param_list.h"
+#include "hash_table.h"
+#include "utils.h"
+#include "arena.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+// Maximum number of specialized copies made of a single function
+int ipcp_max_clones_per_function = 4;
+
+// Functions with more statements and expressions than this are not copied
+int ipcp_max_clone_size = 400;
+
+// Maps the names of defined functions to their struct ipcp_function
+struct hash_table* ipcp_functions = 0;
+
+// Maps a function name and its literal arguments to a specialized copy
+struct hash_table* ipcp_clones = 0;
+
+// Propagate literal arguments into functions and specialize functions for
+// call sites with literal arguments
+// Returns whether the program changed
+int ipcp_propagate(struct decl* program) {
+
+	ipcp_functions = hash_table_create(0, 0);
+	ipcp_clones = hash_table_create(0, 0);
+
+	struct decl* d;
+	for(d = program; d; d = d->next) {
+		if (d->code && d->type->kind == TYPE_FUNCTION && strcmp(d->name, "main") && !hash_table_lookup(ipcp_functions, d->name)) {
+			struct ipcp_function* info = calloc(1, sizeof(*info));
+			info->decl = d;
+			hash_table_insert(ipcp_functions, d->name, info);
+		}
+	}
+
+	for(d = program; d; d = d->next) {
+		ipcp_collect_expr(d->value, 0);
+		ipcp_collect_stmt(d->code, d);
+	}
+
+	int changed = 0;
+
+	// Parameters that receive the same literal from every caller
+	for(d = program; d; d = d->next) {
+		struct ipcp_function* info = hash_table_lookup(ipcp_functions, d->name);
+		if (!info || info->decl != d) {
+			continue;
+		}
+
+		struct param_list* p;
+		int index = 0;
+		for(p = d->type->params; p; p = p->next, index++) {
+			struct expr* value;
+			if (ipcp_agreed_value(info, index, &value) && !ipcp_param_is_written(d->code, index + 1)) {
+				ipcp_substitute(d->code, index + 1, value);
+				changed = 1;
+			}
+		}
+	}
+
+	// Remaining literal arguments that bound loops or index arrays get their
+	// own copy of the function. The list of call sites may grow as copies are
+	// added, but calls inside copies are left alone.
+	for(d = program; d; d = d->next) {
+		struct ipcp_function* info = hash_table_lookup(ipcp_functions, d->name);
+		if (!info || info->decl != d) {
+			continue;
+		}
+
+		int count = info->count;
+		int i;
+		for(i = 0; i < count; i++) {
+			const char* before = info->calls[i]->left->name;
+			ipcp_specialize_call(info, info->calls[i]);
+			changed = changed || before != info->calls[i]->left->name;
+		}
+	}
+
+	return changed;
+}
+
+void ipcp_collect_stmt(struct stmt* s, struct decl* caller) {
+
+	if (!s) {
+		return;
+	}
+
+	switch(s->kind) {
+		case STMT_DECL:
+			ipcp_collect_expr(s->decl->value, caller);
+			break;
+		case STMT_IF_ELSE:
+			ipcp_collect_expr(s->expr, caller);
+			ipcp_collect_stmt(s->body, caller);
+			ipcp_collect_stmt(s->else_body, caller);
+			break;
+		case STMT_FOR:
+			ipcp_collect_expr(s->init_expr, caller);
+			ipcp_collect_expr(s->expr, caller);
+			ipcp_collect_expr(s->next_expr, caller);
+			ipcp_collect_stmt(s->body, caller);
+			break;
+		case STMT_BLOCK:
+			ipcp_collect_stmt(s->body, caller);
+			break;
+		case STMT_EXPR:
+		case STMT_PRINT:
+		case STMT_RETURN:
+			ipcp_collect_expr(s->expr, caller);
+			break;
+	}
+
+	ipcp_collect_stmt(s->next, caller);
+
+}
+
+void ipcp_collect_expr(struct expr* e, struct decl* caller) {
+
+	if (!e) {
+		return;
+	}
+
+	if (e->kind == EXPR_CALL) {
+		struct ipcp_function* info = hash_table_lookup(ipcp_functions, e->left->name);
+		if (info) {
+			if (info->count == info->capacity) {
+				info->capacity = (info->capacity) ? 2 * info->capacity : 8;
+				info->calls = realloc(info->calls, sizeof(struct expr*) * info->capacity);
+				info->callers = realloc(info->callers, sizeof(struct decl*) * info->capacity);
+			}
+			info->calls[info->count] = e;
+			info->callers[info->count] = caller;
+			info->count++;
+		}
+	}
+
+	ipcp_collect_expr(e->left, caller);
+	ipcp_collect_expr(e->right, caller);
+	ipcp_collect_expr(e->next, caller);
+
+}
+
+struct expr* ipcp_argument(struct expr* call, int index) {
+
+	struct expr* arg = call->right;
+	while(arg && index > 0) {
+		arg = arg->next;
+		index--;
+	}
+
+	return arg;
+}
+
+// A recursive call that passes a parameter on unchanged does not disagree
+// with the other callers about its value
+int ipcp_is_forwarded(struct expr* arg, struct decl* caller, struct decl* f, int index) {
+
+	return caller == f && arg->kind == EXPR_NAME && arg->symbol->kind == SYMBOL_PARAM && arg->symbol->which == index + 1;
+}
+
+// Determine whether every caller passes the same literal as argument index
+int ipcp_agreed_value(struct ipcp_function* info, int index, struct expr** value) {
+
+	*value = 0;
+
+	int i;
+	for(i = 0; i < info->count; i++) {
+		struct expr* arg = ipcp_argument(info->calls[i], index);
+		if (!arg || ipcp_is_forwarded(arg, info->callers[i], info->decl, index)) {
+			continue;
+		}
+
+		if (!expr_is_literal(arg)) {
+			return 0;
+		}
+
+		if (*value && ((*value)->kind != arg->kind || (*value)->literal_value != arg->literal_value)) {
+			return 0;
+		}
+
+		*value = arg;
+	}
+
+	return *value != 0;
+}
+
+int ipcp_param_is_written(struct stmt* s, int which) {
+
+	if (!s) {
+		return 0;
+	}
+
+	int result = 0;
+
+	switch(s->kind) {
+		case STMT_DECL:
+			result = ipcp_param_is_written_expr(s->decl->value, which);
+			break;
+		case STMT_IF_ELSE:
+			result = ipcp_param_is_written_expr(s->expr, which) || ipcp_param_is_written(s->body, which) || ipcp_param_is_written(s->else_body, which);
+			break;
+		case STMT_FOR:
+			result = ipcp_param_is_written_expr(s->init_expr, which) || ipcp_param_is_written_expr(s->expr, which) || ipcp_param_is_written_expr(s->next_expr, which) || ipcp_param_is_written(s->body, which);
+			break;
+		case STMT_BLOCK:
+			result = ipcp_param_is_written(s->body, which);
+			break;
+		case STMT_EXPR:
+		case STMT_PRINT:
+		case STMT_RETURN:
+			result = ipcp_param_is_written_expr(s->expr, which);
+			break;
+	}
+
+	return result || ipcp_param_is_written(s->next, which);
+}
+
+int ipcp_param_is_written_expr(struct expr* e, int which) {
+
+	if (!e) {
+		return 0;
+	}
+
+	if (e->kind == EXPR_ASSIGN || e->kind == EXPR_INCREMENT || e->kind == EXPR_DECREMENT) {
+		struct symbol* s = e->left->symbol;
+		if (e->left->kind == EXPR_NAME && s->kind == SYMBOL_PARAM && s->which == which) {
+			return 1;
+		}
+	}
+
+	return ipcp_param_is_written_expr(e->left, which) || ipcp_param_is_written_expr(e->right, which) || ipcp_param_is_written_expr(e->next, which);
+}
+
+// Determine whether a parameter bounds a loop or indexes an array, where a
+// known value lets later passes simplify the most
+int ipcp_param_is_bound(struct stmt* s, int which) {
+
+	if (!s) {
+		return 0;
+	}
+
+	int result = 0;
+
+	switch(s->kind) {
+		case STMT_DECL:
+			result = ipcp_param_is_bound_expr(s->decl->value, which, 0);
+			break;
+		case STMT_IF_ELSE:
+			result = ipcp_param_is_bound_expr(s->expr, which, 0) || ipcp_param_is_bound(s->body, which) || ipcp_param_is_bound(s->else_body, which);
+			break;
+		case STMT_FOR:
+			result = ipcp_param_is_bound_expr(s->expr, which, 1) || ipcp_param_is_bound_expr(s->next_expr, which, 1) || ipcp_param_is_bound(s->body, which);
+			break;
+		case STMT_BLOCK:
+			result = ipcp_param_is_bound(s->body, which);
+			break;
+		case STMT_EXPR:
+		case STMT_PRINT:
+		case STMT_RETURN:
+			result = ipcp_param_is_bound_expr(s->expr, which, 0);
+			break;
+	}
+
+	return result || ipcp_param_is_bound(s->next, which);
+}
+
+int ipcp_param_is_bound_expr(struct expr* e, int which, int in_bound) {
+
+	if (!e) {
+		return 0;
+	}
+
+	if (e->kind == EXPR_NAME) {
+		return in_bound && e->symbol->kind == SYMBOL_PARAM && e->symbol->which == which;
+	}
+
+	if (e->kind == EXPR_SUBSCRIPT) {
+		return ipcp_param_is_bound_expr(e->left, which, in_bound) || ipcp_param_is_bound_expr(e->right, which, 1) || ipcp_param_is_bound_expr(e->next, which, in_bound);
+	}
+
+	return ipcp_param_is_bound_expr(e->left, which, in_bound) || ipcp_param_is_bound_expr(e->right, which, in_bound) || ipcp_param_is_bound_expr(e->next, which, in_bound);
+}
+
+// Replace every read of parameter which in s with the literal value
+void ipcp_substitute(struct stmt* s, int which, struct expr* value) {
+
+	if (!s) {
+		return;
+	}
+
+	switch(s->kind) {
+		case STMT_DECL:
+			ipcp_substitute_expr(s->decl->value, which, value);
+			break;
+		case STMT_IF_ELSE:
+			ipcp_substitute_expr(s->expr, which, value);
+			ipcp_substitute(s->body, which, value);
+			ipcp_substitute(s->else_body, which, value);
+			break;
+		case STMT_FOR:
+			ipcp_substitute_expr(s->init_expr, which, value);
+			ipcp_substitute_expr(s->expr, which, value);
+			ipcp_substitute_expr(s->next_expr, which, value);
+			ipcp_substitute(s->body, which, value);
+			break;
+		case STMT_BLOCK:
+			ipcp_substitute(s->body, which, value);
+			break;
+		case STMT_EXPR:
+		case STMT_PRINT:
+		case STMT_RETURN:
+			ipcp_substitute_expr(s->expr, which, value);
+			break;
+	}
+
+	ipcp_substitute(s->next, which, value);
+
+}
+
+void ipcp_substitute_expr(struct expr* e, int which, struct expr* value) {
+
+	if (!e) {
+		return;
+	}
+
+	if (e->kind == EXPR_NAME && e->symbol->kind == SYMBOL_PARAM && e->symbol->which == which) {
+		e->kind = value->kind;
+		e->precedence = value->precedence;
+		e->name = 0;
+		e->symbol = 0;
+		e->literal_value = value->literal_value;
+		e->original_literal_value = value->original_literal_value;
+	}
+	else {
+		ipcp_substitute_expr(e->left, which, value);
+		ipcp_substitute_expr(e->right, which, value);
+	}
+
+	ipcp_substitute_expr(e->next, which, value);
+
+}
+
+int ipcp_stmt_size(struct stmt* s) {
+
+	if (!s) {
+		return 0;
+	}
+
+	int size = 1 + ipcp_expr_size(s->init_expr) + ipcp_expr_size(s->expr) + ipcp_expr_size(s->next_expr);
+	if (s->decl) {
+		size += ipcp_expr_size(s->decl->value);
+	}
+
+	return size + ipcp_stmt_size(s->body) + ipcp_stmt_size(s->else_body) + ipcp_stmt_size(s->next);
+}
+
+int ipcp_expr_size(struct expr* e) {
+
+	if (!e) {
+		return 0;
+	}
+
+	return 1 + ipcp_expr_size(e->left) + ipcp_expr_size(e->right) + ipcp_expr_size(e->next);
+}
+
+// Redirect call to a copy of its function specialized for its literal
+// arguments, creating the copy the first time it is needed
+void ipcp_specialize_call(struct ipcp_function* info, struct expr* call) {
+
+	struct decl* f = info->decl;
+
+	// Key the copy by the function name and the literals it was made for,
+	// with the kind of each literal since true and false both hold 0
+	int bufsize = strlen(f->name) + 1;
+	char* key = malloc(sizeof(char) * bufsize);
+	strcpy(key, f->name);
+
+	struct param_list* p;
+	int index = 0;
+	int specialized = 0;
+	for(p = f->type->params; p; p = p->next, index++) {
+		struct expr* arg = ipcp_argument(call, index);
+		if (!arg || !expr_is_literal(arg) || ipcp_param_is_written(f->code, index + 1) || !ipcp_param_is_bound(f->code, index + 1)) {
+			continue;
+		}
+
+		bufsize += digits_in_integer(index) + digits_in_integer(arg->kind) + digits_in_integer(arg->literal_value) + 5;
+		key = realloc(key, sizeof(char) * bufsize);
+		snprintf(key + strlen(key), bufsize - strlen(key), "/%d=%d:%d", index, arg->kind, arg->literal_value);
+		specialized = 1;
+	}
+
+	if (!specialized) {
+		free(key);
+		return;
+	}
+
+	struct decl* clone = hash_table_lookup(ipcp_clones, key);
+	if (!clone) {
+		if (info->num_clones >= ipcp_max_clones_per_function || ipcp_stmt_size(f->code) > ipcp_max_clone_size) {
+			free(key);
+			return;
+		}
+
+		info->num_clones++;
+		clone = decl_copy(f);
+
+		// The dot keeps the name apart from any C-minor identifier
+		bufsize = strlen(f->name) + digits_in_integer(info->num_clones) + 6;
+		clone->name = arena_alloc(&ast_arena, sizeof(char) * bufsize);
+		snprintf(clone->name, bufsize, "%s.spec%d", f->name, info->num_clones);
+		clone->symbol = symbol_create(SYMBOL_GLOBAL, f->type, clone->name, 0, 0);
+
+		for(p = f->type->params, index = 0; p; p = p->next, index++) {
+			struct expr* arg = ipcp_argument(call, index);
+			if (arg && expr_is_literal(arg) && !ipcp_param_is_written(f->code, index + 1) && ipcp_param_is_bound(f->code, index + 1)) {
+				ipcp_substitute(clone->code, index + 1, arg);
+			}
+		}
+
+		struct decl* last = (info->last_clone) ? info->last_clone : f;
+		clone->next = last->next;
+		last->next = clone;
+		info->last_clone = clone;
+		hash_table_insert(ipcp_clones, key, clone);
+	}
+
+	free(key);
+
+	// The copy keeps every parameter, so the arguments stay as they are
+	call->left->name = clone->name;
+	call->left->symbol = clone->symbol;
+
+}
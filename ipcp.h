@@ -0,0 +1,41 @@
+// ipcp.h
+// Header file for interprocedural constant propagation, which moves literal
+// arguments into the functions receiving them and specializes functions for
+// the literal arguments of individual call sites
+
+#ifndef IPCP_H
+#define IPCP_H
+
+#include "decl.h"
+#include "stmt.h"
+#include "expr.h"
+#include "symbol.h"
+
+// Call sites of one defined function
+struct ipcp_function {
+	struct decl* decl;
+	struct expr** calls;
+	struct decl** callers;
+	int count;
+	int capacity;
+	int num_clones;
+	struct decl* last_clone;
+};
+
+int ipcp_propagate(struct decl* program);
+void ipcp_collect_stmt(struct stmt* s, struct decl* caller);
+void ipcp_collect_expr(struct expr* e, struct decl* caller);
+struct expr* ipcp_argument(struct expr* call, int index);
+int ipcp_is_forwarded(struct expr* arg, struct decl* caller, struct decl* f, int index);
+int ipcp_agreed_value(struct ipcp_function* info, int index, struct expr** value);
+int ipcp_param_is_written(struct stmt* s, int which);
+int ipcp_param_is_written_expr(struct expr* e, int which);
+int ipcp_param_is_bound(struct stmt* s, int which);
+int ipcp_param_is_bound_expr(struct expr* e, int which, int in_bound);
+void ipcp_substitute(struct stmt* s, int which, struct expr* value);
+void ipcp_substitute_expr(struct expr* e, int which, struct expr* value);
+int ipcp_stmt_size(struct stmt* s);
+int ipcp_expr_size(struct expr* e);
+void ipcp_specialize_call(struct ipcp_function* info, struct expr* call);
+
+#endif
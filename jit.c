@@ -0,0 +1,995 @@
+// jit.c
+// Implementation of functions in jit.h
+// The assembler understands exactly the instructions and directives the code
+// generator emits. A program needs one mapping: code first, made executable
+// once relocated, and the data sections on the pages after it. The same
+// encoding is written out as an object file by object.c. Jumps, calls and
+// %rip relative operands always use 32 bit displacements, so one pass is
+// enough and references are filled in at the end. Calls to the runtime
+// library go through stubs at the end of the code that jump to the absolute
+// address of the function in this process.
+
+#include "jit.h"
+#include "library.h"
+#include "sched.h"
+#include "expr.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+struct jit_binding jit_runtime[] = {
+	{"print_integer", (void*) print_integer},
+	{"print_string", (void*) print_string},
+	{"print_boolean", (void*) print_boolean},
+	{"print_character", (void*) print_character},
+	{"integer_power", (void*) integer_power},
+	{"string_length", (void*) string_length},
+	{"string_hash", (void*) string_hash},
+	{"string_equals", (void*) string_equals}
+};
+
+int jit_runtime_count = sizeof(jit_runtime) / sizeof(jit_runtime[0]);
+
+// Registers in encoding order
+const char* jit_register_names[16] = {"rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi", "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15"};
+const char* jit_byte_register_names[8] = {"al", "cl", "dl", "bl", "spl", "bpl", "sil", "dil"};
+
+// Condition codes in encoding order
+const char* jit_condition_names[16] = {"O", "NO", "B", "AE", "E", "NE", "BE", "A", "S", "NS", "P", "NP", "L", "GE", "LE", "G"};
+
+// Operations sharing the 0x01 to 0x3B and 0x81/0x83 encodings, indexed by
+// the opcode extension
+const char* jit_arithmetic_names[8] = {"ADD", "OR", "ADC", "SBB", "AND", "SUB", "XOR", "CMP"};
+
+// Prefix bits passed to jit_emit_op
+#define JIT_REX_W 1
+#define JIT_REX 2
+
+// Assemble text, map it into memory and run its main with argc and argv
+// Returns what main returned
+int jit_run(char* text, int argc, char** argv) {
+
+	struct jit_assembler a;
+	jit_init(&a);
+	jit_assemble(&a, text);
+
+	// Give each runtime function called from the code a stub at the end of it
+	// FF 25 jumps through the address stored right after the instruction
+	int i;
+	int num_fixups = a.num_fixups;
+	a.current = JIT_TEXT;
+	for(i = 0; i < num_fixups; i++) {
+		struct jit_fixup* f = &a.fixups[i];
+		if (f->absolute || hash_table_lookup(a.symbols, f->symbol)) {
+			continue;
+		}
+
+		void* address = jit_lookup_runtime(f->symbol);
+		if (!address) {
+			a.line = 0;
+			jit_error(&a, "undefined symbol", f->symbol);
+		}
+
+		jit_define(&a, f->symbol);
+		jit_emit(&a, 0xFF);
+		jit_emit(&a, 0x25);
+		jit_emit32(&a, 0);
+		jit_emit64(&a, (long) address);
+	}
+
+	// Data sections follow the code, each at its own alignment
+	long page = sysconf(_SC_PAGESIZE);
+	long text_size = (a.sections[JIT_TEXT].size + page - 1) / page * page;
+	long offsets[JIT_SECTIONS] = {0};
+	long size = text_size;
+	int section;
+	for(section = JIT_DATA; section < JIT_SECTIONS; section++) {
+		int alignment = a.sections[section].alignment;
+		size = (size + alignment - 1) / alignment * alignment;
+		offsets[section] = size;
+		size += a.sections[section].size;
+	}
+	size++;
+
+	unsigned char* memory = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (memory == MAP_FAILED) {
+		printf("Error: Could not map memory for the program. Exiting...\n");
+		exit(1);
+	}
+
+	unsigned char* bases[JIT_SECTIONS];
+	for(section = 0; section < JIT_SECTIONS; section++) {
+		bases[section] = memory + offsets[section];
+		if (a.sections[section].size) {
+			memcpy(bases[section], a.sections[section].bytes, a.sections[section].size);
+		}
+	}
+
+	// Fill in every reference now that the addresses are known
+	for(i = 0; i < a.num_fixups; i++) {
+		struct jit_fixup* f = &a.fixups[i];
+		struct jit_symbol* s = hash_table_lookup(a.symbols, f->symbol);
+		unsigned char* place = bases[f->section] + f->offset;
+
+		long target = 0;
+		if (s) {
+			target = (long) (bases[s->section] + s->offset);
+		}
+		else if (f->absolute && jit_lookup_runtime(f->symbol)) {
+			target = (long) jit_lookup_runtime(f->symbol);
+		}
+		else {
+			a.line = 0;
+			jit_error(&a, "undefined symbol", f->symbol);
+		}
+		target += f->addend;
+
+		if (f->absolute) {
+			memcpy(place, &target, 8);
+		}
+		else {
+			long displacement = target - (long) (bases[f->section] + f->next);
+			if (displacement != (int) displacement) {
+				a.line = 0;
+				jit_error(&a, "displacement out of range for", f->symbol);
+			}
+			int value = (int) displacement;
+			memcpy(place, &value, 4);
+		}
+	}
+
+	if (mprotect(memory, text_size, PROT_READ | PROT_EXEC)) {
+		printf("Error: Could not make the program executable. Exiting...\n");
+		exit(1);
+	}
+
+	jit_write_perf_map(&a, memory);
+
+	struct jit_symbol* entry = hash_table_lookup(a.symbols, "main");
+	if (!entry || entry->section != JIT_TEXT) {
+		printf("Error: The program has no main function. Exiting...\n");
+		exit(1);
+	}
+
+	long (*main_function) (long, char**) = (long (*) (long, char**)) (memory + entry->offset);
+	long result = main_function(argc, argv);
+	fflush(stdout);
+
+	munmap(memory, size);
+
+	return (int) result;
+}
+
+void jit_init(struct jit_assembler* a) {
+
+	memset(a, 0, sizeof(*a));
+	a->symbols = hash_table_create(0, 0);
+	a->globals = hash_table_create(0, 0);
+
+	int s;
+	for(s = 0; s < JIT_SECTIONS; s++) {
+		a->sections[s].alignment = 1;
+	}
+	a->sections[JIT_TEXT].alignment = 16;
+
+}
+
+void jit_assemble(struct jit_assembler* a, char* text) {
+
+	char* line = text;
+	while(line && *line) {
+		char* end = strchr(line, '\n');
+		if (end) {
+			*end = 0;
+		}
+
+		a->line++;
+		jit_assemble_line(a, line);
+
+		line = (end) ? end + 1 : 0;
+	}
+
+}
+
+void jit_assemble_line(struct jit_assembler* a, char* line) {
+
+	while(isspace(*line)) {
+		line++;
+	}
+
+	// A label may share its line with a directive
+	char* c = line;
+	while(isalnum(*c) || *c == '_' || *c == '.') {
+		c++;
+	}
+	if (c != line && *c == ':') {
+		*c = 0;
+		jit_define(a, line);
+		line = c + 1;
+		while(isspace(*line)) {
+			line++;
+		}
+	}
+
+	if (!*line) {
+		return;
+	}
+
+	char* rest = line;
+	while(*rest && !isspace(*rest)) {
+		rest++;
+	}
+	if (*rest) {
+		*rest++ = 0;
+	}
+	while(isspace(*rest)) {
+		rest++;
+	}
+
+	if (*line == '.') {
+		jit_directive(a, line, rest);
+		return;
+	}
+
+	// The string instructions take their repeat prefix on the same line
+	if (!strcmp(line, "REP")) {
+		jit_emit(a, 0xF3);
+		jit_assemble_line(a, rest);
+		return;
+	}
+
+	char* text[4];
+	struct jit_operand op[3];
+	int n = sched_split_operands(rest, text);
+	if (n > 3) {
+		jit_error(a, "too many operands for", line);
+	}
+
+	int i;
+	for(i = 0; i < n; i++) {
+		if (!jit_parse_operand(text[i], &op[i])) {
+			jit_error(a, "invalid operand", text[i]);
+		}
+	}
+
+	int first_fixup = a->num_fixups;
+	jit_instruction(a, line, op, n);
+
+	// Displacements count from the end of the instruction, after any immediate
+	for(i = first_fixup; i < a->num_fixups; i++) {
+		a->fixups[i].next = a->sections[a->current].size;
+	}
+
+	for(i = 0; i < n; i++) {
+		free(op[i].symbol);
+	}
+
+}
+
+void jit_directive(struct jit_assembler* a, char* directive, char* rest) {
+
+	if (!strcmp(directive, ".text")) {
+		a->current = JIT_TEXT;
+	}
+	else if (!strcmp(directive, ".data")) {
+		a->current = JIT_DATA;
+	}
+	else if (!strcmp(directive, ".bss")) {
+		a->current = JIT_BSS;
+	}
+	else if (!strcmp(directive, ".section")) {
+		int length = strcspn(rest, ", ");
+		if (length == 5 && !strncmp(rest, ".text", 5)) {
+			a->current = JIT_TEXT;
+		}
+		else if (length == 5 && !strncmp(rest, ".data", 5)) {
+			a->current = JIT_DATA;
+		}
+		else if (length == 7 && !strncmp(rest, ".rodata", 7)) {
+			a->current = JIT_RODATA;
+		}
+		else if (length == 14 && !strncmp(rest, "cminor_strings", 14)) {
+			a->current = JIT_STRINGS;
+		}
+		else if (length == 12 && !strncmp(rest, ".data.rel.ro", 12)) {
+			a->current = JIT_RELRO;
+		}
+		else if (length == 4 && !strncmp(rest, ".bss", 4)) {
+			a->current = JIT_BSS;
+		}
+		else {
+			jit_error(a, "unsupported section", rest);
+		}
+	}
+	else if (!strcmp(directive, ".globl")) {
+		hash_table_insert(a->globals, rest, (void*) 1);
+		struct jit_symbol* s = hash_table_lookup(a->symbols, rest);
+		if (s) {
+			s->is_function = s->section == JIT_TEXT;
+		}
+	}
+	else if (!strcmp(directive, ".align")) {
+		int alignment = atoi(rest);
+		if (alignment <= 0) {
+			jit_error(a, "invalid alignment", rest);
+		}
+		if (alignment > a->sections[a->current].alignment) {
+			a->sections[a->current].alignment = alignment;
+		}
+		while(a->sections[a->current].size % alignment) {
+			jit_emit(a, (a->current == JIT_TEXT) ? 0x90 : 0);
+		}
+	}
+	else if (!strcmp(directive, ".zero")) {
+		int count = atoi(rest);
+		while(count-- > 0) {
+			jit_emit(a, 0);
+		}
+	}
+	else if (!strcmp(directive, ".quad") || !strcmp(directive, ".byte")) {
+		int is_quad = !strcmp(directive, ".quad");
+		char* item = strtok(rest, ",");
+		while(item) {
+			while(isspace(*item)) {
+				item++;
+			}
+
+			if (isdigit(*item) || *item == '-') {
+				long value = (*item == '-') ? strtol(item, 0, 0) : (long) strtoul(item, 0, 0);
+				if (is_quad) {
+					jit_emit64(a, value);
+				}
+				else {
+					jit_emit(a, value & 0xFF);
+				}
+			}
+			else if (is_quad) {
+				char* end = item;
+				while(*end && *end != '+' && *end != '-' && !isspace(*end)) {
+					end++;
+				}
+				long addend = (*end == '+' || *end == '-') ? strtol(end, 0, 0) : 0;
+				*end = 0;
+				jit_add_fixup(a, item, addend, 1);
+				jit_emit64(a, 0);
+			}
+			else {
+				jit_error(a, "invalid byte", item);
+			}
+
+			item = strtok(0, ",");
+		}
+	}
+	else if (!strcmp(directive, ".string")) {
+		char* spelling = strdup(rest + 1);
+		char* end = strrchr(spelling, '"');
+		if (*rest != '"' || !end) {
+			jit_error(a, "invalid string", rest);
+		}
+		*end = 0;
+
+		// Nothing reads past the first NUL
+		long length;
+		char* contents = expr_decode_string_spelling(spelling, &length);
+		long i;
+		for(i = 0; i <= length; i++) {
+			jit_emit(a, contents[i]);
+		}
+		free(contents);
+		free(spelling);
+	}
+	else {
+		jit_error(a, "unsupported directive", directive);
+	}
+
+}
+
+void jit_instruction(struct jit_assembler* a, char* m, struct jit_operand* op, int n) {
+
+	struct jit_operand* src = &op[0];
+	struct jit_operand* dst = &op[(n > 0) ? n - 1 : 0];
+	int src_mem = n > 0 && (src->kind == JIT_MEM || src->kind == JIT_RIP);
+	int dst_mem = n > 0 && (dst->kind == JIT_MEM || dst->kind == JIT_RIP);
+	int dst_rm = n > 0 && (dst->kind == JIT_REG || dst_mem);
+	int length = strlen(m);
+	int cc;
+
+	// The quadword suffix is optional on the arithmetic operations
+	int arithmetic = -1;
+	int byte_arithmetic = -1;
+	int i;
+	for(i = 0; i < 8; i++) {
+		int l = strlen(jit_arithmetic_names[i]);
+		if (!strncmp(m, jit_arithmetic_names[i], l) && (!m[l] || (m[l] == 'Q' && !m[l + 1]))) {
+			arithmetic = i;
+		}
+		if (!strncmp(m, jit_arithmetic_names[i], l) && m[l] == 'B' && !m[l + 1]) {
+			byte_arithmetic = i;
+		}
+	}
+
+	if (n == 2 && (!strcmp(m, "MOVQ") || !strcmp(m, "MOV"))) {
+		if (src->kind == JIT_IMM && dst->kind == JIT_REG && src->value != (int) src->value) {
+			jit_emit_rex(a, 1, 0, dst, 0);
+			jit_emit(a, 0xB8 + (dst->reg & 7));
+			jit_emit64(a, src->value);
+		}
+		else if (src->kind == JIT_IMM && dst_rm && src->value == (int) src->value) {
+			jit_emit_op(a, JIT_REX_W, 0, 0xC7, 0, dst);
+			jit_emit32(a, src->value);
+		}
+		else if (src->kind == JIT_REG && dst_rm) {
+			jit_emit_op(a, JIT_REX_W, 0, 0x89, src->reg, dst);
+		}
+		else if (src_mem && dst->kind == JIT_REG) {
+			jit_emit_op(a, JIT_REX_W, 0, 0x8B, dst->reg, src);
+		}
+		else {
+			jit_error(a, "unsupported operands for", m);
+		}
+	}
+	else if (n == 2 && !strcmp(m, "MOVB")) {
+		int rex = (src->kind == JIT_BYTE_REG && src->reg >= 4) ? JIT_REX : 0;
+		if (src->kind == JIT_IMM && (dst_mem || dst->kind == JIT_BYTE_REG)) {
+			rex = (dst->kind == JIT_BYTE_REG && dst->reg >= 4) ? JIT_REX : 0;
+			jit_emit_op(a, rex, 0, 0xC6, 0, dst);
+			jit_emit(a, src->value & 0xFF);
+		}
+		else if (src->kind == JIT_BYTE_REG && (dst_mem || dst->kind == JIT_BYTE_REG)) {
+			jit_emit_op(a, rex, 0, 0x88, src->reg, dst);
+		}
+		else if (src_mem && dst->kind == JIT_BYTE_REG) {
+			rex = (dst->reg >= 4) ? JIT_REX : 0;
+			jit_emit_op(a, rex, 0, 0x8A, dst->reg, src);
+		}
+		else {
+			jit_error(a, "unsupported operands for", m);
+		}
+	}
+	else if (n == 2 && byte_arithmetic >= 0 && src->kind == JIT_IMM && (dst_mem || dst->kind == JIT_BYTE_REG)) {
+		// Only the immediate forms, which step char and boolean elements
+		int rex = (dst->kind == JIT_BYTE_REG && dst->reg >= 4) ? JIT_REX : 0;
+		jit_emit_op(a, rex, 0, 0x80, byte_arithmetic, dst);
+		jit_emit(a, src->value & 0xFF);
+	}
+	else if (n == 2 && !strcmp(m, "MOVZBQ") && (src->kind == JIT_BYTE_REG || src_mem) && dst->kind == JIT_REG) {
+		jit_emit_op(a, JIT_REX_W, 0, 0x0FB6, dst->reg, src);
+	}
+	else if (n == 2 && !strcmp(m, "LEAQ") && src_mem && dst->kind == JIT_REG) {
+		jit_emit_op(a, JIT_REX_W, 0, 0x8D, dst->reg, src);
+	}
+	else if (n == 2 && arithmetic >= 0) {
+		if (src->kind == JIT_IMM && dst_rm && src->value == (signed char) src->value) {
+			jit_emit_op(a, JIT_REX_W, 0, 0x83, arithmetic, dst);
+			jit_emit(a, src->value & 0xFF);
+		}
+		else if (src->kind == JIT_IMM && dst_rm && src->value == (int) src->value) {
+			jit_emit_op(a, JIT_REX_W, 0, 0x81, arithmetic, dst);
+			jit_emit32(a, src->value);
+		}
+		else if (src->kind == JIT_REG && dst_rm) {
+			jit_emit_op(a, JIT_REX_W, 0, arithmetic * 8 + 0x01, src->reg, dst);
+		}
+		else if (src_mem && dst->kind == JIT_REG) {
+			jit_emit_op(a, JIT_REX_W, 0, arithmetic * 8 + 0x03, dst->reg, src);
+		}
+		else {
+			jit_error(a, "unsupported operands for", m);
+		}
+	}
+	else if (n == 2 && !strcmp(m, "TESTQ") && dst_rm) {
+		if (src->kind == JIT_REG) {
+			jit_emit_op(a, JIT_REX_W, 0, 0x85, src->reg, dst);
+		}
+		else if (src->kind == JIT_IMM && src->value == (int) src->value) {
+			jit_emit_op(a, JIT_REX_W, 0, 0xF7, 0, dst);
+			jit_emit32(a, src->value);
+		}
+		else {
+			jit_error(a, "unsupported operands for", m);
+		}
+	}
+	else if (n == 2 && !strcmp(m, "IMULQ") && dst->kind == JIT_REG) {
+		if (src->kind == JIT_IMM && src->value == (signed char) src->value) {
+			jit_emit_op(a, JIT_REX_W, 0, 0x6B, dst->reg, dst);
+			jit_emit(a, src->value & 0xFF);
+		}
+		else if (src->kind == JIT_IMM && src->value == (int) src->value) {
+			jit_emit_op(a, JIT_REX_W, 0, 0x69, dst->reg, dst);
+			jit_emit32(a, src->value);
+		}
+		else if (src->kind == JIT_REG || src_mem) {
+			jit_emit_op(a, JIT_REX_W, 0, 0x0FAF, dst->reg, src);
+		}
+		else {
+			jit_error(a, "unsupported operands for", m);
+		}
+	}
+	else if (n == 2 && (!strcmp(m, "SHLQ") || !strcmp(m, "SHRQ") || !strcmp(m, "SARQ")) && dst_rm) {
+		int extension = (m[1] == 'H') ? ((m[2] == 'L') ? 4 : 5) : 7;
+		if (src->kind == JIT_IMM) {
+			jit_emit_op(a, JIT_REX_W, 0, 0xC1, extension, dst);
+			jit_emit(a, src->value & 0x3F);
+		}
+		else if (src->kind == JIT_BYTE_REG && src->reg == 1) {
+			jit_emit_op(a, JIT_REX_W, 0, 0xD3, extension, dst);
+		}
+		else {
+			jit_error(a, "unsupported operands for", m);
+		}
+	}
+	else if (n == 1 && (!strcmp(m, "NEGQ") || !strcmp(m, "NOT") || !strcmp(m, "NOTQ") || !strcmp(m, "IDIVQ")) && dst_rm) {
+		int extension = (m[0] == 'N') ? ((m[1] == 'E') ? 3 : 2) : 7;
+		jit_emit_op(a, JIT_REX_W, 0, 0xF7, extension, dst);
+	}
+	else if (n == 1 && !strncmp(m, "SET", 3) && (cc = jit_condition(m + 3)) >= 0 && (dst->kind == JIT_BYTE_REG || dst_mem)) {
+		int rex = (dst->kind == JIT_BYTE_REG && dst->reg >= 4) ? JIT_REX : 0;
+		jit_emit_op(a, rex, 0, 0x0F90 + cc, 0, dst);
+	}
+	else if (n == 2 && !strncmp(m, "CMOV", 4) && (cc = jit_condition(m + 4)) >= 0 && dst->kind == JIT_REG && (src->kind == JIT_REG || src_mem)) {
+		jit_emit_op(a, JIT_REX_W, 0, 0x0F40 + cc, dst->reg, src);
+	}
+	else if (n == 1 && src->kind == JIT_LABEL && !strcmp(m, "JMP")) {
+		jit_emit(a, 0xE9);
+		jit_emit_rel32(a, src->symbol);
+	}
+	else if (n == 1 && src->kind == JIT_LABEL && !strcmp(m, "CALL")) {
+		jit_emit(a, 0xE8);
+		jit_emit_rel32(a, src->symbol);
+	}
+	else if (n == 1 && src->kind == JIT_LABEL && m[0] == 'J' && (cc = jit_condition(m + 1)) >= 0) {
+		jit_emit(a, 0x0F);
+		jit_emit(a, 0x80 + cc);
+		jit_emit_rel32(a, src->symbol);
+	}
+	else if (n == 1 && (!strcmp(m, "PUSHQ") || !strcmp(m, "POPQ"))) {
+		int push = m[1] == 'U';
+		if (src->kind == JIT_REG) {
+			jit_emit_rex(a, 0, 0, src, 0);
+			jit_emit(a, ((push) ? 0x50 : 0x58) + (src->reg & 7));
+		}
+		else if (src->kind == JIT_IMM && push && src->value == (int) src->value) {
+			jit_emit(a, 0x68);
+			jit_emit32(a, src->value);
+		}
+		else if (src_mem) {
+			jit_emit_op(a, 0, 0, (push) ? 0xFF : 0x8F, (push) ? 6 : 0, src);
+		}
+		else {
+			jit_error(a, "unsupported operands for", m);
+		}
+	}
+	else if (n == 0 && (!strcmp(m, "ret") || !strcmp(m, "RET"))) {
+		jit_emit(a, 0xC3);
+	}
+	else if (n == 0 && !strcmp(m, "CQO")) {
+		jit_emit(a, 0x48);
+		jit_emit(a, 0x99);
+	}
+	else if (n == 0 && !strcmp(m, "CDQ")) {
+		jit_emit(a, 0x99);
+	}
+	else if (n == 0 && length == 5 && (!strncmp(m, "MOVS", 4) || !strncmp(m, "STOS", 4)) && (m[4] == 'Q' || m[4] == 'B')) {
+		if (m[4] == 'Q') {
+			jit_emit(a, 0x48);
+		}
+		jit_emit(a, ((m[0] == 'M') ? 0xA4 : 0xAA) + (m[4] == 'Q'));
+	}
+	else if (n == 2 && !strcmp(m, "PXOR") && src->kind == JIT_XMM && dst->kind == JIT_XMM) {
+		jit_emit_op(a, 0, 0x66, 0x0FEF, dst->reg, src);
+	}
+	else if (n == 2 && !strcmp(m, "MOVAPS") && src->kind == JIT_XMM && (dst_mem || dst->kind == JIT_XMM)) {
+		jit_emit_op(a, 0, 0, 0x0F29, src->reg, dst);
+	}
+	else if (n == 2 && !strcmp(m, "MOVAPS") && src_mem && dst->kind == JIT_XMM) {
+		jit_emit_op(a, 0, 0, 0x0F28, dst->reg, src);
+	}
+	else {
+		jit_error(a, "unsupported instruction", m);
+	}
+
+}
+
+// Returns 0 if text is not an operand the assembler understands
+int jit_parse_operand(const char* text, struct jit_operand* op) {
+
+	memset(op, 0, sizeof(*op));
+	op->base = -1;
+	op->index = -1;
+	op->scale = 1;
+
+	char* end;
+
+	if (text[0] == '%') {
+		op->reg = jit_register(text + 1, &op->kind);
+		return op->reg >= 0;
+	}
+
+	if (text[0] == '$') {
+		op->kind = JIT_IMM;
+		op->value = strtol(text + 1, &end, 0);
+		return end != text + 1 && !*end;
+	}
+
+	const char* paren = strchr(text, '(');
+	if (!paren) {
+		if (!isalpha(text[0]) && text[0] != '_' && text[0] != '.') {
+			return 0;
+		}
+		op->kind = JIT_LABEL;
+		op->symbol = strdup(text);
+		return 1;
+	}
+
+	// Displacement, a number or a symbol with an optional offset
+	const char* c = text;
+	if (isalpha(*c) || *c == '_' || *c == '.') {
+		while(c < paren && *c != '+' && *c != '-') {
+			c++;
+		}
+		op->symbol = strndup(text, c - text);
+	}
+	if (c < paren) {
+		op->value = strtol(c, &end, 0);
+		if (end != paren) {
+			return 0;
+		}
+	}
+
+	if (!strcmp(paren, "(%rip)")) {
+		op->kind = JIT_RIP;
+		return op->symbol != 0;
+	}
+
+	if (op->symbol) {
+		return 0;
+	}
+
+	op->kind = JIT_MEM;
+	jit_operand_t kind;
+	char inside[64];
+	strncpy(inside, paren + 1, sizeof(inside) - 1);
+	inside[sizeof(inside) - 1] = 0;
+
+	char* close = strchr(inside, ')');
+	if (!close || close[1]) {
+		return 0;
+	}
+	*close = 0;
+
+	char* part[3] = {inside, 0, 0};
+	int parts = 1;
+	char* p;
+	for(p = inside; *p; p++) {
+		if (*p == ',') {
+			if (parts == 3) {
+				return 0;
+			}
+			*p = 0;
+			part[parts++] = p + 1;
+		}
+	}
+
+	if (*part[0]) {
+		if (part[0][0] != '%' || (op->base = jit_register(part[0] + 1, &kind)) < 0 || kind != JIT_REG) {
+			return 0;
+		}
+	}
+
+	if (parts > 1) {
+		if (part[1][0] != '%' || (op->index = jit_register(part[1] + 1, &kind)) < 0 || kind != JIT_REG) {
+			return 0;
+		}
+	}
+
+	if (parts > 2) {
+		op->scale = atoi(part[2]);
+		if (op->scale != 1 && op->scale != 2 && op->scale != 4 && op->scale != 8) {
+			return 0;
+		}
+	}
+
+	return op->base >= 0 || op->index >= 0;
+}
+
+// Number of the register called name, or -1
+int jit_register(const char* name, jit_operand_t* kind) {
+
+	int i;
+	for(i = 0; i < 16; i++) {
+		if (!strcmp(jit_register_names[i], name)) {
+			*kind = JIT_REG;
+			return i;
+		}
+	}
+
+	for(i = 0; i < 8; i++) {
+		if (!strcmp(jit_byte_register_names[i], name)) {
+			*kind = JIT_BYTE_REG;
+			return i;
+		}
+	}
+
+	// Byte registers r8b to r15b
+	int length = strlen(name);
+	if (length > 2 && length < 5 && name[0] == 'r' && name[length - 1] == 'b') {
+		char wide[8];
+		strncpy(wide, name, length - 1);
+		wide[length - 1] = 0;
+		int r = jit_register(wide, kind);
+		if (r >= 8) {
+			*kind = JIT_BYTE_REG;
+			return r;
+		}
+	}
+
+	if (!strncmp(name, "xmm", 3) && isdigit(name[3])) {
+		int r = atoi(name + 3);
+		if (r < 16) {
+			*kind = JIT_XMM;
+			return r;
+		}
+	}
+
+	return -1;
+}
+
+// Encoding of the condition named by suffix, or -1
+int jit_condition(const char* suffix) {
+
+	int i;
+	for(i = 0; i < 16; i++) {
+		if (!strcmp(jit_condition_names[i], suffix)) {
+			return i;
+		}
+	}
+
+	if (!strcmp(suffix, "Z")) {
+		return 4;
+	}
+	if (!strcmp(suffix, "NZ")) {
+		return 5;
+	}
+
+	return -1;
+}
+
+// Define the label name at the current position
+void jit_define(struct jit_assembler* a, const char* name) {
+
+	if (hash_table_lookup(a->symbols, name)) {
+		jit_error(a, "symbol defined twice", name);
+	}
+
+	struct jit_symbol* s = malloc(sizeof(struct jit_symbol));
+	s->section = a->current;
+	s->offset = a->sections[a->current].size;
+	s->is_function = a->current == JIT_TEXT && hash_table_lookup(a->globals, name) != 0;
+	hash_table_insert(a->symbols, name, s);
+
+}
+
+void jit_emit(struct jit_assembler* a, int byte) {
+
+	struct jit_buffer* b = &a->sections[a->current];
+	if (b->size == b->capacity) {
+		b->capacity = (b->capacity) ? b->capacity * 2 : 4096;
+		b->bytes = realloc(b->bytes, b->capacity);
+	}
+	b->bytes[b->size++] = byte;
+
+}
+
+void jit_emit32(struct jit_assembler* a, long value) {
+
+	int i;
+	for(i = 0; i < 4; i++) {
+		jit_emit(a, (value >> (8 * i)) & 0xFF);
+	}
+
+}
+
+void jit_emit64(struct jit_assembler* a, long value) {
+
+	int i;
+	for(i = 0; i < 8; i++) {
+		jit_emit(a, (value >> (8 * i)) & 0xFF);
+	}
+
+}
+
+// Emit the REX prefix when the operand size, an extended register or a byte
+// register other than al to bl needs one
+void jit_emit_rex(struct jit_assembler* a, int w, int reg, struct jit_operand* rm, int force) {
+
+	int rex = 0x40 | (w << 3) | ((reg >> 3) << 2);
+	if (rm->kind == JIT_MEM) {
+		if (rm->index >= 0) {
+			rex |= (rm->index >> 3) << 1;
+		}
+		if (rm->base >= 0) {
+			rex |= rm->base >> 3;
+		}
+	}
+	else if (rm->kind != JIT_RIP) {
+		rex |= rm->reg >> 3;
+	}
+
+	if (rex != 0x40 || force) {
+		jit_emit(a, rex);
+	}
+
+}
+
+// Emit the ModRM byte for reg and rm, followed by any SIB byte and
+// displacement
+void jit_emit_modrm(struct jit_assembler* a, int reg, struct jit_operand* rm) {
+
+	reg = (reg & 7) << 3;
+
+	if (rm->kind == JIT_RIP) {
+		jit_emit(a, 0x05 | reg);
+		jit_add_fixup(a, rm->symbol, rm->value, 0);
+		jit_emit32(a, 0);
+		return;
+	}
+
+	if (rm->kind != JIT_MEM) {
+		jit_emit(a, 0xC0 | reg | (rm->reg & 7));
+		return;
+	}
+
+	int scale = (rm->scale == 8) ? 3 : (rm->scale == 4) ? 2 : (rm->scale == 2) ? 1 : 0;
+	int index = (rm->index >= 0) ? (rm->index & 7) : 4;
+
+	if (rm->base < 0) {
+		jit_emit(a, 0x04 | reg);
+		jit_emit(a, (scale << 6) | (index << 3) | 5);
+		jit_emit32(a, rm->value);
+		return;
+	}
+
+	int base = rm->base & 7;
+	int mod = (rm->value == 0 && base != 5) ? 0 : (rm->value == (signed char) rm->value) ? 1 : 2;
+
+	if (rm->index >= 0 || base == 4) {
+		jit_emit(a, (mod << 6) | reg | 4);
+		jit_emit(a, (scale << 6) | (index << 3) | base);
+	}
+	else {
+		jit_emit(a, (mod << 6) | reg | base);
+	}
+
+	if (mod == 1) {
+		jit_emit(a, rm->value & 0xFF);
+	}
+	else if (mod == 2) {
+		jit_emit32(a, rm->value);
+	}
+
+}
+
+// Emit a 32 bit displacement to symbol, counted from the end of the
+// instruction
+void jit_emit_rel32(struct jit_assembler* a, const char* symbol) {
+
+	jit_add_fixup(a, symbol, 0, 0);
+	jit_emit32(a, 0);
+
+}
+
+// Record a reference to symbol at the current position
+void jit_add_fixup(struct jit_assembler* a, const char* symbol, long addend, int absolute) {
+
+	if (a->num_fixups == a->capacity) {
+		a->capacity = (a->capacity) ? a->capacity * 2 : 256;
+		a->fixups = realloc(a->fixups, sizeof(struct jit_fixup) * a->capacity);
+	}
+
+	struct jit_fixup* f = &a->fixups[a->num_fixups++];
+	f->section = a->current;
+	f->offset = a->sections[a->current].size;
+	f->next = f->offset + 4;
+	f->absolute = absolute;
+	f->symbol = strdup(symbol);
+	f->addend = addend;
+
+}
+
+// Emit an instruction made of an optional prefix, a REX prefix if needed, a
+// one byte or 0x0F escaped opcode and a ModRM operand
+void jit_emit_op(struct jit_assembler* a, int rex, int prefix, int opcode, int reg, struct jit_operand* rm) {
+
+	if (prefix) {
+		jit_emit(a, prefix);
+	}
+
+	jit_emit_rex(a, rex & JIT_REX_W, reg, rm, rex & JIT_REX);
+
+	if (opcode > 0xFF) {
+		jit_emit(a, opcode >> 8);
+	}
+	jit_emit(a, opcode & 0xFF);
+
+	jit_emit_modrm(a, reg, rm);
+
+}
+
+void* jit_lookup_runtime(const char* name) {
+
+	int i;
+	for(i = 0; i < jit_runtime_count; i++) {
+		if (!strcmp(jit_runtime[i].name, name)) {
+			return jit_runtime[i].address;
+		}
+	}
+
+	return 0;
+}
+
+// Write /tmp/perf-PID.map, which perf reads to name code it has no file for
+void jit_write_perf_map(struct jit_assembler* a, unsigned char* text) {
+
+	char path[64];
+	snprintf(path, sizeof(path), "/tmp/perf-%d.map", (int) getpid());
+
+	FILE* fp = fopen(path, "w");
+	if (!fp) {
+		return;
+	}
+
+	// Each function runs up to the next one or the end of the code
+	int count = 0;
+	char* key;
+	void* value;
+	hash_table_firstkey(a->symbols);
+	while(hash_table_nextkey(a->symbols, &key, &value)) {
+		count++;
+	}
+
+	int* starts = malloc(sizeof(int) * (count + 1));
+	char** names = malloc(sizeof(char*) * (count + 1));
+	int n = 0;
+
+	hash_table_firstkey(a->symbols);
+	while(hash_table_nextkey(a->symbols, &key, &value)) {
+		struct jit_symbol* s = value;
+		if (s->is_function) {
+			starts[n] = s->offset;
+			names[n] = key;
+			n++;
+		}
+	}
+
+	int i;
+	int j;
+	for(i = 0; i < n; i++) {
+		int end = a->sections[JIT_TEXT].size;
+		for(j = 0; j < n; j++) {
+			if (starts[j] > starts[i] && starts[j] < end) {
+				end = starts[j];
+			}
+		}
+		fprintf(fp, "%lx %x %s\n", (unsigned long) (text + starts[i]), end - starts[i], names[i]);
+	}
+
+	free(starts);
+	free(names);
+	fclose(fp);
+
+}
+
+void jit_error(struct jit_assembler* a, const char* message, const char* detail) {
+
+	if (a->line) {
+		printf("Error: Line %d of the generated code: %s %s. Exiting...\n", a->line, message, detail);
+	}
+	else {
+		printf("Error: %s %s. Exiting...\n", message, detail);
+	}
+	exit(1);
+
+}
@@ -0,0 +1,109 @@
+// jit.h
+// Header file for the in-process assembler, which encodes the generated
+// assembly into executable memory, binds the runtime library and calls main
+
+#ifndef JIT_H
+#define JIT_H
+
+#include <stdio.h>
+#include "hash_table.h"
+
+// Sections in the order they are laid out
+typedef enum {
+	JIT_TEXT,
+	JIT_DATA,
+	JIT_RODATA,
+	JIT_STRINGS,
+	JIT_RELRO,
+	JIT_BSS,
+	JIT_SECTIONS
+} jit_section_t;
+
+typedef enum {
+	JIT_NONE,
+	JIT_REG,
+	JIT_BYTE_REG,
+	JIT_XMM,
+	JIT_IMM,
+	JIT_MEM,
+	JIT_RIP,
+	JIT_LABEL
+} jit_operand_t;
+
+// One operand in AT&T syntax
+// Memory operands without a base or index register keep -1 there
+struct jit_operand {
+	jit_operand_t kind;
+	int reg;
+	int base;
+	int index;
+	int scale;
+	long value;
+	char* symbol;
+};
+
+struct jit_buffer {
+	unsigned char* bytes;
+	int size;
+	int capacity;
+	int alignment;
+};
+
+// Where a symbol was defined
+struct jit_symbol {
+	jit_section_t section;
+	int offset;
+	int is_function;
+};
+
+// A 32 bit displacement relative to the end of an instruction, or a 64 bit
+// absolute address, to fill in once every symbol has its final address
+struct jit_fixup {
+	jit_section_t section;
+	int offset;
+	int next;
+	int absolute;
+	char* symbol;
+	long addend;
+};
+
+struct jit_assembler {
+	struct jit_buffer sections[JIT_SECTIONS];
+	jit_section_t current;
+	struct hash_table* symbols;
+	struct hash_table* globals;
+	struct jit_fixup* fixups;
+	int num_fixups;
+	int capacity;
+	int line;
+};
+
+// A function of the runtime library that generated code may call
+struct jit_binding {
+	const char* name;
+	void* address;
+};
+
+int jit_run(char* text, int argc, char** argv);
+void jit_init(struct jit_assembler* a);
+void jit_assemble(struct jit_assembler* a, char* text);
+void jit_assemble_line(struct jit_assembler* a, char* line);
+void jit_directive(struct jit_assembler* a, char* directive, char* rest);
+void jit_instruction(struct jit_assembler* a, char* mnemonic, struct jit_operand* op, int n);
+int jit_parse_operand(const char* text, struct jit_operand* op);
+int jit_register(const char* name, jit_operand_t* kind);
+int jit_condition(const char* suffix);
+void jit_define(struct jit_assembler* a, const char* name);
+void jit_emit(struct jit_assembler* a, int byte);
+void jit_emit32(struct jit_assembler* a, long value);
+void jit_emit64(struct jit_assembler* a, long value);
+void jit_emit_rex(struct jit_assembler* a, int w, int reg, struct jit_operand* rm, int force);
+void jit_emit_modrm(struct jit_assembler* a, int reg, struct jit_operand* rm);
+void jit_emit_rel32(struct jit_assembler* a, const char* symbol);
+void jit_add_fixup(struct jit_assembler* a, const char* symbol, long addend, int absolute);
+void jit_emit_op(struct jit_assembler* a, int w, int prefix, int opcode, int reg, struct jit_operand* rm);
+void* jit_lookup_runtime(const char* name);
+void jit_write_perf_map(struct jit_assembler* a, unsigned char* text);
+void jit_error(struct jit_assembler* a, const char* message, const char* detail);
+
+#endif
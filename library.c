@@ -24,8 +24,10 @@ Is effectively this C code:
 x = integer_power(a,b);
 */
 
+#include "library.h"
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
 
 void print_integer( long x )
 {
@@ -57,8 +59,84 @@ long integer_power( long x, long y )
 	return result;
 }
 
+/*
+Every string literal of a C-minor program is emitted into one pool,
+preceded by its length and hash:
+
+.quad length, hash
+.strN: .string "..."
+
+The pools of all units are gathered into the cminor_strings section, which
+the linker bounds with __start_cminor_strings and __stop_cminor_strings.
+Strings from anywhere else are plain NUL-terminated strings, whose length
+and hash are computed when asked for.
+*/
+
+struct string_header {
+	long length;
+	unsigned long hash;
+};
+
+extern const char __start_cminor_strings[] __attribute__((weak));
+extern const char __stop_cminor_strings[] __attribute__((weak));
+
+static const struct string_header* string_header( const char *s )
+{
+	uintptr_t p = (uintptr_t) s;
+	if(p >= (uintptr_t) __start_cminor_strings + sizeof(struct string_header) && p < (uintptr_t) __stop_cminor_strings) {
+		return (const struct string_header*) s - 1;
+	}
+	return 0;
+}
+
+long string_length( const char *s )
+{
+	const struct string_header* h = string_header(s);
+	if(h) {
+		return h->length;
+	}
+	return strlen(s);
+}
+
+long string_hash( const char *s )
+{
+	const struct string_header* h = string_header(s);
+	if(h) {
+		return h->hash;
+	}
+
+	// 64 bit FNV-1a, matching the hashes the compiler stores
+	unsigned long hash = 14695981039346656037UL;
+	while(*s) {
+		hash ^= (unsigned char) *s;
+		hash *= 1099511628211UL;
+		s++;
+	}
+	return hash;
+}
+
 long string_equals(const char* s1, const char* s2) {
 
+	// Equal literals are interned, so they usually share one address
+	if(s1 == s2) {
+		return 1;
+	}
+
+	// Pooled strings of different length or hash cannot be equal
+	const struct string_header* h1 = string_header(s1);
+	const struct string_header* h2 = string_header(s2);
+	if(h1 && h2) {
+		if(h1->length != h2->length || h1->hash != h2->hash) {
+			return 0;
+		}
+		return !memcmp(s1, s2, h1->length);
+	}
+
+	// Most unequal strings already differ in their first character
+	if(*s1 != *s2) {
+		return 0;
+	}
+
 	if(strcmp(s1, s2)) {
 		return 0;
 	}
@@ -0,0 +1,17 @@
+// library.h
+// Header file for the runtime library, which compiled programs call and which
+// is also linked into the compiler for -run and -interp
+
+#ifndef LIBRARY_H
+#define LIBRARY_H
+
+void print_integer(long x);
+void print_string(const char* s);
+void print_boolean(int b);
+void print_character(char c);
+long integer_power(long x, long y);
+long string_length(const char* s);
+long string_hash(const char* s);
+long string_equals(const char* s1, const char* s2);
+
+#endif
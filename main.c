@@ -8,6 +8,17 @@
 
 #include "decl.h"
 #include "scope.h"
+#include "consteval.h"
+#include "effects.h"
+#include "ipcp.h"
+#include "reach.h"
+#include "frame.h"
+#include "sched.h"
+#include "jit.h"
+#include "object.h"
+#include "vm.h"
+#include "cgen.h"
+#include "arena.h"
 
 extern FILE *yyin;
 extern char* yytext;
@@ -20,18 +31,43 @@ void usage();
 int main(int argc, char* argv[]) {
 
 	// Print usage if command line arguments are incorrect
-	if(argc != 3 && argc != 4) {
+	if(argc < 3 || (argc > 5 && strcmp(argv[1], "-run") && strcmp(argv[1], "-interp"))) {
 		usage();
 	}
 	
-	if (argc == 3 && (strcmp(argv[1], "-scan") && strcmp(argv[1], "-print") && strcmp(argv[1], "-resolve") && strcmp(argv[1], "-typecheck"))) {
+	if (argc == 3 && (strcmp(argv[1], "-scan") && strcmp(argv[1], "-print") && strcmp(argv[1], "-resolve") && strcmp(argv[1], "-typecheck") && strcmp(argv[1], "-dump-effects") && strcmp(argv[1], "-run") && strcmp(argv[1], "-interp"))) {
 		usage();
 	}
 
-	if (argc == 4 && (strcmp(argv[1], "-codegen"))) {
+	if (argc >= 4 && (strcmp(argv[1], "-codegen") && strcmp(argv[1], "-c") && strcmp(argv[1], "-run") && strcmp(argv[1], "-interp") && strcmp(argv[1], "-bytecode") && strcmp(argv[1], "-emit-c"))) {
 		usage();
 	}
 
+	if (argc == 5 && (!strcmp(argv[1], "-bytecode") || !strcmp(argv[1], "-emit-c"))) {
+		usage();
+	}
+
+	// Pick the core to schedule instructions for
+	if (argc == 5 && strcmp(argv[1], "-run") && strcmp(argv[1], "-interp")) {
+		if (strncmp(argv[4], "-schedule=", 10)) {
+			usage();
+		}
+
+		sched_target = sched_find_model(argv[4] + 10);
+		if (!sched_target) {
+			printf("Error: Unknown scheduling model %s. Exiting...\n", argv[4] + 10);
+			return 1;
+		}
+	}
+
+	// A bytecode file runs without being compiled again
+	if (!strcmp(argv[1], "-interp")) {
+		struct vm_program* p = vm_load(argv[2]);
+		if (p) {
+			return vm_execute(p, argc - 2, argv + 2);
+		}
+	}
+
 	yyin = fopen(argv[2], "r");
 
 	// Handle opening errors
@@ -241,10 +277,34 @@ int main(int argc, char* argv[]) {
 			return 1;
 		}
 	}
-	else if (!strcmp(argv[1], "-codegen")) {
+	else if(!strcmp(argv[1], "-dump-effects")) {
 		if(yyparse()==0) {
 			scope_enter();
-			int result = decl_resolve(parser_result, 1);
+			int result = decl_resolve(parser_result, 0);
+			scope_exit();
+			if (!result || !decl_typecheck(parser_result)) {
+				return 1;
+			}
+
+			effects_analyze(parser_result);
+			effects_print(parser_result, stdout);
+		} else {
+			printf("parse failed!\n");
+			return 1;
+		}
+	}
+	else if (!strcmp(argv[1], "-codegen") || !strcmp(argv[1], "-c") || !strcmp(argv[1], "-run") || !strcmp(argv[1], "-interp") || !strcmp(argv[1], "-bytecode") || !strcmp(argv[1], "-emit-c")) {
+		// Run the program in this process or write an object file instead of
+		// writing its assembly
+		int run = !strcmp(argv[1], "-run");
+		int object = !strcmp(argv[1], "-c");
+		int interp = !strcmp(argv[1], "-interp");
+		int bytecode = !strcmp(argv[1], "-bytecode");
+		int emit_c = !strcmp(argv[1], "-emit-c");
+
+		if(yyparse()==0) {
+			scope_enter();
+			int result = decl_resolve(parser_result, !run && !interp && !bytecode && !emit_c);
 			scope_exit();
 			if (!result) {
 				return 1;
@@ -252,18 +312,104 @@ int main(int argc, char* argv[]) {
 
 			result = decl_typecheck(parser_result);
 			if(result) {
+				// Evaluate constant expressions and pure calls at compile time
+				effects_analyze(parser_result);
+				consteval_fold(parser_result);
+
+				// Move literal arguments into callees, then fold again
+				if (ipcp_propagate(parser_result)) {
+					effects_analyze(parser_result);
+					consteval_fold(parser_result);
+				}
+
+				// Share, hoist and drop calls to functions without side effects
+				effects_optimize(parser_result);
+
+				// Drop functions and globals that main never uses
+				parser_result = reach_prune(parser_result);
+
+				// Share frame slots between locals with disjoint lifetimes
+				frame_layout(parser_result);
+
+				// Compile to bytecode and interpret it or save it
+				if (interp || bytecode) {
+					int size;
+					char* image = vm_compile(parser_result, &size);
+					if (interp) {
+						struct vm_program* p = vm_open(image, size);
+						arena_release(&ast_arena);
+						return vm_execute(p, argc - 2, argv + 2);
+					}
+
+					if (!vm_write(image, size, argv[3])) {
+						printf("Error: File %s could not be written. Exiting...\n", argv[3]);
+						return 1;
+					}
+					free(image);
+					return 0;
+				}
+
+				// Translate to C for a C compiler to optimize
+				if (emit_c) {
+					FILE* fp = fopen(argv[3], "w");
+					if (fp == 0) {
+						printf("Error: File %s could not be opened. Exiting...\n", argv[3]);
+						return 1;
+					}
+
+					cgen_program(parser_result, argv[2], fp);
+					fclose(fp);
+					return 0;
+				}
+
 				// Generate the code
-				FILE* fp = fopen(argv[3], "w+");
+				FILE* fp = 0;
+				if (!run) {
+					fp = fopen(argv[3], "w+");
+
+					// Handle opening errors
+					if(fp == 0) {
+						printf("Error: File %s could not be opened. Exiting...\n", argv[3]);
+						return 1;
+					}
+				}
+				// Generate into memory first when the code will be rescheduled
+				// or assembled here
+				char* text = 0;
+				size_t size = 0;
+				FILE* out = fp;
+				if (sched_target || run || object) {
+					out = open_memstream(&text, &size);
+				}
+
+				// Each global selects its own section
+				decl_find_written_globals(parser_result);
+				decl_codegen_globals(parser_result, out);
+				expr_codegen_string_pool(out);
+				fprintf(out, ".text\n");
+				decl_codegen(parser_result, out);
 
-				// Handle opening errors
-				if(fp == 0) {
-					printf("Error: File %s could not be opened. Exiting...\n", argv[3]);
-					return 1;
+				// The program's arguments follow its file name
+				if (run) {
+					fclose(out);
+					arena_release(&ast_arena);
+					return jit_run(text, argc - 2, argv + 2);
+				}
+
+				// Reorder each straight-line region for the chosen core
+				if (sched_target) {
+					fclose(out);
+					char* scheduled = text;
+					out = (object) ? open_memstream(&text, &size) : fp;
+					sched_schedule(scheduled, out);
+					free(scheduled);
+				}
+
+				if (object) {
+					fclose(out);
+					object_write(text, fp);
+					free(text);
 				}
-				fprintf(fp, ".data\n");
-				decl_codegen_globals(parser_result, fp);
-				fprintf(fp, ".text\n");
-				decl_codegen(parser_result, fp);
 			}
 			else {
 				return !result;
@@ -274,11 +420,20 @@ int main(int argc, char* argv[]) {
 		}
 	}
 
+	// Everything the front end built goes at once
+	arena_release(&ast_arena);
+
 	return 0;
 
 }
 
 void usage() {
 	printf("Usage: cminor <options> <filename>\n");
+	printf("       cminor -codegen <filename> <output> [-schedule=generic|skylake|znver2]\n");
+	printf("       cminor -c <filename> <output.o> [-schedule=generic|skylake|znver2]\n");
+	printf("       cminor -run <filename> [arguments]\n");
+	printf("       cminor -interp <filename> [arguments]\n");
+	printf("       cminor -bytecode <filename> <output>\n");
+	printf("       cminor -emit-c <filename> <output.c>\n");
 	exit(1);
 }
@@ -0,0 +1,294 @@
+// object.c
+// Implementation of functions in object.h
+// The code is encoded by the assembler in jit.c. References inside one
+// section are filled in directly; any other reference becomes a relocation.
+// A reference to a local label goes through the symbol of its section, as
+// the system assembler does, so only functions and runtime functions need
+// symbols of their own.
+
+#include "object.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+const char* object_section_names[JIT_SECTIONS] = {".text", ".data", ".rodata", "cminor_strings", ".data.rel.ro", ".bss"};
+const char* object_relocation_names[JIT_SECTIONS] = {".rela.text", ".rela.data", ".rela.rodata", ".relacminor_strings", ".rela.data.rel.ro", ".rela.bss"};
+int object_section_flags[JIT_SECTIONS] = {SHF_ALLOC | SHF_EXECINSTR, SHF_ALLOC | SHF_WRITE, SHF_ALLOC, SHF_ALLOC, SHF_ALLOC | SHF_WRITE, SHF_ALLOC | SHF_WRITE};
+
+// The sections of the object file, at most the null section, six sections
+// of code and data, their relocations, the three tables and the stack note
+#define OBJECT_MAX_SECTIONS 17
+
+// Assemble text and write it to fp as a relocatable object file
+void object_write(char* text, FILE* fp) {
+
+	struct jit_assembler a;
+	jit_init(&a);
+	jit_assemble(&a, text);
+	a.line = 0;
+
+	struct jit_buffer symtab = {0};
+	struct jit_buffer strtab = {0};
+	struct jit_buffer shstrtab = {0};
+	struct jit_buffer relocations[JIT_SECTIONS];
+	memset(relocations, 0, sizeof(relocations));
+
+	// Symbol table index of each named symbol
+	struct hash_table* indices = hash_table_create(0, 0);
+
+	object_add_string(&strtab, "");
+	object_add_string(&shstrtab, "");
+
+	// The null symbol, one symbol per section, then named local symbols
+	Elf64_Sym symbol;
+	memset(&symbol, 0, sizeof(symbol));
+	object_append(&symtab, &symbol, sizeof(symbol));
+
+	int s;
+	for(s = 0; s < JIT_SECTIONS; s++) {
+		symbol.st_info = ELF64_ST_INFO(STB_LOCAL, STT_SECTION);
+		symbol.st_shndx = s + 1;
+		object_append(&symtab, &symbol, sizeof(symbol));
+	}
+
+	object_add_symbols(&a, &symtab, &strtab, indices, 1);
+	int first_global = symtab.size / sizeof(Elf64_Sym);
+	object_add_symbols(&a, &symtab, &strtab, indices, 0);
+
+	// Runtime functions and anything else defined elsewhere
+	int i;
+	for(i = 0; i < a.num_fixups; i++) {
+		const char* name = a.fixups[i].symbol;
+		if (hash_table_lookup(a.symbols, name) || hash_table_lookup(indices, name)) {
+			continue;
+		}
+
+		memset(&symbol, 0, sizeof(symbol));
+		symbol.st_name = object_add_string(&strtab, name);
+		symbol.st_info = ELF64_ST_INFO(STB_GLOBAL, STT_NOTYPE);
+		symbol.st_shndx = SHN_UNDEF;
+		hash_table_insert(indices, name, (void*) (long) (symtab.size / sizeof(Elf64_Sym)));
+		object_append(&symtab, &symbol, sizeof(symbol));
+	}
+
+	object_relocate(&a, indices, relocations);
+
+	struct object_section sections[OBJECT_MAX_SECTIONS];
+	int count = 0;
+	object_add_section(sections, &count, "", SHT_NULL, 0, 0, &shstrtab);
+
+	for(s = 0; s < JIT_SECTIONS; s++) {
+		object_add_section(sections, &count, object_section_names[s], (s == JIT_BSS) ? SHT_NOBITS : SHT_PROGBITS, object_section_flags[s], &a.sections[s], &shstrtab);
+		sections[count - 1].header.sh_addralign = a.sections[s].alignment;
+	}
+
+	int symtab_index = count;
+	for(s = 0; s < JIT_SECTIONS; s++) {
+		if (!relocations[s].size) {
+			continue;
+		}
+		symtab_index++;
+	}
+
+	for(s = 0; s < JIT_SECTIONS; s++) {
+		if (!relocations[s].size) {
+			continue;
+		}
+		object_add_section(sections, &count, object_relocation_names[s], SHT_RELA, SHF_INFO_LINK, &relocations[s], &shstrtab);
+		sections[count - 1].header.sh_link = symtab_index;
+		sections[count - 1].header.sh_info = s + 1;
+		sections[count - 1].header.sh_entsize = sizeof(Elf64_Rela);
+		sections[count - 1].header.sh_addralign = 8;
+	}
+
+	object_add_section(sections, &count, ".symtab", SHT_SYMTAB, 0, &symtab, &shstrtab);
+	sections[count - 1].header.sh_link = count;
+	sections[count - 1].header.sh_info = first_global;
+	sections[count - 1].header.sh_entsize = sizeof(Elf64_Sym);
+	sections[count - 1].header.sh_addralign = 8;
+
+	object_add_section(sections, &count, ".strtab", SHT_STRTAB, 0, &strtab, &shstrtab);
+
+	// Without this note the linker assumes the stack must be executable
+	struct jit_buffer note = {0};
+	object_add_section(sections, &count, ".note.GNU-stack", SHT_PROGBITS, 0, &note, &shstrtab);
+
+	// The names of the sections include its own
+	object_add_section(sections, &count, ".shstrtab", SHT_STRTAB, 0, &shstrtab, &shstrtab);
+
+	// Contents follow the file header, and the section headers come last
+	long offset = sizeof(Elf64_Ehdr);
+	for(i = 1; i < count; i++) {
+		Elf64_Shdr* h = &sections[i].header;
+		long alignment = (h->sh_addralign) ? h->sh_addralign : 1;
+		offset = (offset + alignment - 1) / alignment * alignment;
+		h->sh_offset = offset;
+		h->sh_size = sections[i].contents->size;
+		if (h->sh_type != SHT_NOBITS) {
+			offset += h->sh_size;
+		}
+	}
+	offset = (offset + 7) / 8 * 8;
+
+	Elf64_Ehdr header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.e_ident, ELFMAG, SELFMAG);
+	header.e_ident[EI_CLASS] = ELFCLASS64;
+	header.e_ident[EI_DATA] = ELFDATA2LSB;
+	header.e_ident[EI_VERSION] = EV_CURRENT;
+	header.e_ident[EI_OSABI] = ELFOSABI_SYSV;
+	header.e_type = ET_REL;
+	header.e_machine = EM_X86_64;
+	header.e_version = EV_CURRENT;
+	header.e_shoff = offset;
+	header.e_ehsize = sizeof(Elf64_Ehdr);
+	header.e_shentsize = sizeof(Elf64_Shdr);
+	header.e_shnum = count;
+	header.e_shstrndx = count - 1;
+	fwrite(&header, sizeof(header), 1, fp);
+
+	long position = sizeof(Elf64_Ehdr);
+	for(i = 1; i < count; i++) {
+		Elf64_Shdr* h = &sections[i].header;
+		if (h->sh_type == SHT_NOBITS) {
+			continue;
+		}
+		while(position < h->sh_offset) {
+			fputc(0, fp);
+			position++;
+		}
+		if (h->sh_size) {
+			fwrite(sections[i].contents->bytes, 1, h->sh_size, fp);
+		}
+		position += h->sh_size;
+	}
+	while(position < offset) {
+		fputc(0, fp);
+		position++;
+	}
+
+	for(i = 0; i < count; i++) {
+		fwrite(&sections[i].header, sizeof(Elf64_Shdr), 1, fp);
+	}
+
+	hash_table_delete(indices);
+
+}
+
+// Add a symbol for each named label that is local or global
+// Local labels starting with .L only exist in the assembly
+void object_add_symbols(struct jit_assembler* a, struct jit_buffer* symtab, struct jit_buffer* strtab, struct hash_table* indices, int local) {
+
+	char* key;
+	void* value;
+
+	hash_table_firstkey(a->symbols);
+	while(hash_table_nextkey(a->symbols, &key, &value)) {
+		struct jit_symbol* s = value;
+		int global = hash_table_lookup(a->globals, key) != 0;
+		if (global == local || (local && !strncmp(key, ".L", 2))) {
+			continue;
+		}
+
+		Elf64_Sym symbol;
+		memset(&symbol, 0, sizeof(symbol));
+		symbol.st_name = object_add_string(strtab, key);
+		symbol.st_info = ELF64_ST_INFO((global) ? STB_GLOBAL : STB_LOCAL, (s->section == JIT_TEXT) ? STT_FUNC : STT_OBJECT);
+		symbol.st_shndx = s->section + 1;
+		symbol.st_value = s->offset;
+
+		if (global) {
+			hash_table_insert(indices, key, (void*) (long) (symtab->size / sizeof(Elf64_Sym)));
+		}
+		object_append(symtab, &symbol, sizeof(symbol));
+	}
+
+}
+
+// Symbol table index to relocate against for name, with the section symbol
+// standing in for local labels
+int object_symbol_index(struct jit_assembler* a, struct hash_table* indices, const char* name) {
+
+	long index = (long) hash_table_lookup(indices, name);
+	if (index) {
+		return index;
+	}
+
+	struct jit_symbol* s = hash_table_lookup(a->symbols, name);
+	return s->section + 1;
+}
+
+// Fill in references within a section and turn the rest into relocations
+void object_relocate(struct jit_assembler* a, struct hash_table* indices, struct jit_buffer* relocations) {
+
+	int i;
+	for(i = 0; i < a->num_fixups; i++) {
+		struct jit_fixup* f = &a->fixups[i];
+		struct jit_symbol* s = hash_table_lookup(a->symbols, f->symbol);
+		unsigned char* place = a->sections[f->section].bytes + f->offset;
+
+		if (!f->absolute && s && s->section == f->section) {
+			int value = s->offset + f->addend - f->next;
+			memcpy(place, &value, 4);
+			continue;
+		}
+
+		Elf64_Rela r;
+		long addend = f->addend;
+		int index = object_symbol_index(a, indices, f->symbol);
+		int type;
+
+		if (s && !hash_table_lookup(indices, f->symbol)) {
+			addend += s->offset;
+		}
+
+		if (f->absolute) {
+			type = R_X86_64_64;
+		}
+		else {
+			// The displacement counts from the end of the instruction
+			addend -= f->next - f->offset;
+			type = (s) ? R_X86_64_PC32 : R_X86_64_PLT32;
+		}
+
+		r.r_offset = f->offset;
+		r.r_info = ELF64_R_INFO(index, type);
+		r.r_addend = addend;
+		object_append(&relocations[f->section], &r, sizeof(r));
+	}
+
+}
+
+void object_add_section(struct object_section* sections, int* count, const char* name, int type, int flags, struct jit_buffer* contents, struct jit_buffer* strings) {
+
+	static struct jit_buffer empty;
+
+	struct object_section* section = &sections[(*count)++];
+	memset(section, 0, sizeof(*section));
+	section->name = name;
+	section->contents = (contents) ? contents : &empty;
+	section->header.sh_name = (*name) ? object_add_string(strings, name) : 0;
+	section->header.sh_type = type;
+	section->header.sh_flags = flags;
+	section->header.sh_addralign = (type == SHT_NULL) ? 0 : 1;
+
+}
+
+// Returns the offset of s in the string table b
+int object_add_string(struct jit_buffer* b, const char* s) {
+
+	int offset = b->size;
+	object_append(b, s, strlen(s) + 1);
+	return offset;
+}
+
+void object_append(struct jit_buffer* b, const void* data, int size) {
+
+	while(b->size + size > b->capacity) {
+		b->capacity = (b->capacity) ? b->capacity * 2 : 4096;
+		b->bytes = realloc(b->bytes, b->capacity);
+	}
+	memcpy(b->bytes + b->size, data, size);
+	b->size += size;
+
+}
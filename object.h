@@ -0,0 +1,28 @@
+// object.h
+// Header file for the object file writer, which stores the machine code of
+// the in-process assembler as a relocatable ELF64 file for the system linker
+
+#ifndef OBJECT_H
+#define OBJECT_H
+
+#include "jit.h"
+#include <elf.h>
+#include <stdio.h>
+
+// Sections of the object file after the null section: the assembler's own
+// sections in order, then their relocations and the tables
+struct object_section {
+	const char* name;
+	Elf64_Shdr header;
+	struct jit_buffer* contents;
+};
+
+void object_write(char* text, FILE* fp);
+void object_add_symbols(struct jit_assembler* a, struct jit_buffer* symtab, struct jit_buffer* strtab, struct hash_table* indices, int local);
+int object_symbol_index(struct jit_assembler* a, struct hash_table* indices, const char* name);
+void object_relocate(struct jit_assembler* a, struct hash_table* indices, struct jit_buffer* relocations);
+void object_add_section(struct object_section* sections, int* count, const char* name, int type, int flags, struct jit_buffer* contents, struct jit_buffer* strings);
+int object_add_string(struct jit_buffer* b, const char* s);
+void object_append(struct jit_buffer* b, const void* data, int size);
+
+#endif
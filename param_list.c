@@ -3,6 +3,7 @@
 #include "scope.h"
 #include "symbol.h"
 #include "scratch.h"
+#include "arena.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -12,11 +13,12 @@ char* param_list_param_registers[6] = {"%rdi", "%rsi", "%rdx", "%rcx", "%r8", "%
 
 // Create and return param list struct
 struct param_list* param_list_create(char* name, struct type* type, struct param_list* next) {
-	struct param_list* p = malloc(sizeof(*p));
+	struct param_list* p = arena_alloc(&ast_arena, sizeof(*p));
 
 	// Add values to p
 	p->name = name;
 	p->type = type;
+	p->symbol = 0;
 	p->next = next;
 
 	return p;
@@ -109,31 +111,16 @@ struct param_list* param_list_copy(struct param_list* p) {
 		return 0;
 	}
 
-	struct param_list* new_p = malloc(sizeof(*new_p));
+	struct param_list* new_p = arena_alloc(&ast_arena, sizeof(*new_p));
 
-	new_p->name = strdup(p->name);
-	new_p->type = type_copy(p->type);
+	new_p->name = p->name;
+	new_p->type = p->type;
 	new_p->symbol = symbol_copy(p->symbol);
 	new_p->next = param_list_copy(p->next);
 
 	return new_p;
 }
 
-void param_list_delete(struct param_list* p) {
-
-	if (!p) {
-		return;
-	}
-
-	free(p->name);
-	type_delete(p->type);
-	symbol_delete(p->symbol);
-	param_list_delete(p->next);
-
-	free(p);
-
-}
-
 int param_list_check_types(struct param_list* p, struct expr* e) {
 
 	if (!p && !e) {
@@ -19,7 +19,6 @@ int param_list_count_params(struct param_list* p);
 int param_list_equals(struct param_list* a, struct param_list* b);
 void param_list_print(struct param_list* p);
 struct param_list* param_list_copy(struct param_list* p);
-void param_list_delete(struct param_list* p);
 int param_list_check_types(struct param_list* p, struct expr* e);
 void param_list_save_parameters_codegen(struct param_list* p, FILE* fp);
 void param_list_save_parameters_codegen_helper(struct param_list* p, FILE* fp, int param_num);
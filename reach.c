@@ -0,0 +1,128 @@
+// reach.c
+// Implementation of functions in reach.h
+// Only main is called from outside the program. A file without main is a
+// library whose functions may all be called from elsewhere, so every defined
+// function is a root.
+
+#include "reach.h"
+#include "decl.h"
+#include "stmt.h"
+#include "expr.h"
+#include "type.h"
+#include "symbol.h"
+#include "hash_table.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Remove the declarations that are not reachable from the roots of program
+// Returns the new head of the declaration list
+struct decl* reach_prune(struct decl* program) {
+
+	struct hash_table* reached = hash_table_create(0, 0);
+
+	if (decl_find_function(program, "main")) {
+		reach_mark(program, "main", reached);
+	}
+	else {
+		struct decl* d;
+		for(d = program; d; d = d->next) {
+			if (d->code && d->type->kind == TYPE_FUNCTION) {
+				reach_mark(program, d->name, reached);
+			}
+		}
+	}
+
+	// Unlink everything that was not reached, keeping prototypes of reached
+	// functions together with their definitions
+	struct decl* head = 0;
+	struct decl* tail = 0;
+	struct decl* d = program;
+	while(d) {
+		struct decl* next = d->next;
+		if (hash_table_lookup(reached, d->name)) {
+			d->next = 0;
+			if (tail) {
+				tail->next = d;
+			}
+			else {
+				head = d;
+			}
+			tail = d;
+		}
+		d = next;
+	}
+
+	hash_table_delete(reached);
+
+	return head;
+}
+
+void reach_mark(struct decl* program, const char* name, struct hash_table* reached) {
+
+	if (hash_table_lookup(reached, name)) {
+		return;
+	}
+
+	hash_table_insert(reached, name, (void*) 1);
+
+	struct decl* d;
+	for(d = program; d; d = d->next) {
+		if (!strcmp(d->name, name)) {
+			reach_mark_expr(program, d->value, reached);
+			reach_mark_stmt(program, d->code, reached);
+		}
+	}
+
+}
+
+void reach_mark_stmt(struct decl* program, struct stmt* s, struct hash_table* reached) {
+
+	if (!s) {
+		return;
+	}
+
+	switch(s->kind) {
+		case STMT_DECL:
+			reach_mark_expr(program, s->decl->value, reached);
+			break;
+		case STMT_IF_ELSE:
+			reach_mark_expr(program, s->expr, reached);
+			reach_mark_stmt(program, s->body, reached);
+			reach_mark_stmt(program, s->else_body, reached);
+			break;
+		case STMT_FOR:
+			reach_mark_expr(program, s->init_expr, reached);
+			reach_mark_expr(program, s->expr, reached);
+			reach_mark_expr(program, s->next_expr, reached);
+			reach_mark_stmt(program, s->body, reached);
+			break;
+		case STMT_BLOCK:
+			reach_mark_stmt(program, s->body, reached);
+			break;
+		case STMT_EXPR:
+		case STMT_PRINT:
+		case STMT_RETURN:
+			reach_mark_expr(program, s->expr, reached);
+			break;
+	}
+
+	reach_mark_stmt(program, s->next, reached);
+
+}
+
+void reach_mark_expr(struct decl* program, struct expr* e, struct hash_table* reached) {
+
+	if (!e) {
+		return;
+	}
+
+	// Function names only appear as the left side of calls
+	if (e->kind == EXPR_NAME && e->symbol && e->symbol->kind == SYMBOL_GLOBAL) {
+		reach_mark(program, e->name, reached);
+	}
+
+	reach_mark_expr(program, e->left, reached);
+	reach_mark_expr(program, e->right, reached);
+	reach_mark_expr(program, e->next, reached);
+
+}
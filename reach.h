@@ -0,0 +1,18 @@
+// reach.h
+// Header file for the reachability analysis, which removes functions and
+// globals that nothing reachable from the program's roots refers to
+
+#ifndef REACH_H
+#define REACH_H
+
+#include "decl.h"
+#include "stmt.h"
+#include "expr.h"
+#include "hash_table.h"
+
+struct decl* reach_prune(struct decl* program);
+void reach_mark(struct decl* program, const char* name, struct hash_table* reached);
+void reach_mark_stmt(struct decl* program, struct stmt* s, struct hash_table* reached);
+void reach_mark_expr(struct decl* program, struct expr* e, struct hash_table* reached);
+
+#endif
@@ -0,0 +1,477 @@
+// sched.c
+// Implementation of functions in sched.h
+// The scheduler works on the assembly text after code generation. Labels,
+// directives, jumps, calls, pushes, pops and any instruction it does not know
+// end a region and stay where they are. Inside a region, every pair of
+// instructions that touch the same register, the flags, or possibly the same
+// memory is ordered by an edge carrying the producer's latency. Instructions
+// are then issued cycle by cycle, critical path first, as long as the
+// target's issue width and the ports of each unit allow.
+
+#include "sched.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+// Models of a few x86-64 cores, with ports ordered as in sched_unit_t
+struct sched_model sched_models[] = {
+	{"generic", 2, {2, 1, 1, 1, 1}, 1, 3, 40, 4, 5},
+	{"skylake", 4, {4, 1, 1, 2, 1}, 1, 3, 42, 5, 5},
+	{"znver2", 5, {4, 1, 1, 2, 1}, 1, 3, 45, 4, 7}
+};
+
+int sched_model_count = sizeof(sched_models) / sizeof(sched_models[0]);
+
+// Model to schedule for, or 0 to leave the instructions in order
+struct sched_model* sched_target = 0;
+
+const char* sched_register_names[16] = {"rax", "rbx", "rcx", "rdx", "rsi", "rdi", "rbp", "rsp", "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15"};
+const char* sched_byte_register_names[8] = {"al", "bl", "cl", "dl", "sil", "dil", "bpl", "spl"};
+
+struct sched_model* sched_find_model(const char* name) {
+
+	int i;
+	for(i = 0; i < sched_model_count; i++) {
+		if (!strcmp(sched_models[i].name, name)) {
+			return &sched_models[i];
+		}
+	}
+
+	return 0;
+}
+
+// Reorder the instructions of the assembly in text and write it to fp
+// text is modified in place
+void sched_schedule(char* text, FILE* fp) {
+
+	int capacity = 64;
+	int count = 0;
+	struct sched_insn* region = malloc(sizeof(struct sched_insn) * capacity);
+
+	char* line = text;
+	while(line && *line) {
+		char* end = strchr(line, '\n');
+		if (end) {
+			*end = 0;
+		}
+
+		if (count == capacity) {
+			capacity *= 2;
+			region = realloc(region, sizeof(struct sched_insn) * capacity);
+		}
+
+		if (sched_parse(&region[count], line)) {
+			count++;
+		}
+		else {
+			sched_region(region, count, fp);
+			count = 0;
+			fprintf(fp, "%s\n", line);
+		}
+
+		line = (end) ? end + 1 : 0;
+	}
+
+	sched_region(region, count, fp);
+	free(region);
+
+}
+
+// Describe the instruction on line in insn
+// Returns 0 when line is not an instruction that may be moved
+int sched_parse(struct sched_insn* insn, char* line) {
+
+	memset(insn, 0, sizeof(*insn));
+	insn->text = line;
+
+	while(isspace(*line)) {
+		line++;
+	}
+
+	if (!*line || *line == '.' || line[strlen(line) - 1] == ':') {
+		return 0;
+	}
+
+	char* copy = strdup(line);
+	char* operands = copy;
+	while(*operands && !isspace(*operands)) {
+		operands++;
+	}
+	if (*operands) {
+		*operands++ = 0;
+	}
+
+	const char* m = copy;
+	char* op[3];
+	int n = sched_split_operands(operands, op);
+
+	// Roles of the operands: bit 0 of read and write for the first operand,
+	// bit 1 for the second
+	int read = 0;
+	int write = 0;
+	int is_lea = 0;
+	sched_unit_t unit = SCHED_ALU;
+	int latency = sched_target->alu;
+
+	if (n == 2 && (!strcmp(m, "MOVQ") || !strcmp(m, "MOV") || !strcmp(m, "MOVB") || !strcmp(m, "MOVZBQ") || !strcmp(m, "LEAQ"))) {
+		read = 1;
+		write = 2;
+		is_lea = !strcmp(m, "LEAQ");
+	}
+	else if (n == 2 && (!strcmp(m, "ADDQ") || !strcmp(m, "SUBQ") || !strcmp(m, "ADDB") || !strcmp(m, "SUBB") || !strcmp(m, "ANDQ") || !strcmp(m, "ORQ") || !strcmp(m, "XORQ") || !strcmp(m, "SHLQ") || !strcmp(m, "AND") || !strcmp(m, "OR"))) {
+		read = 3;
+		write = 2;
+		insn->defs |= 1 << SCHED_FLAGS;
+	}
+	else if (n == 2 && !strcmp(m, "IMULQ")) {
+		read = 3;
+		write = 2;
+		insn->defs |= 1 << SCHED_FLAGS;
+		unit = SCHED_MUL;
+		latency = sched_target->imul;
+	}
+	else if (n == 2 && (!strcmp(m, "CMPQ") || !strcmp(m, "CMP") || !strcmp(m, "TESTQ"))) {
+		read = 3;
+		insn->defs |= 1 << SCHED_FLAGS;
+	}
+	else if (n == 2 && !strncmp(m, "CMOV", 4)) {
+		read = 3;
+		write = 2;
+		insn->uses |= 1 << SCHED_FLAGS;
+	}
+	else if (n == 1 && !strncmp(m, "SET", 3)) {
+		// Only the low byte is written, so the rest of the register is read
+		read = 1;
+		write = 1;
+		insn->uses |= 1 << SCHED_FLAGS;
+	}
+	else if (n == 1 && (!strcmp(m, "NEGQ") || !strcmp(m, "NOT"))) {
+		read = 1;
+		write = 1;
+		insn->defs |= 1 << SCHED_FLAGS;
+	}
+	else if (n == 1 && !strcmp(m, "IDIVQ")) {
+		read = 1;
+		insn->uses |= (1 << sched_register("rax")) | (1 << sched_register("rdx"));
+		insn->defs |= (1 << sched_register("rax")) | (1 << sched_register("rdx")) | (1 << SCHED_FLAGS);
+		unit = SCHED_DIV;
+		latency = sched_target->idiv;
+	}
+	else if (n == 0 && !strcmp(m, "CQO")) {
+		insn->uses |= 1 << sched_register("rax");
+		insn->defs |= 1 << sched_register("rdx");
+	}
+	else {
+		free(copy);
+		return 0;
+	}
+
+	int i;
+	for(i = 0; i < n; i++) {
+		int bit = 1 << i;
+		if (!(read & bit) && !(write & bit)) {
+			continue;
+		}
+
+		if (sched_is_memory(op[i])) {
+			// Address registers are only read
+			insn->uses |= sched_registers(op[i]);
+			if (is_lea) {
+				continue;
+			}
+			insn->memory = sched_memory_key(op[i]);
+			if (read & bit) {
+				insn->loads = 1;
+			}
+			if (write & bit) {
+				insn->stores = 1;
+			}
+		}
+		else {
+			if (read & bit) {
+				insn->uses |= sched_registers(op[i]);
+			}
+			if (write & bit) {
+				insn->defs |= sched_registers(op[i]);
+			}
+		}
+	}
+
+	// Plain moves to and from memory only need the load and store ports
+	int is_move = !strcmp(m, "MOVQ") || !strcmp(m, "MOV") || !strcmp(m, "MOVB") || !strcmp(m, "MOVZBQ");
+	if (!is_move || (!insn->loads && !insn->stores)) {
+		insn->units[unit] = 1;
+	}
+	if (insn->loads) {
+		insn->units[SCHED_LOAD] = 1;
+		latency = (is_move) ? sched_target->load : latency + sched_target->load;
+	}
+	if (insn->stores) {
+		insn->units[SCHED_STORE] = 1;
+	}
+	insn->latency = latency;
+
+	free(copy);
+	return 1;
+}
+
+// Split operands at the commas outside parentheses
+// Returns the number of operands, at most 3
+int sched_split_operands(char* operands, char** out) {
+
+	int n = 0;
+	int depth = 0;
+
+	while(isspace(*operands)) {
+		operands++;
+	}
+
+	if (!*operands) {
+		return 0;
+	}
+
+	out[n++] = operands;
+	char* c;
+	for(c = operands; *c; c++) {
+		if (*c == '(') {
+			depth++;
+		}
+		else if (*c == ')') {
+			depth--;
+		}
+		else if (*c == ',' && !depth) {
+			*c = 0;
+			if (n == 3) {
+				return 4;
+			}
+			out[n] = c + 1;
+			while(isspace(*out[n])) {
+				out[n]++;
+			}
+			n++;
+		}
+	}
+
+	return n;
+}
+
+// Registers named in operand as a bit set
+unsigned sched_registers(const char* operand) {
+
+	unsigned set = 0;
+	const char* c = operand;
+
+	while((c = strchr(c, '%'))) {
+		c++;
+		char name[8];
+		int length = 0;
+		while(isalnum(c[length]) && length < 7) {
+			name[length] = c[length];
+			length++;
+		}
+		name[length] = 0;
+
+		int r = sched_register(name);
+		if (r >= 0) {
+			set |= 1 << r;
+		}
+		c += length;
+	}
+
+	return set;
+}
+
+// Number of the 64 bit register holding the register called name, or -1
+int sched_register(const char* name) {
+
+	int i;
+	for(i = 0; i < 16; i++) {
+		if (!strcmp(sched_register_names[i], name)) {
+			return i;
+		}
+	}
+
+	for(i = 0; i < 8; i++) {
+		if (!strcmp(sched_byte_register_names[i], name)) {
+			return i;
+		}
+	}
+
+	// Byte registers r8b to r15b
+	int length = strlen(name);
+	if (length > 2 && name[0] == 'r' && name[length - 1] == 'b') {
+		char wide[8];
+		strncpy(wide, name, length - 1);
+		wide[length - 1] = 0;
+		return sched_register(wide);
+	}
+
+	return -1;
+}
+
+int sched_is_memory(const char* operand) {
+
+	return strchr(operand, '(') != 0;
+}
+
+// Name shared by every operand that may reach the same memory as operand, or
+// 0 when the address is only known at run time
+// Frame slots are told apart by offset, globals by symbol
+char* sched_memory_key(const char* operand) {
+
+	if (strstr(operand, "(%rbp)") && !strchr(operand, ',')) {
+		return strdup(operand);
+	}
+
+	const char* rip = strstr(operand, "(%rip)");
+	if (rip) {
+		int length = strcspn(operand, "+-(");
+		char* key = malloc(sizeof(char) * (length + 1));
+		strncpy(key, operand, length);
+		key[length] = 0;
+		return key;
+	}
+
+	return 0;
+}
+
+// Write the count instructions of one region to fp in scheduled order
+void sched_region(struct sched_insn* insns, int count, FILE* fp) {
+
+	int i;
+	int j;
+
+	for(j = 0; j < count; j++) {
+		for(i = 0; i < j; i++) {
+			int latency = sched_edge_latency(&insns[i], &insns[j]);
+			if (latency >= 0) {
+				sched_add_edge(&insns[i], j, latency);
+				insns[j].waiting++;
+			}
+		}
+	}
+
+	// Priority is the length of the longest path to the end of the region
+	for(i = count - 1; i >= 0; i--) {
+		insns[i].priority = insns[i].latency;
+		for(j = 0; j < insns[i].num_succs; j++) {
+			int path = insns[i].succ_latencies[j] + insns[insns[i].succs[j]].priority;
+			if (path > insns[i].priority) {
+				insns[i].priority = path;
+			}
+		}
+	}
+
+	int done = 0;
+	int cycle = 0;
+	while(done < count) {
+		int used[SCHED_UNITS] = {0};
+		int issued = 0;
+
+		while(issued < sched_target->width) {
+			int best = -1;
+			for(i = 0; i < count; i++) {
+				struct sched_insn* insn = &insns[i];
+				if (insn->scheduled || insn->waiting || insn->earliest > cycle) {
+					continue;
+				}
+
+				int u;
+				int fits = 1;
+				for(u = 0; u < SCHED_UNITS; u++) {
+					if (insn->units[u] && used[u] >= sched_target->ports[u]) {
+						fits = 0;
+					}
+				}
+
+				if (fits && (best < 0 || insn->priority > insns[best].priority)) {
+					best = i;
+				}
+			}
+
+			if (best < 0) {
+				break;
+			}
+
+			struct sched_insn* insn = &insns[best];
+			fprintf(fp, "%s\n", insn->text);
+			insn->scheduled = 1;
+			done++;
+			issued++;
+
+			int u;
+			for(u = 0; u < SCHED_UNITS; u++) {
+				used[u] += insn->units[u];
+			}
+
+			for(j = 0; j < insn->num_succs; j++) {
+				struct sched_insn* succ = &insns[insn->succs[j]];
+				succ->waiting--;
+				if (cycle + insn->succ_latencies[j] > succ->earliest) {
+					succ->earliest = cycle + insn->succ_latencies[j];
+				}
+			}
+		}
+
+		cycle++;
+	}
+
+	for(i = 0; i < count; i++) {
+		sched_insn_delete(&insns[i]);
+	}
+
+}
+
+void sched_add_edge(struct sched_insn* from, int to, int latency) {
+
+	from->succs = realloc(from->succs, sizeof(int) * (from->num_succs + 1));
+	from->succ_latencies = realloc(from->succ_latencies, sizeof(int) * (from->num_succs + 1));
+	from->succs[from->num_succs] = to;
+	from->succ_latencies[from->num_succs] = latency;
+	from->num_succs++;
+
+}
+
+// Determine whether a and b may access the same memory with one of them
+// storing to it
+int sched_conflicts(struct sched_insn* a, struct sched_insn* b) {
+
+	if (!(a->loads || a->stores) || !(b->loads || b->stores) || !(a->stores || b->stores)) {
+		return 0;
+	}
+
+	return !a->memory || !b->memory || !strcmp(a->memory, b->memory);
+}
+
+// Cycles between issuing from and issuing to, where from comes first in the
+// original order, or -1 if the two may be reordered freely
+int sched_edge_latency(struct sched_insn* from, struct sched_insn* to) {
+
+	int latency = -1;
+
+	if ((from->uses & to->defs) || (from->defs & to->defs)) {
+		latency = 0;
+	}
+
+	if (from->defs & to->uses) {
+		latency = from->latency;
+	}
+
+	if (sched_conflicts(from, to)) {
+		int memory = (from->stores && to->loads) ? sched_target->store_forward : 0;
+		if (memory > latency) {
+			latency = memory;
+		}
+	}
+
+	return latency;
+}
+
+void sched_insn_delete(struct sched_insn* insn) {
+
+	free(insn->memory);
+	free(insn->succs);
+	free(insn->succ_latencies);
+
+}
@@ -0,0 +1,70 @@
+// sched.h
+// Header file for the instruction scheduler, which reorders the instructions
+// of each straight-line region of the generated assembly so that independent
+// work fills the latency of multiplies, divides and loads
+
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <stdio.h>
+
+// Execution units an instruction competes for
+typedef enum {
+	SCHED_ALU,
+	SCHED_MUL,
+	SCHED_DIV,
+	SCHED_LOAD,
+	SCHED_STORE,
+	SCHED_UNITS
+} sched_unit_t;
+
+// Latencies in cycles and the number of ports of each unit on one core
+struct sched_model {
+	const char* name;
+	int width;
+	int ports[SCHED_UNITS];
+	int alu;
+	int imul;
+	int idiv;
+	int load;
+	int store_forward;
+};
+
+// Flags are tracked as one more register after the 16 general purpose ones
+#define SCHED_FLAGS 16
+
+struct sched_insn {
+	char* text;
+	unsigned uses;
+	unsigned defs;
+	int loads;
+	int stores;
+	char* memory;
+	int units[SCHED_UNITS];
+	int latency;
+	int priority;
+	int earliest;
+	int waiting;
+	int scheduled;
+	int* succs;
+	int* succ_latencies;
+	int num_succs;
+};
+
+extern struct sched_model* sched_target;
+
+struct sched_model* sched_find_model(const char* name);
+void sched_schedule(char* text, FILE* fp);
+int sched_parse(struct sched_insn* insn, char* line);
+int sched_split_operands(char* operands, char** out);
+unsigned sched_registers(const char* operand);
+int sched_register(const char* name);
+int sched_is_memory(const char* operand);
+char* sched_memory_key(const char* operand);
+void sched_region(struct sched_insn* insns, int count, FILE* fp);
+void sched_add_edge(struct sched_insn* from, int to, int latency);
+int sched_conflicts(struct sched_insn* a, struct sched_insn* b);
+int sched_edge_latency(struct sched_insn* from, struct sched_insn* to);
+void sched_insn_delete(struct sched_insn* insn);
+
+#endif
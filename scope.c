@@ -1,61 +1,138 @@
 #include "scope.h"
-#include "hash_table.h"
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 
-struct scope* head = NULL;
+struct scope_table scope_table = {0, 0, 0, 0, 0, 0, 0, 0, 0};
 
-struct scope* scope_create() {
-	struct scope* s = malloc(sizeof(*s));
+void scope_enter() {
+	struct scope_table* t = &scope_table;
+	t->marks = scope_reserve(t->marks, &t->marks_capacity, t->level + 1, sizeof(*t->marks));
+	t->marks[t->level++] = t->log_count;
+}
 
-	s->variables = hash_table_create(0, 0);
-	s->level = scope_level() + 1;
-	s->next = 0;
+// Pops the bindings made since the matching scope_enter
+void scope_exit() {
+	struct scope_table* t = &scope_table;
+	if (!t->level) {
+		return;
+	}
 
-	return s;
+	int mark = t->marks[--t->level];
+	while(t->log_count > mark) {
+		struct scope_binding* b = &t->log[--t->log_count];
+		scope_find(b->name)->top = b->below;
+	}
 }
 
-void scope_enter() {
-	struct scope* s = scope_create();
-	s->next = head;
-	head = s;
+int scope_level() {
+	return scope_table.level;
 }
 
-void scope_exit() {
-	if (head) {
-		struct scope* s = head;
-		head = head->next;
-		hash_table_delete(s->variables);
+// Slot of name in a table of the given capacity, from its address
+unsigned scope_hash(const char* name, int capacity) {
+	uintptr_t a = (uintptr_t) name;
+	return (unsigned) ((a >> 3) ^ (a >> 13)) & (capacity - 1);
+}
+
+// Entry of name in the table, added with no bindings if it is new
+struct scope_name* scope_find(const char* name) {
+	struct scope_table* t = &scope_table;
+	if (2 * (t->count + 1) > t->capacity) {
+		scope_grow();
+	}
+
+	unsigned slot = scope_hash(name, t->capacity);
+	while(t->names[slot].name) {
+		if (t->names[slot].name == name) {
+			return &t->names[slot];
+		}
+		slot = (slot + 1) & (t->capacity - 1);
 	}
+
+	t->names[slot].name = name;
+	t->names[slot].top = -1;
+	t->count++;
+
+	return &t->names[slot];
 }
 
-int scope_level() {
-	if (!head) {
-		return 0;
+void scope_grow() {
+	struct scope_table* t = &scope_table;
+	int capacity = (t->capacity) ? 2 * t->capacity : 1024;
+	struct scope_name* names = calloc(capacity, sizeof(*names));
+	if (!names) {
+		printf("Error: Out of memory. Exiting...\n");
+		exit(1);
 	}
-	return head->level;
+
+	int i;
+	for(i = 0; i < t->capacity; i++) {
+		if (t->names[i].name) {
+			unsigned slot = scope_hash(t->names[i].name, capacity);
+			while(names[slot].name) {
+				slot = (slot + 1) & (capacity - 1);
+			}
+			names[slot] = t->names[i];
+		}
+	}
+
+	free(t->names);
+	t->names = names;
+	t->capacity = capacity;
+}
+
+// Returns items grown to hold at least needed elements of size bytes
+void* scope_reserve(void* items, int* capacity, int needed, int size) {
+	if (needed <= *capacity) {
+		return items;
+	}
+
+	*capacity = (*capacity) ? 2 * *capacity : 64;
+	while(*capacity < needed) {
+		*capacity *= 2;
+	}
+
+	items = realloc(items, (size_t) *capacity * size);
+	if (!items) {
+		printf("Error: Out of memory. Exiting...\n");
+		exit(1);
+	}
+
+	return items;
 }
 
+// The first binding of a name in a scope is kept
 void scope_bind(const char* name, struct symbol* symbol) {
-	hash_table_insert(head->variables, name, symbol);
+	struct scope_table* t = &scope_table;
+	struct scope_name* n = scope_find(name);
+	if (n->top >= 0 && t->log[n->top].level == t->level) {
+		return;
+	}
+
+	t->log = scope_reserve(t->log, &t->log_capacity, t->log_count + 1, sizeof(*t->log));
+	struct scope_binding* b = &t->log[t->log_count];
+	b->name = name;
+	b->symbol = symbol;
+	b->level = t->level;
+	b->below = n->top;
+	n->top = t->log_count++;
 }
 
 struct symbol* scope_lookup(const char* name) {
-	struct scope* curr = head;
-	while(curr) {
-		struct symbol* s = (struct symbol*) hash_table_lookup(curr->variables, name);
-		if (s) {
-			return s;
-		}
-		curr = curr->next;
+	struct scope_name* n = scope_find(name);
+	if (n->top < 0) {
+		return 0;
 	}
 
-	return 0;
+	return scope_table.log[n->top].symbol;
 }
 
 struct symbol* scope_lookup_current(const char* name) {
-	if (!head) {
+	struct scope_name* n = scope_find(name);
+	if (n->top < 0 || scope_table.log[n->top].level != scope_table.level) {
 		return 0;
 	}
 
-	return (struct symbol*) hash_table_lookup(head->variables, name);
+	return scope_table.log[n->top].symbol;
 }
@@ -1,22 +1,48 @@
 #ifndef SCOPE_H
 #define SCOPE_H
 
-#include "hash_table.h"
 #include "symbol.h"
 
-struct scope {
-	struct hash_table* variables;
+// One binding of a name, held in the undo log of the scope that made it
+struct scope_binding {
+	const char* name;
+	struct symbol* symbol;
 	int level;
-	struct scope* next;
-	
+	// Binding of the same name that this one hides, or -1
+	int below;
 };
 
-struct scope* scope_create();
+// Innermost binding of a name, found by the address of the pooled name
+struct scope_name {
+	const char* name;
+	int top;
+};
+
+// Every name maps to the stack of its bindings, threaded through the undo
+// log, and each open scope remembers where its part of the log starts
+struct scope_table {
+	struct scope_name* names;
+	int capacity;
+	int count;
+	struct scope_binding* log;
+	int log_count;
+	int log_capacity;
+	int* marks;
+	int level;
+	int marks_capacity;
+};
+
+extern struct scope_table scope_table;
+
 void scope_enter();
 void scope_exit();
 int scope_level();
 void scope_bind(const char* name, struct symbol* symbol);
 struct symbol* scope_lookup(const char* name);
 struct symbol* scope_lookup_current(const char* name);
+struct scope_name* scope_find(const char* name);
+unsigned scope_hash(const char* name, int capacity);
+void scope_grow();
+void* scope_reserve(void* items, int* capacity, int needed, int size);
 
 #endif
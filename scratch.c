@@ -6,6 +6,7 @@
 #include "scratch.h"
 
 char* scratch_names[7] = {"%rbx", "%r10", "%r11", "%r12", "%r13", "%r14", "%r15"};
+char* scratch_byte_names[7] = {"%bl", "%r10b", "%r11b", "%r12b", "%r13b", "%r14b", "%r15b"};
 int scratch_inuse[7] = {0, 0, 0, 0, 0, 0, 0};
 int scratch_length = 7;
 
@@ -44,3 +45,28 @@ const char* scratch_name(int r) {
 	return scratch_names[r];
 
 }
+
+// Name of the low byte of register r, for storing packed array elements
+const char* scratch_byte_name(int r) {
+	if(r < 0 || r >= scratch_length) {
+		printf("Attempted to retrieve name for register %d, which doesn't exist\n", r);
+		exit(1);
+	}
+
+	return scratch_byte_names[r];
+
+}
+
+int scratch_count_free() {
+
+	int count = 0;
+	int i;
+	for(i = 0; i < scratch_length; i++) {
+		if(scratch_inuse[i] == 0) {
+			count++;
+		}
+	}
+
+	return count;
+
+}
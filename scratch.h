@@ -7,5 +7,7 @@
 int scratch_alloc();
 void scratch_free(int r);
 const char* scratch_name(int r);
+const char* scratch_byte_name(int r);
+int scratch_count_free();
 
 #endif
@@ -0,0 +1,753 @@
+// select.c
+// Implementation of functions in select.h
+// Selection runs in two passes over each expression tree, as in BURS code
+// generators. The labeling pass works bottom up and records, for every node
+// and nonterminal, the cheapest rule producing that nonterminal there, given
+// the cheapest covers of the children. The reduction pass then walks down
+// from the goal nonterminal of the root and emits the chosen tiles, children
+// first. Costs roughly count cycles, so one IMULQ loses to a LEAQ or SHLQ.
+
+#include "select.h"
+#include "expr.h"
+#include "type.h"
+#include "symbol.h"
+#include "scratch.h"
+#include "param_list.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+
+// Cost of a nonterminal that cannot be produced at a node
+#define SELECT_INFINITE (INT_MAX / 4)
+
+struct select_rule select_rules[] = {
+	// Leaves
+	{SELECT_IMM, EXPR_INTEGER_LITERAL, SELECT_NONE, SELECT_NONE, 0, 0, 0, 0, select_emit_imm},
+	{SELECT_IMM, EXPR_CHAR_LITERAL, SELECT_NONE, SELECT_NONE, 0, 0, 0, 0, select_emit_imm},
+	{SELECT_IMM, EXPR_TRUE, SELECT_NONE, SELECT_NONE, 0, 0, 0, 0, select_emit_imm},
+	{SELECT_IMM, EXPR_FALSE, SELECT_NONE, SELECT_NONE, 0, 0, 0, 0, select_emit_imm},
+	{SELECT_VAR, EXPR_NAME, SELECT_NONE, SELECT_NONE, 0, 0, 0, select_is_var, select_emit_var},
+	{SELECT_GLOBAL, EXPR_NAME, SELECT_NONE, SELECT_NONE, 0, 0, 0, select_is_global_array, select_emit_global},
+	{SELECT_REG, EXPR_NAME, SELECT_NONE, SELECT_NONE, 1, 0, "LEAQ", select_is_global_array, select_emit_address},
+	{SELECT_REG, EXPR_STRING_LITERAL, SELECT_NONE, SELECT_NONE, 1, 0, "LEAQ", 0, select_emit_address},
+
+	// Chain rules
+	{SELECT_REG, SELECT_CHAIN, SELECT_IMM, SELECT_NONE, 1, 0, "MOVQ", 0, select_emit_load_imm},
+	{SELECT_MEM, SELECT_CHAIN, SELECT_VAR, SELECT_NONE, 0, 0, 0, 0, select_emit_pass},
+	{SELECT_REG, SELECT_CHAIN, SELECT_MEM, SELECT_NONE, 1, 0, "MOVQ", 0, select_emit_load},
+	{SELECT_REG, SELECT_CHAIN, SELECT_BMEM, SELECT_NONE, 1, 0, "MOVZBQ", 0, select_emit_load},
+	{SELECT_REG, SELECT_CHAIN, SELECT_SCALED, SELECT_NONE, 1, 0, "LEAQ", 0, select_emit_scaled_reg},
+	{SELECT_REG, SELECT_CHAIN, SELECT_CC, SELECT_NONE, 2, 0, "SET", 0, select_emit_set},
+	{SELECT_CC, SELECT_CHAIN, SELECT_REG, SELECT_NONE, 1, 0, "TESTQ", 0, select_emit_test},
+	{SELECT_STMT, SELECT_CHAIN, SELECT_REG, SELECT_NONE, 0, 0, 0, 0, select_emit_discard},
+
+	// Array elements
+	{SELECT_MEM, EXPR_SUBSCRIPT, SELECT_GLOBAL, SELECT_IMM, 0, 0, 0, select_is_word_constant_element, select_emit_element},
+	{SELECT_BMEM, EXPR_SUBSCRIPT, SELECT_GLOBAL, SELECT_IMM, 0, 0, 0, select_is_byte_constant_element, select_emit_element},
+	{SELECT_MEM, EXPR_SUBSCRIPT, SELECT_REG, SELECT_IMM, 0, 0, 0, select_is_word_constant_element, select_emit_element},
+	{SELECT_BMEM, EXPR_SUBSCRIPT, SELECT_REG, SELECT_IMM, 0, 0, 0, select_is_byte_constant_element, select_emit_element},
+	{SELECT_MEM, EXPR_SUBSCRIPT, SELECT_REG, SELECT_OFFSET, 0, 0, 0, select_is_word_offset_element, select_emit_element},
+	{SELECT_BMEM, EXPR_SUBSCRIPT, SELECT_REG, SELECT_OFFSET, 0, 0, 0, select_is_byte_offset_element, select_emit_element},
+	{SELECT_MEM, EXPR_SUBSCRIPT, SELECT_REG, SELECT_REG, 0, 0, 0, select_is_word_element, select_emit_element},
+	{SELECT_BMEM, EXPR_SUBSCRIPT, SELECT_REG, SELECT_REG, 0, 0, 0, select_is_byte_element, select_emit_element},
+	{SELECT_OFFSET, EXPR_PLUS, SELECT_REG, SELECT_IMM, 0, 0, 0, 0, select_emit_offset},
+	{SELECT_OFFSET, EXPR_PLUS, SELECT_IMM, SELECT_REG, 0, 0, 0, 0, select_emit_offset},
+	{SELECT_OFFSET, EXPR_MINUS, SELECT_REG, SELECT_IMM, 0, 0, 0, 0, select_emit_offset},
+
+	// Arithmetic
+	{SELECT_REG, EXPR_PLUS, SELECT_REG, SELECT_REG, 1, 0, "ADDQ", 0, select_emit_binary},
+	{SELECT_REG, EXPR_PLUS, SELECT_REG, SELECT_IMM, 1, 0, "ADDQ", 0, select_emit_binary},
+	{SELECT_REG, EXPR_PLUS, SELECT_REG, SELECT_MEM, 1, 0, "ADDQ", 0, select_emit_binary},
+	{SELECT_REG, EXPR_PLUS, SELECT_IMM, SELECT_REG, 1, 0, "ADDQ", 0, select_emit_binary_swapped},
+	{SELECT_REG, EXPR_PLUS, SELECT_REG, SELECT_SCALED, 1, 0, "LEAQ", 0, select_emit_scaled_add},
+	{SELECT_REG, EXPR_PLUS, SELECT_SCALED, SELECT_REG, 1, 0, "LEAQ", 0, select_emit_scaled_add},
+	{SELECT_REG, EXPR_MINUS, SELECT_REG, SELECT_REG, 1, 0, "SUBQ", 0, select_emit_binary},
+	{SELECT_REG, EXPR_MINUS, SELECT_REG, SELECT_IMM, 1, 0, "SUBQ", 0, select_emit_binary},
+	{SELECT_REG, EXPR_MINUS, SELECT_REG, SELECT_MEM, 1, 0, "SUBQ", 0, select_emit_binary},
+	{SELECT_REG, EXPR_MULT, SELECT_REG, SELECT_REG, 3, 0, "IMULQ", 0, select_emit_binary},
+	{SELECT_REG, EXPR_MULT, SELECT_REG, SELECT_IMM, 3, 0, "IMULQ", 0, select_emit_binary},
+	{SELECT_REG, EXPR_MULT, SELECT_REG, SELECT_MEM, 3, 0, "IMULQ", 0, select_emit_binary},
+	{SELECT_REG, EXPR_MULT, SELECT_IMM, SELECT_REG, 3, 0, "IMULQ", 0, select_emit_binary_swapped},
+	{SELECT_REG, EXPR_MULT, SELECT_REG, SELECT_IMM, 1, 0, "SHLQ", select_is_power_of_two, select_emit_shift},
+	{SELECT_SCALED, EXPR_MULT, SELECT_REG, SELECT_IMM, 0, 0, 0, select_is_scale, select_emit_scaled},
+	{SELECT_REG, EXPR_DIVIDE, SELECT_REG, SELECT_REG, 40, 0, "%rax", 0, select_emit_divide},
+	{SELECT_REG, EXPR_DIVIDE, SELECT_REG, SELECT_MEM, 40, 0, "%rax", 0, select_emit_divide},
+	{SELECT_REG, EXPR_MODULUS, SELECT_REG, SELECT_REG, 40, 0, "%rdx", 0, select_emit_divide},
+	{SELECT_REG, EXPR_MODULUS, SELECT_REG, SELECT_MEM, 40, 0, "%rdx", 0, select_emit_divide},
+	{SELECT_REG, EXPR_UNARY_MINUS, SELECT_NONE, SELECT_REG, 1, 0, "NEGQ", 0, select_emit_unary},
+	{SELECT_REG, EXPR_XOR, SELECT_REG, SELECT_REG, 20, 0, "integer_power", 0, select_emit_runtime_call},
+
+	// Booleans, which are always 0 or 1
+	{SELECT_REG, EXPR_AND, SELECT_REG, SELECT_REG, 1, 0, "ANDQ", 0, select_emit_binary},
+	{SELECT_REG, EXPR_OR, SELECT_REG, SELECT_REG, 1, 0, "ORQ", 0, select_emit_binary},
+	{SELECT_REG, EXPR_NOT, SELECT_NONE, SELECT_REG, 1, 0, "XORQ $1,", 0, select_emit_unary},
+	{SELECT_CC, EXPR_NOT, SELECT_NONE, SELECT_CC, 0, 0, 0, 0, select_emit_not_condition},
+
+	// Comparisons
+	{SELECT_CC, EXPR_LT, SELECT_REG, SELECT_REG, 1, 0, "CMPQ", 0, select_emit_compare},
+	{SELECT_CC, EXPR_LT, SELECT_REG, SELECT_IMM, 1, 0, "CMPQ", 0, select_emit_compare},
+	{SELECT_CC, EXPR_LT, SELECT_REG, SELECT_MEM, 1, 0, "CMPQ", 0, select_emit_compare},
+	{SELECT_CC, EXPR_LT, SELECT_MEM, SELECT_IMM, 1, 0, "CMPQ", 0, select_emit_compare},
+	{SELECT_CC, EXPR_LE, SELECT_REG, SELECT_REG, 1, 0, "CMPQ", 0, select_emit_compare},
+	{SELECT_CC, EXPR_LE, SELECT_REG, SELECT_IMM, 1, 0, "CMPQ", 0, select_emit_compare},
+	{SELECT_CC, EXPR_LE, SELECT_REG, SELECT_MEM, 1, 0, "CMPQ", 0, select_emit_compare},
+	{SELECT_CC, EXPR_LE, SELECT_MEM, SELECT_IMM, 1, 0, "CMPQ", 0, select_emit_compare},
+	{SELECT_CC, EXPR_GT, SELECT_REG, SELECT_REG, 1, 0, "CMPQ", 0, select_emit_compare},
+	{SELECT_CC, EXPR_GT, SELECT_REG, SELECT_IMM, 1, 0, "CMPQ", 0, select_emit_compare},
+	{SELECT_CC, EXPR_GT, SELECT_REG, SELECT_MEM, 1, 0, "CMPQ", 0, select_emit_compare},
+	{SELECT_CC, EXPR_GT, SELECT_MEM, SELECT_IMM, 1, 0, "CMPQ", 0, select_emit_compare},
+	{SELECT_CC, EXPR_GE, SELECT_REG, SELECT_REG, 1, 0, "CMPQ", 0, select_emit_compare},
+	{SELECT_CC, EXPR_GE, SELECT_REG, SELECT_IMM, 1, 0, "CMPQ", 0, select_emit_compare},
+	{SELECT_CC, EXPR_GE, SELECT_REG, SELECT_MEM, 1, 0, "CMPQ", 0, select_emit_compare},
+	{SELECT_CC, EXPR_GE, SELECT_MEM, SELECT_IMM, 1, 0, "CMPQ", 0, select_emit_compare},
+	{SELECT_CC, EXPR_EQUAL, SELECT_REG, SELECT_REG, 1, 0, "CMPQ", select_is_value_comparison, select_emit_compare},
+	{SELECT_CC, EXPR_EQUAL, SELECT_REG, SELECT_IMM, 1, 0, "CMPQ", select_is_value_comparison, select_emit_compare},
+	{SELECT_CC, EXPR_EQUAL, SELECT_REG, SELECT_MEM, 1, 0, "CMPQ", select_is_value_comparison, select_emit_compare},
+	{SELECT_CC, EXPR_EQUAL, SELECT_MEM, SELECT_IMM, 1, 0, "CMPQ", select_is_value_comparison, select_emit_compare},
+	{SELECT_CC, EXPR_NE, SELECT_REG, SELECT_REG, 1, 0, "CMPQ", select_is_value_comparison, select_emit_compare},
+	{SELECT_CC, EXPR_NE, SELECT_REG, SELECT_IMM, 1, 0, "CMPQ", select_is_value_comparison, select_emit_compare},
+	{SELECT_CC, EXPR_NE, SELECT_REG, SELECT_MEM, 1, 0, "CMPQ", select_is_value_comparison, select_emit_compare},
+	{SELECT_CC, EXPR_NE, SELECT_MEM, SELECT_IMM, 1, 0, "CMPQ", select_is_value_comparison, select_emit_compare},
+	{SELECT_REG, EXPR_EQUAL, SELECT_REG, SELECT_REG, 20, 0, "string_equals", select_is_string_comparison, select_emit_runtime_call},
+	{SELECT_REG, EXPR_NE, SELECT_REG, SELECT_REG, 20, 0, "string_equals", select_is_string_comparison, select_emit_runtime_call},
+
+	// Assignments
+	{SELECT_REG, EXPR_ASSIGN, SELECT_MEM, SELECT_REG, 1, 1, "MOVQ", select_is_scalar_assignment, select_emit_store},
+	{SELECT_REG, EXPR_ASSIGN, SELECT_BMEM, SELECT_REG, 1, 1, "MOVB", 0, select_emit_store},
+	{SELECT_STMT, EXPR_ASSIGN, SELECT_MEM, SELECT_IMM, 1, 1, "MOVQ", select_is_scalar_assignment, select_emit_store_imm},
+	{SELECT_STMT, EXPR_ASSIGN, SELECT_BMEM, SELECT_IMM, 1, 1, "MOVB", select_is_byte_immediate_assignment, select_emit_store_imm},
+	{SELECT_STMT, EXPR_ASSIGN, SELECT_VAR, SELECT_VARPLUS, 1, 0, "ADDQ", select_is_update, select_emit_update},
+	{SELECT_VARPLUS, EXPR_PLUS, SELECT_VAR, SELECT_IMM, 0, 0, 0, 0, select_emit_offset},
+	{SELECT_VARPLUS, EXPR_MINUS, SELECT_VAR, SELECT_IMM, 0, 0, 0, 0, select_emit_offset},
+	{SELECT_REG, EXPR_ASSIGN, SELECT_REG, SELECT_REG, 10, 1, 0, select_is_array_assignment, select_emit_array_copy},
+	{SELECT_STMT, EXPR_INCREMENT, SELECT_VAR, SELECT_NONE, 1, 0, "ADDQ", 0, select_emit_step},
+	{SELECT_STMT, EXPR_DECREMENT, SELECT_VAR, SELECT_NONE, 1, 0, "SUBQ", 0, select_emit_step},
+	{SELECT_REG, EXPR_INCREMENT, SELECT_VAR, SELECT_NONE, 2, 0, "ADDQ", 0, select_emit_step_value},
+	{SELECT_REG, EXPR_DECREMENT, SELECT_VAR, SELECT_NONE, 2, 0, "SUBQ", 0, select_emit_step_value},
+	{SELECT_STMT, EXPR_INCREMENT, SELECT_MEM, SELECT_NONE, 1, 0, "ADDQ", 0, select_emit_step},
+	{SELECT_STMT, EXPR_DECREMENT, SELECT_MEM, SELECT_NONE, 1, 0, "SUBQ", 0, select_emit_step},
+	{SELECT_STMT, EXPR_INCREMENT, SELECT_BMEM, SELECT_NONE, 1, 0, "ADDB", 0, select_emit_step},
+	{SELECT_STMT, EXPR_DECREMENT, SELECT_BMEM, SELECT_NONE, 1, 0, "SUBB", 0, select_emit_step},
+	{SELECT_REG, EXPR_INCREMENT, SELECT_MEM, SELECT_NONE, 2, 0, "ADDQ", 0, select_emit_step_value},
+	{SELECT_REG, EXPR_DECREMENT, SELECT_MEM, SELECT_NONE, 2, 0, "SUBQ", 0, select_emit_step_value},
+	{SELECT_REG, EXPR_INCREMENT, SELECT_BMEM, SELECT_NONE, 2, 0, "ADDB", 0, select_emit_step_value},
+	{SELECT_REG, EXPR_DECREMENT, SELECT_BMEM, SELECT_NONE, 2, 0, "SUBB", 0, select_emit_step_value},
+
+	// Calls evaluate their own arguments
+	{SELECT_REG, EXPR_CALL, SELECT_NONE, SELECT_NONE, 20, 0, 0, 0, select_emit_call},
+	{SELECT_REG, EXPR_ARRAY_INITIALIZER, SELECT_NONE, SELECT_NONE, 0, 0, 0, 0, select_emit_initializer}
+};
+
+int select_rule_count = sizeof(select_rules) / sizeof(select_rules[0]);
+
+// Generate code leaving the value of e in the scratch register
+// e->register_number
+void select_codegen(struct expr* e, FILE* fp) {
+
+	if (!e) {
+		return;
+	}
+
+	struct select_value v;
+	select_goal_codegen(e, SELECT_REG, &v, fp);
+	free(v.operand);
+
+}
+
+// Generate code for e when its value is not needed
+void select_effect_codegen(struct expr* e, FILE* fp) {
+
+	if (!e) {
+		return;
+	}
+
+	struct select_value v;
+	select_goal_codegen(e, SELECT_STMT, &v, fp);
+	free(v.operand);
+
+}
+
+// Generate code jumping to false_label when the boolean e is false
+void select_branch_codegen(struct expr* e, const char* false_label, FILE* fp) {
+
+	struct select_value v;
+	select_goal_codegen(e, SELECT_CC, &v, fp);
+	fprintf(fp, "J%s %s\n", select_inverse_condition(v.cc), false_label);
+	free(v.operand);
+
+}
+
+// Cover e with the cheapest tiles producing goal and emit them
+void select_goal_codegen(struct expr* e, select_t goal, struct select_value* out, FILE* fp) {
+
+	struct select_state* st = select_label(e);
+	select_reduce(e, st, goal, out, fp);
+	select_state_delete(st);
+
+}
+
+// Find the cheapest rule for each nonterminal at e and its children
+struct select_state* select_label(struct expr* e) {
+
+	struct select_state* st = malloc(sizeof(*st));
+
+	int nt;
+	for(nt = 0; nt < SELECT_COUNT; nt++) {
+		st->cost[nt] = SELECT_INFINITE;
+		st->rule[nt] = 0;
+	}
+
+	st->kids[0] = (e->left && !select_is_opaque(e)) ? select_label(e->left) : 0;
+	st->kids[1] = (e->right && !select_is_opaque(e)) ? select_label(e->right) : 0;
+
+	int i;
+	for(i = 0; i < select_rule_count; i++) {
+		const struct select_rule* r = &select_rules[i];
+		if (r->kind != e->kind) {
+			continue;
+		}
+
+		int cost = r->cost;
+		if (r->left != SELECT_NONE) {
+			cost = (st->kids[0]) ? cost + st->kids[0]->cost[r->left] : SELECT_INFINITE;
+		}
+		if (r->right != SELECT_NONE) {
+			cost = (st->kids[1]) ? cost + st->kids[1]->cost[r->right] : SELECT_INFINITE;
+		}
+
+		if (cost < st->cost[r->result] && (!r->applies || r->applies(e))) {
+			st->cost[r->result] = cost;
+			st->rule[r->result] = r;
+		}
+	}
+
+	// Apply chain rules until no nonterminal gets cheaper
+	int changed = 1;
+	while(changed) {
+		changed = 0;
+		for(i = 0; i < select_rule_count; i++) {
+			const struct select_rule* r = &select_rules[i];
+			if (r->kind != SELECT_CHAIN || st->cost[r->left] >= SELECT_INFINITE) {
+				continue;
+			}
+
+			int cost = r->cost + st->cost[r->left];
+			if (cost < st->cost[r->result]) {
+				st->cost[r->result] = cost;
+				st->rule[r->result] = r;
+				changed = 1;
+			}
+		}
+	}
+
+	return st;
+}
+
+// Determine whether the children of e are generated by the tile covering e
+// itself rather than by tiles of their own
+int select_is_opaque(struct expr* e) {
+
+	return e->kind == EXPR_CALL || e->kind == EXPR_ARRAY_INITIALIZER;
+}
+
+// Emit the tiles reducing e to nonterminal nt and describe the result in out
+void select_reduce(struct expr* e, struct select_state* st, select_t nt, struct select_value* out, FILE* fp) {
+
+	const struct select_rule* r = st->rule[nt];
+	if (!r) {
+		printf("codegen error: no instruction pattern covers ");
+		expr_print(e, 0);
+		printf("\n");
+		exit(1);
+	}
+
+	struct select_value kids[2];
+	int i;
+	for(i = 0; i < 2; i++) {
+		kids[i].reg = -1;
+		kids[i].index = -1;
+		kids[i].imm = 0;
+		kids[i].operand = 0;
+		kids[i].cc = 0;
+	}
+
+	if (r->kind == SELECT_CHAIN) {
+		select_reduce(e, st, r->left, &kids[0], fp);
+	}
+	else if (r->right_first) {
+		if (r->right != SELECT_NONE) {
+			select_reduce(e->right, st->kids[1], r->right, &kids[1], fp);
+		}
+		if (r->left != SELECT_NONE) {
+			select_reduce(e->left, st->kids[0], r->left, &kids[0], fp);
+		}
+	}
+	else {
+		if (r->left != SELECT_NONE) {
+			select_reduce(e->left, st->kids[0], r->left, &kids[0], fp);
+		}
+		if (r->right != SELECT_NONE) {
+			select_reduce(e->right, st->kids[1], r->right, &kids[1], fp);
+		}
+	}
+
+	out->reg = -1;
+	out->index = -1;
+	out->imm = 0;
+	out->operand = 0;
+	out->cc = 0;
+
+	r->emit(r, e, kids, out, fp);
+
+	// Registers belong to the emitted code now, but operand text the rule did
+	// not pass on is still ours
+	free(kids[0].operand);
+	free(kids[1].operand);
+
+	// Registers and immediates can always be used as operands
+	if (nt == SELECT_REG) {
+		e->register_number = out->reg;
+		out->operand = strdup(scratch_name(out->reg));
+	}
+	else if (nt == SELECT_IMM) {
+		int bufsize = 24;
+		out->operand = malloc(sizeof(char) * bufsize);
+		snprintf(out->operand, bufsize, "$%ld", out->imm);
+	}
+
+}
+
+void select_state_delete(struct select_state* st) {
+
+	if (!st) {
+		return;
+	}
+
+	select_state_delete(st->kids[0]);
+	select_state_delete(st->kids[1]);
+	free(st);
+
+}
+
+// Free the registers held by v
+void select_release(struct select_value* v) {
+
+	if (v->reg >= 0) {
+		scratch_free(v->reg);
+		v->reg = -1;
+	}
+
+	if (v->index >= 0) {
+		scratch_free(v->index);
+		v->index = -1;
+	}
+
+}
+
+// Condition code suffix that holds exactly when cc does not
+const char* select_inverse_condition(const char* cc) {
+
+	if (!strcmp(cc, "L")) return "GE";
+	if (!strcmp(cc, "GE")) return "L";
+	if (!strcmp(cc, "G")) return "LE";
+	if (!strcmp(cc, "LE")) return "G";
+	if (!strcmp(cc, "E")) return "NE";
+	return "E";
+}
+
+// Condition code suffix of comparison kind
+const char* select_condition(int kind) {
+
+	switch(kind) {
+		case EXPR_LT:
+			return "L";
+		case EXPR_LE:
+			return "LE";
+		case EXPR_GT:
+			return "G";
+		case EXPR_GE:
+			return "GE";
+		case EXPR_EQUAL:
+			return "E";
+		default:
+			return "NE";
+	}
+
+}
+
+// A named scalar, or the pointer held by a local array's slot
+int select_is_var(struct expr* e) {
+
+	return e->symbol && e->symbol->type->kind != TYPE_FUNCTION && !select_is_global_array(e);
+}
+
+int select_is_global_array(struct expr* e) {
+
+	return e->symbol && e->symbol->kind == SYMBOL_GLOBAL && e->symbol->type->kind == TYPE_ARRAY;
+}
+
+int select_is_word_element(struct expr* e) {
+
+	return expr_subscript_element_size(e) == 8;
+}
+
+int select_is_byte_element(struct expr* e) {
+
+	return expr_subscript_element_size(e) == 1;
+}
+
+int select_is_word_constant_element(struct expr* e) {
+
+	return select_is_word_element(e) && select_displacement_fits(e, e->right->literal_value);
+}
+
+int select_is_byte_constant_element(struct expr* e) {
+
+	return select_is_byte_element(e) && select_displacement_fits(e, e->right->literal_value);
+}
+
+int select_is_word_offset_element(struct expr* e) {
+
+	struct expr* i = e->right;
+	struct expr* c = (i->left->kind == EXPR_INTEGER_LITERAL && i->kind == EXPR_PLUS) ? i->left : i->right;
+	return select_is_word_element(e) && select_displacement_fits(e, c->literal_value);
+}
+
+int select_is_byte_offset_element(struct expr* e) {
+
+	struct expr* i = e->right;
+	struct expr* c = (i->left->kind == EXPR_INTEGER_LITERAL && i->kind == EXPR_PLUS) ? i->left : i->right;
+	return select_is_byte_element(e) && select_displacement_fits(e, c->literal_value);
+}
+
+// Displacements are signed 32 bit values
+int select_displacement_fits(struct expr* e, long value) {
+
+	long displacement = value * expr_subscript_element_size(e);
+	return displacement <= INT_MAX && displacement >= -(long) INT_MAX;
+}
+
+int select_is_scale(struct expr* e) {
+
+	int v = e->right->literal_value;
+	return v == 2 || v == 4 || v == 8;
+}
+
+int select_is_power_of_two(struct expr* e) {
+
+	int v = e->right->literal_value;
+	return v > 1 && !(v & (v - 1));
+}
+
+int select_is_array_assignment(struct expr* e) {
+
+	return e->left->kind == EXPR_NAME && e->left->symbol->type->kind == TYPE_ARRAY;
+}
+
+int select_is_scalar_assignment(struct expr* e) {
+
+	return !select_is_array_assignment(e);
+}
+
+int select_is_byte_immediate_assignment(struct expr* e) {
+
+	int v = (e->right->kind == EXPR_TRUE) ? 1 : (e->right->kind == EXPR_FALSE) ? 0 : e->right->literal_value;
+	return v >= -128 && v <= 255;
+}
+
+// x = x + c or x = x - c
+int select_is_update(struct expr* e) {
+
+	return e->right->left->kind == EXPR_NAME && e->right->left->symbol == e->left->symbol;
+}
+
+int select_is_string_comparison(struct expr* e) {
+
+	return e->right->type->kind == TYPE_STRING;
+}
+
+int select_is_value_comparison(struct expr* e) {
+
+	return !select_is_string_comparison(e);
+}
+
+void select_emit_imm(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp) {
+
+	out->imm = (e->kind == EXPR_TRUE) ? 1 : (e->kind == EXPR_FALSE) ? 0 : e->literal_value;
+}
+
+void select_emit_load_imm(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp) {
+
+	out->reg = scratch_alloc();
+	fprintf(fp, "%s $%ld, %s\n", r->opcode, kids[0].imm, scratch_name(out->reg));
+}
+
+void select_emit_var(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp) {
+
+	out->operand = (char*) symbol_codegen(e->symbol);
+}
+
+// Hand the only operand on unchanged
+void select_emit_pass(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp) {
+
+	*out = kids[0];
+	kids[0].operand = 0;
+}
+
+// Load a memory operand into a register, reusing one of its address registers
+void select_emit_load(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp) {
+
+	if (kids[0].index >= 0) {
+		out->reg = kids[0].index;
+		if (kids[0].reg >= 0) {
+			scratch_free(kids[0].reg);
+		}
+	}
+	else if (kids[0].reg >= 0) {
+		out->reg = kids[0].reg;
+	}
+	else {
+		out->reg = scratch_alloc();
+	}
+
+	fprintf(fp, "%s %s, %s\n", r->opcode, kids[0].operand, scratch_name(out->reg));
+}
+
+// Global arrays and string literals evaluate to their address
+void select_emit_address(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp) {
+
+	out->reg = scratch_alloc();
+	const char* name = (e->kind == EXPR_STRING_LITERAL) ? e->name : e->symbol->name;
+	fprintf(fp, "%s %s(%%rip), %s\n", r->opcode, name, scratch_name(out->reg));
+}
+
+void select_emit_global(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp) {
+
+	out->operand = strdup(e->symbol->name);
+}
+
+// Build the memory operand of an array element from its base and index
+void select_emit_element(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp) {
+
+	int size = expr_subscript_element_size(e);
+	long displacement = (r->right == SELECT_IMM || r->right == SELECT_OFFSET) ? kids[1].imm * size : 0;
+
+	int bufsize = 64 + ((r->left == SELECT_GLOBAL) ? strlen(kids[0].operand) : 0);
+	out->operand = malloc(sizeof(char) * bufsize);
+	out->reg = kids[0].reg;
+	out->index = kids[1].reg;
+
+	if (r->left == SELECT_GLOBAL) {
+		snprintf(out->operand, bufsize, "%s%+ld(%%rip)", kids[0].operand, displacement);
+	}
+	else if (r->right == SELECT_IMM) {
+		snprintf(out->operand, bufsize, "%ld(%s)", displacement, scratch_name(out->reg));
+	}
+	else {
+		snprintf(out->operand, bufsize, "%ld(%s,%s,%d)", displacement, scratch_name(out->reg), scratch_name(out->index), size);
+	}
+
+}
+
+// Split a sum into the value of its non constant side and the constant
+void select_emit_offset(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp) {
+
+	int constant = (r->left == SELECT_IMM) ? 0 : 1;
+
+	*out = kids[1 - constant];
+	kids[1 - constant].operand = 0;
+	out->imm = (e->kind == EXPR_MINUS) ? -kids[constant].imm : kids[constant].imm;
+
+}
+
+void select_emit_scaled(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp) {
+
+	out->reg = kids[0].reg;
+	out->imm = kids[1].imm;
+}
+
+void select_emit_scaled_reg(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp) {
+
+	out->reg = kids[0].reg;
+	fprintf(fp, "%s 0(,%s,%ld), %s\n", r->opcode, scratch_name(out->reg), kids[0].imm, scratch_name(out->reg));
+}
+
+// Add a register and a scaled register in one LEAQ
+void select_emit_scaled_add(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp) {
+
+	struct select_value* scaled = (r->left == SELECT_SCALED) ? &kids[0] : &kids[1];
+	struct select_value* base = (r->left == SELECT_SCALED) ? &kids[1] : &kids[0];
+
+	fprintf(fp, "%s 0(%s,%s,%ld), %s\n", r->opcode, scratch_name(base->reg), scratch_name(scaled->reg), scaled->imm, scratch_name(scaled->reg));
+	out->reg = scaled->reg;
+	scratch_free(base->reg);
+
+}
+
+// Two operand instruction whose destination is the left operand's register
+void select_emit_binary(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp) {
+
+	fprintf(fp, "%s %s, %s\n", r->opcode, kids[1].operand, scratch_name(kids[0].reg));
+	out->reg = kids[0].reg;
+	select_release(&kids[1]);
+
+}
+
+// Commutative instruction with a constant left operand
+void select_emit_binary_swapped(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp) {
+
+	fprintf(fp, "%s %s, %s\n", r->opcode, kids[0].operand, scratch_name(kids[1].reg));
+	out->reg = kids[1].reg;
+
+}
+
+void select_emit_shift(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp) {
+
+	int shift = 0;
+	while((1L << shift) < kids[1].imm) {
+		shift++;
+	}
+
+	fprintf(fp, "%s $%d, %s\n", r->opcode, shift, scratch_name(kids[0].reg));
+	out->reg = kids[0].reg;
+
+}
+
+// One operand instruction on the right operand, the only child of unary nodes
+void select_emit_unary(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp) {
+
+	fprintf(fp, "%s %s\n", r->opcode, scratch_name(kids[1].reg));
+	out->reg = kids[1].reg;
+
+}
+
+// IDIVQ leaves the quotient in the register named by the opcode of the rule
+// and the remainder in %rdx
+void select_emit_divide(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp) {
+
+	fprintf(fp, "MOVQ %s, %%rax\n", scratch_name(kids[0].reg));
+	fprintf(fp, "CQO\n");
+	fprintf(fp, "IDIVQ %s\n", kids[1].operand);
+	fprintf(fp, "MOVQ %s, %s\n", r->opcode, scratch_name(kids[0].reg));
+	out->reg = kids[0].reg;
+	select_release(&kids[1]);
+
+}
+
+void select_emit_compare(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp) {
+
+	fprintf(fp, "%s %s, %s\n", r->opcode, kids[1].operand, kids[0].operand);
+	select_release(&kids[0]);
+	select_release(&kids[1]);
+	out->cc = select_condition(e->kind);
+
+}
+
+void select_emit_not_condition(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp) {
+
+	out->cc = select_inverse_condition(kids[1].cc);
+}
+
+void select_emit_test(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp) {
+
+	fprintf(fp, "%s %s, %s\n", r->opcode, scratch_name(kids[0].reg), scratch_name(kids[0].reg));
+	select_release(&kids[0]);
+	out->cc = "NE";
+
+}
+
+// Materialize the flag as 0 or 1 with SETcc
+void select_emit_set(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp) {
+
+	out->reg = scratch_alloc();
+	fprintf(fp, "%s%s %%al\n", r->opcode, kids[0].cc);
+	fprintf(fp, "MOVZBQ %%al, %s\n", scratch_name(out->reg));
+
+}
+
+// Store the value of the right operand, which is also the value of the
+// assignment
+void select_emit_store(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp) {
+
+	const char* value = (r->left == SELECT_BMEM) ? scratch_byte_name(kids[1].reg) : scratch_name(kids[1].reg);
+	fprintf(fp, "%s %s, %s\n", r->opcode, value, kids[0].operand);
+	select_release(&kids[0]);
+	out->reg = kids[1].reg;
+
+}
+
+void select_emit_store_imm(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp) {
+
+	fprintf(fp, "%s $%ld, %s\n", r->opcode, kids[1].imm, kids[0].operand);
+	select_release(&kids[0]);
+
+}
+
+// Add a constant to a variable in memory
+void select_emit_update(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp) {
+
+	fprintf(fp, "%s $%ld, %s\n", r->opcode, kids[1].imm, kids[0].operand);
+}
+
+// Step a variable or an array element in place
+void select_emit_step(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp) {
+
+	fprintf(fp, "%s $1, %s\n", r->opcode, kids[0].operand);
+	select_release(&kids[0]);
+}
+
+// Post-increment and post-decrement evaluate to the old value
+void select_emit_step_value(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp) {
+
+	out->reg = scratch_alloc();
+	fprintf(fp, "%s %s, %s\n", (r->left == SELECT_BMEM) ? "MOVZBQ" : "MOVQ", kids[0].operand, scratch_name(out->reg));
+	fprintf(fp, "%s $1, %s\n", r->opcode, kids[0].operand);
+	select_release(&kids[0]);
+
+}
+
+void select_emit_discard(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp) {
+
+	select_release(&kids[0]);
+}
+
+// Arrays are assigned by copying their elements
+void select_emit_array_copy(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp) {
+
+	fprintf(fp, "MOVQ %s, %%rdi\n", scratch_name(kids[0].reg));
+	fprintf(fp, "MOVQ %s, %%rsi\n", scratch_name(kids[1].reg));
+	expr_copy_elements_codegen(expr_array_assignment_size(e), fp);
+	select_release(&kids[0]);
+	out->reg = kids[1].reg;
+
+}
+
+// Operators implemented by a function of the runtime library
+void select_emit_runtime_call(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp) {
+
+	param_list_move_register_to_function_argument_register(kids[0].reg, 0, fp);
+	param_list_move_register_to_function_argument_register(kids[1].reg, 1, fp);
+	out->reg = expr_call_function_codegen(r->opcode, fp);
+	select_release(&kids[0]);
+	select_release(&kids[1]);
+
+	if (e->kind == EXPR_NE) {
+		fprintf(fp, "XORQ $1, %s\n", scratch_name(out->reg));
+	}
+
+}
+
+void select_emit_call(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp) {
+
+	param_list_expr_argument_list_codegen(e->right, fp);
+	out->reg = expr_call_function_codegen(e->left->name, fp);
+
+}
+
+void select_emit_initializer(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp) {
+
+	printf("codegen error: local arrays not supported\n");
+	exit(1);
+
+}
@@ -0,0 +1,130 @@
+// select.h
+// Header file for the instruction selector, which covers each expression tree
+// with the cheapest set of tiles from a table of costed x86 patterns
+
+#ifndef SELECT_H
+#define SELECT_H
+
+#include "expr.h"
+#include <stdio.h>
+
+// Nonterminals, the kinds of result a tile can leave for the tile above it
+typedef enum {
+	SELECT_NONE,
+	SELECT_REG,     // value in a scratch register
+	SELECT_IMM,     // constant usable as an immediate
+	SELECT_VAR,     // scalar variable in a frame slot or a global
+	SELECT_MEM,     // memory operand of a quadword
+	SELECT_BMEM,    // memory operand of a byte
+	SELECT_GLOBAL,  // global array addressed relative to %rip
+	SELECT_OFFSET,  // index register plus a constant
+	SELECT_SCALED,  // register times 2, 4 or 8
+	SELECT_VARPLUS, // variable plus or minus a constant
+	SELECT_CC,      // comparison result in the flags
+	SELECT_STMT,    // value not needed
+	SELECT_COUNT
+} select_t;
+
+// Marks a chain rule, which turns one nonterminal into another at the same node
+#define SELECT_CHAIN -1
+
+// The result of reducing a node to a nonterminal
+// reg and index are scratch registers owned by the value, or -1, and operand
+// is the text of the value as an instruction operand
+struct select_value {
+	int reg;
+	int index;
+	long imm;
+	char* operand;
+	const char* cc;
+};
+
+struct select_rule;
+
+typedef int (*select_applies_t) (struct expr* e);
+typedef void (*select_emit_t) (const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp);
+
+// result <- kind(left, right) at cost, or result <- left for chain rules
+// Operands are reduced left to right unless right_first is set
+struct select_rule {
+	select_t result;
+	int kind;
+	select_t left;
+	select_t right;
+	int cost;
+	int right_first;
+	const char* opcode;
+	select_applies_t applies;
+	select_emit_t emit;
+};
+
+// Cheapest rule found for each nonterminal at one node
+struct select_state {
+	int cost[SELECT_COUNT];
+	const struct select_rule* rule[SELECT_COUNT];
+	struct select_state* kids[2];
+};
+
+void select_codegen(struct expr* e, FILE* fp);
+void select_effect_codegen(struct expr* e, FILE* fp);
+void select_branch_codegen(struct expr* e, const char* false_label, FILE* fp);
+void select_goal_codegen(struct expr* e, select_t goal, struct select_value* out, FILE* fp);
+struct select_state* select_label(struct expr* e);
+int select_is_opaque(struct expr* e);
+void select_reduce(struct expr* e, struct select_state* st, select_t nt, struct select_value* out, FILE* fp);
+void select_state_delete(struct select_state* st);
+void select_release(struct select_value* v);
+const char* select_inverse_condition(const char* cc);
+const char* select_condition(int kind);
+
+int select_is_var(struct expr* e);
+int select_is_global_array(struct expr* e);
+int select_is_word_element(struct expr* e);
+int select_is_byte_element(struct expr* e);
+int select_is_word_constant_element(struct expr* e);
+int select_is_byte_constant_element(struct expr* e);
+int select_is_word_offset_element(struct expr* e);
+int select_is_byte_offset_element(struct expr* e);
+int select_is_scale(struct expr* e);
+int select_is_power_of_two(struct expr* e);
+int select_is_scalar_assignment(struct expr* e);
+int select_is_byte_immediate_assignment(struct expr* e);
+int select_is_array_assignment(struct expr* e);
+int select_is_update(struct expr* e);
+int select_is_string_comparison(struct expr* e);
+int select_is_value_comparison(struct expr* e);
+int select_displacement_fits(struct expr* e, long value);
+
+void select_emit_imm(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp);
+void select_emit_load_imm(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp);
+void select_emit_var(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp);
+void select_emit_pass(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp);
+void select_emit_load(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp);
+void select_emit_address(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp);
+void select_emit_global(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp);
+void select_emit_element(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp);
+void select_emit_offset(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp);
+void select_emit_scaled(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp);
+void select_emit_scaled_add(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp);
+void select_emit_scaled_reg(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp);
+void select_emit_binary(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp);
+void select_emit_binary_swapped(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp);
+void select_emit_shift(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp);
+void select_emit_unary(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp);
+void select_emit_divide(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp);
+void select_emit_compare(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp);
+void select_emit_not_condition(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp);
+void select_emit_test(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp);
+void select_emit_set(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp);
+void select_emit_store(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp);
+void select_emit_store_imm(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp);
+void select_emit_update(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp);
+void select_emit_step(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp);
+void select_emit_step_value(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp);
+void select_emit_discard(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp);
+void select_emit_array_copy(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp);
+void select_emit_runtime_call(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp);
+void select_emit_call(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp);
+void select_emit_initializer(const struct select_rule* r, struct expr* e, struct select_value* kids, struct select_value* out, FILE* fp);
+
+#endif
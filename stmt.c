@@ -5,12 +5,17 @@
 #include "scratch.h"
 #include "scope.h"
 #include "label.h"
+#include "select.h"
+#include "arena.h"
 #include <stdlib.h>
 #include <stdio.h>
 
+// Maximum number of expression nodes in each arm of an if-converted statement
+int stmt_if_conversion_max_cost = 6;
+
 // Function to construct a statement struct and return it
 struct stmt* stmt_create(stmt_t kind, struct decl* decl, struct expr* init_expr, struct expr* expr, struct expr* next_expr, struct stmt* body, struct stmt* else_body, struct stmt* next) {
-	struct stmt* s = malloc(sizeof(*s));
+	struct stmt* s = arena_alloc(&ast_arena, sizeof(*s));
 
 	// Add values to s
 	s->kind = kind;
@@ -25,6 +30,17 @@ struct stmt* stmt_create(stmt_t kind, struct decl* decl, struct expr* init_expr,
 	return s;
 }
 
+// Copy s and the statements that follow it
+// Declarations and names in the copy refer to the original symbols
+struct stmt* stmt_copy(struct stmt* s) {
+
+	if (!s) {
+		return 0;
+	}
+
+	return stmt_create(s->kind, decl_copy(s->decl), expr_copy(s->init_expr), expr_copy(s->expr), expr_copy(s->next_expr), stmt_copy(s->body), stmt_copy(s->else_body), stmt_copy(s->next));
+}
+
 void stmt_print(struct stmt* s, int tabLevel) {
 
 	if(!s) {
@@ -152,6 +168,7 @@ int stmt_typecheck(struct stmt* s, struct type* return_type) {
 	}
 
 	int result = 1;
+	int errors = expr_type_errors;
 
 	switch(s->kind) {
 		case STMT_DECL:
@@ -159,9 +176,7 @@ int stmt_typecheck(struct stmt* s, struct type* return_type) {
 			break;
 		case STMT_EXPR:
 			;
-			struct type* expr_type = expr_typecheck(s->expr);
-			result = expr_type->errorless && result;
-			type_delete(expr_type);
+			expr_typecheck(s->expr);
 			break;
 		case STMT_IF_ELSE:
 			;
@@ -172,23 +187,19 @@ int stmt_typecheck(struct stmt* s, struct type* return_type) {
 				printf("\n");
 				result = 0;
 			}
-			result = if_cond_type->errorless && result;
 			result = stmt_typecheck(s->body, return_type) && result;
 
 			// If the if statement has an else block, resolve that too
 			if(s->else_body) {
 				result = stmt_typecheck(s->else_body, return_type) && result;
 			}
-			type_delete(if_cond_type);
 			break;
 		case STMT_BLOCK:
 			result = stmt_typecheck(s->body, return_type) && result;
 			break;
 		case STMT_FOR:
 			;
-			struct type* init_type = expr_typecheck(s->init_expr);
-			result = ((init_type) ? init_type->errorless : 1) && result;
-			type_delete(init_type);
+			expr_typecheck(s->init_expr);
 
 			// Ensure  middle expr in for loop is of type boolean
 			struct type* for_cond_type = expr_typecheck(s->expr);
@@ -198,12 +209,8 @@ int stmt_typecheck(struct stmt* s, struct type* return_type) {
 				printf("\n");
 				result = 0;
 			}
-			result = ((for_cond_type) ? for_cond_type->errorless : 1) && result;
-			type_delete(for_cond_type);
 
-			struct type* next_type = expr_typecheck(s->next_expr);
-			result = ((next_type) ? next_type->errorless : 1) && result;
-			type_delete(next_type);
+			expr_typecheck(s->next_expr);
 
 			result = stmt_typecheck(s->body, return_type) && result;
 			break;
@@ -220,9 +227,7 @@ int stmt_typecheck(struct stmt* s, struct type* return_type) {
 					printf("). Only boolean, integer, character, and string are allowed.\n");
 					result = 0;
 				}
-				result = t->errorless && result;
 				curr = curr->next;
-				type_delete(t);
 			}
 			break;
 		case STMT_RETURN:
@@ -238,11 +243,14 @@ int stmt_typecheck(struct stmt* s, struct type* return_type) {
 				printf("\n");
 				result = 0;
 			}
-			result = ((t) ? t->errorless : 1) && result;
-			type_delete(t);
 			break;
 	}
 
+	// Expressions found ill typed above make the statement ill typed
+	if (expr_type_errors != errors) {
+		result = 0;
+	}
+
 	return stmt_typecheck(s->next, return_type) && result;
 
 
@@ -294,6 +302,75 @@ void stmt_codegen_globals(struct stmt* s, FILE* fp) {
 
 }
 
+// Point the slot of every local array declared in s at its storage, which
+// starts at the stack pointer right after the frame is aligned
+void stmt_codegen_local_array_pointers(struct stmt* s, FILE* fp) {
+
+	if (!s) {
+		return;
+	}
+
+	switch(s->kind) {
+		case STMT_DECL:
+			if (s->decl->type->kind == TYPE_ARRAY) {
+				const char* var_loc = symbol_codegen(s->decl->symbol);
+				fprintf(fp, "LEAQ %d(%%rsp), %%rax\n", s->decl->array_offset);
+				fprintf(fp, "MOVQ %%rax, %s\n", var_loc);
+				free((char*) var_loc);
+			}
+			break;
+		case STMT_IF_ELSE:
+			stmt_codegen_local_array_pointers(s->body, fp);
+			stmt_codegen_local_array_pointers(s->else_body, fp);
+			break;
+		case STMT_BLOCK:
+		case STMT_FOR:
+			stmt_codegen_local_array_pointers(s->body, fp);
+			break;
+		default:
+			break;
+	}
+
+	stmt_codegen_local_array_pointers(s->next, fp);
+
+}
+
+// Add the names of the globals that s may write to written
+void stmt_collect_written_globals(struct stmt* s, struct hash_table* written) {
+
+	if (!s) {
+		return;
+	}
+
+	switch(s->kind) {
+		case STMT_DECL:
+			expr_collect_written_globals(s->decl->value, written);
+			break;
+		case STMT_IF_ELSE:
+			expr_collect_written_globals(s->expr, written);
+			stmt_collect_written_globals(s->body, written);
+			stmt_collect_written_globals(s->else_body, written);
+			break;
+		case STMT_BLOCK:
+			stmt_collect_written_globals(s->body, written);
+			break;
+		case STMT_FOR:
+			expr_collect_written_globals(s->init_expr, written);
+			expr_collect_written_globals(s->expr, written);
+			expr_collect_written_globals(s->next_expr, written);
+			stmt_collect_written_globals(s->body, written);
+			break;
+		case STMT_PRINT:
+		case STMT_RETURN:
+		case STMT_EXPR:
+			expr_collect_written_globals(s->expr, written);
+			break;
+	}
+
+	stmt_collect_written_globals(s->next, written);
+
+}
+
 void stmt_codegen(struct stmt* s, FILE* fp, const char* enclosing_func_name) {
 
 	if (!s) {
@@ -306,13 +383,16 @@ void stmt_codegen(struct stmt* s, FILE* fp, const char* enclosing_func_name) {
 			decl_codegen(s->decl, fp);
 			break;
 		case STMT_IF_ELSE:
-			expr_codegen(s->expr, fp);
+			// Replace small assignment diamonds with a conditional move
+			if (stmt_if_conversion_codegen(s, fp)) {
+				break;
+			}
+
 			int if_label1 = label_create();
 			const char* if_label1_name = label_name(if_label1);
 			int if_label2;
 			const char* if_label2_name;
-			fprintf(fp, "CMP $1, %s\n", scratch_name(s->expr->register_number));
-			fprintf(fp, "JNE %s\n", if_label1_name);
+			select_branch_codegen(s->expr, if_label1_name, fp);
 			stmt_codegen(s->body, fp, enclosing_func_name);
 			
 			// if there's an else block, we need to create a new label and jump to it
@@ -332,8 +412,6 @@ void stmt_codegen(struct stmt* s, FILE* fp, const char* enclosing_func_name) {
 				free((char*) if_label2_name);
 			}
 
-			// Free the expression register
-			scratch_free(s->expr->register_number);
 			free((char*) if_label1_name);
 			break;
 		case STMT_BLOCK:
@@ -345,23 +423,16 @@ void stmt_codegen(struct stmt* s, FILE* fp, const char* enclosing_func_name) {
 			const char* for_label1_name = label_name(for_label1);
 			int for_label2 = label_create();
 			const char* for_label2_name = label_name(for_label2);
-			expr_codegen(s->init_expr, fp);
+			select_effect_codegen(s->init_expr, fp);
 			fprintf(fp, "%s:\n", for_label1_name);
-			expr_codegen(s->expr, fp);
 			if(s->expr) {
-				fprintf(fp, "CMP $1, %s\n", scratch_name(s->expr->register_number));
-				fprintf(fp, "JNE %s\n", for_label2_name);
+				select_branch_codegen(s->expr, for_label2_name, fp);
 			}
 			stmt_codegen(s->body, fp, enclosing_func_name);
-			expr_codegen(s->next_expr, fp);
+			select_effect_codegen(s->next_expr, fp);
 			fprintf(fp, "JMP %s\n", for_label1_name);
 			fprintf(fp, "%s:\n", for_label2_name);
 
-			// Free scratch registers
-			if (s->init_expr) scratch_free(s->init_expr->register_number);
-			if (s->expr) scratch_free(s->expr->register_number);
-			if (s->next_expr) scratch_free(s->next_expr->register_number);
-
 			// Free label names
 			free((char*) for_label1_name);
 			free((char*) for_label2_name);
@@ -377,8 +448,7 @@ void stmt_codegen(struct stmt* s, FILE* fp, const char* enclosing_func_name) {
 				// Move the expression register into a function argument register
 				param_list_move_register_to_function_argument_register(curr->register_number, 0, fp);
 
-				// Typecheck the expression
-				struct type* t = expr_typecheck(curr);
+				struct type* t = curr->type;
 
 				int register_num;
 
@@ -420,11 +490,97 @@ void stmt_codegen(struct stmt* s, FILE* fp, const char* enclosing_func_name) {
 			fprintf(fp, "JMP %s_epilogue\n", enclosing_func_name);
 			break;
 		case STMT_EXPR:
-			expr_codegen(s->expr, fp);
-			scratch_free(s->expr->register_number);
+			select_effect_codegen(s->expr, fp);
 			break;
 	}
 
 	stmt_codegen(s->next, fp, enclosing_func_name);
 
 }
+
+// If s is a single assignment to a scalar variable (optionally wrapped in a
+// block), return the assignment expression
+struct expr* stmt_get_single_assignment(struct stmt* s) {
+
+	if (!s) {
+		return 0;
+	}
+
+	if (s->kind == STMT_BLOCK) {
+		if (!s->body || s->body->next) {
+			return 0;
+		}
+		s = s->body;
+	}
+	else if (s->next) {
+		// Optimizations may have placed statements in front of a lone arm
+		return 0;
+	}
+
+	if (s->kind != STMT_EXPR || s->expr->kind != EXPR_ASSIGN || s->expr->left->kind != EXPR_NAME) {
+		return 0;
+	}
+
+	type_t kind = s->expr->left->symbol->type->kind;
+	if (kind != TYPE_INTEGER && kind != TYPE_BOOLEAN && kind != TYPE_CHARACTER) {
+		return 0;
+	}
+
+	return s->expr;
+}
+
+// Generate an if statement whose arms only assign cheap, side effect free
+// values to the same variable as a branch-free CMOV sequence
+// Returns whether the statement was converted
+int stmt_if_conversion_codegen(struct stmt* s, FILE* fp) {
+
+	struct expr* then_assign = stmt_get_single_assignment(s->body);
+	struct expr* else_assign = stmt_get_single_assignment(s->else_body);
+
+	if (!then_assign || (s->else_body && !else_assign)) {
+		return 0;
+	}
+
+	if (else_assign && then_assign->left->symbol != else_assign->left->symbol) {
+		return 0;
+	}
+
+	// Without an else block the variable keeps its current value
+	struct expr* then_value = then_assign->right;
+	struct expr* else_value = (else_assign) ? else_assign->right : then_assign->left;
+
+	int then_budget = stmt_if_conversion_max_cost;
+	int else_budget = stmt_if_conversion_max_cost;
+	if (!expr_is_cheap_and_pure(then_value, &then_budget) || !expr_is_cheap_and_pure(else_value, &else_budget)) {
+		return 0;
+	}
+
+	// Both arms are live at the same time, so make sure they fit in registers
+	int need = expr_register_need(s->expr);
+	if (need < 1 + expr_register_need(then_value)) {
+		need = 1 + expr_register_need(then_value);
+	}
+	if (need < 2 + expr_register_need(else_value)) {
+		need = 2 + expr_register_need(else_value);
+	}
+	if (need > scratch_count_free()) {
+		return 0;
+	}
+
+	expr_codegen(s->expr, fp);
+	expr_codegen(then_value, fp);
+	expr_codegen(else_value, fp);
+
+	fprintf(fp, "CMP $0, %s\n", scratch_name(s->expr->register_number));
+	fprintf(fp, "CMOVNE %s, %s\n", scratch_name(then_value->register_number), scratch_name(else_value->register_number));
+
+	const char* var_loc = symbol_codegen(then_assign->left->symbol);
+	fprintf(fp, "MOVQ %s, %s\n", scratch_name(else_value->register_number), var_loc);
+	free((char*) var_loc);
+
+	scratch_free(s->expr->register_number);
+	scratch_free(then_value->register_number);
+	scratch_free(else_value->register_number);
+
+	return 1;
+}
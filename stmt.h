@@ -4,6 +4,7 @@
 #include "type.h"
 #include "expr.h"
 #include "decl.h"
+#include "hash_table.h"
 #include <stdio.h>
 
 struct type;
@@ -30,12 +31,17 @@ struct stmt {
 };
 
 struct stmt* stmt_create(stmt_t kind, struct decl* decl, struct expr* init_expr, struct expr* expr, struct expr* next_expr, struct stmt* body, struct stmt* else_body, struct stmt* next);
+struct stmt* stmt_copy(struct stmt* s);
 void stmt_print(struct stmt* s, int tabLevel);
 int stmt_resolve(struct stmt* s, int total_decl_num, int verbose, struct decl* enclosing_func);
 int stmt_resolve_helper(struct stmt* s, int* decl_num, int total_decl_num, int verbose, struct decl* enclosing_func);
 int stmt_typecheck(struct stmt* s, struct type* return_type);
 void printTabsStmt(int tabLevel);
 void stmt_codegen_globals(struct stmt* s, FILE* fp);
+void stmt_codegen_local_array_pointers(struct stmt* s, FILE* fp);
+void stmt_collect_written_globals(struct stmt* s, struct hash_table* written);
 void stmt_codegen(struct stmt* s, FILE* fp, const char* enclosing_func_name);
+struct expr* stmt_get_single_assignment(struct stmt* s);
+int stmt_if_conversion_codegen(struct stmt* s, FILE* fp);
 
 #endif
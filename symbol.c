@@ -1,13 +1,14 @@
 #include "symbol.h"
 #include "type.h"
 #include "utils.h"
+#include "arena.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 struct symbol* symbol_create(symbol_t kind, struct type* type, const char* name, int which, int which_total) {
 
-	struct symbol* s = malloc(sizeof(*s));
+	struct symbol* s = arena_alloc(&ast_arena, sizeof(*s));
 	s->kind = kind;
 	s->type = type;
 	s->name = name;
@@ -24,40 +25,25 @@ struct symbol* symbol_copy(struct symbol* s) {
 		return 0;
 	}
 
-	struct symbol* new_s = malloc(sizeof(*s));
+	struct symbol* new_s = arena_alloc(&ast_arena, sizeof(*s));
 	new_s->kind = s->kind;
-	new_s->type = type_copy(s->type);
-	new_s->name = (s->name) ? strdup(s->name) : 0;
+	new_s->type = s->type;
+	new_s->name = s->name;
 	new_s->which = s->which;
 	new_s->which_total = s->which_total;
 
 	return new_s;
 }
 
-void symbol_delete(struct symbol* s) {
-
-	if (s) {
-
-		type_delete(s->type);
-		free((char*) s->name);
-	
-		free(s);
-	}
-
-}
-
 const char* symbol_codegen(struct symbol* s) {
 
+	// Globals are addressed relative to %rip so the code is position
+	// independent. For arrays this is the address of the first element.
 	if(s->kind == SYMBOL_GLOBAL) {
-		if(s->type->kind == TYPE_STRING || s->type->kind == TYPE_ARRAY) {
-			int bufsize = strlen(s->name) + 2;
-			char* newbuf = malloc(sizeof(char) * bufsize);
-			snprintf(newbuf, bufsize, "$%s", s->name);
-			return newbuf;
-		}
-		else {
-			return strdup(s->name);
-		}
+		int bufsize = strlen(s->name) + 7;
+		char* newbuf = malloc(sizeof(char) * bufsize);
+		snprintf(newbuf, bufsize, "%s(%%rip)", s->name);
+		return newbuf;
 	}
 
 	int offset = -8 * s->which_total;
@@ -17,7 +17,6 @@ struct symbol {
 
 struct symbol* symbol_create(symbol_t kind, struct type* type, const char* name, int which, int which_total);
 struct symbol* symbol_copy(struct symbol* s);
-void symbol_delete(struct symbol* s);
 const char* symbol_codegen(struct symbol* s);
 
 #endif
@@ -1,19 +1,63 @@
 #include "type.h"
 #include "expr.h"
 #include "param_list.h"
+#include "arena.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 
+// The one instance of each type without parts
+static struct type type_scalars[] = {
+	[TYPE_BOOLEAN] = {TYPE_BOOLEAN},
+	[TYPE_CHARACTER] = {TYPE_CHARACTER},
+	[TYPE_INTEGER] = {TYPE_INTEGER},
+	[TYPE_STRING] = {TYPE_STRING},
+	[TYPE_VOID] = {TYPE_VOID}
+};
+
 struct type* type_create(type_t kind, struct type* subtype, struct expr* size, struct param_list* params) {
-	struct type* t = malloc(sizeof(*t));
+
+	if (kind == TYPE_ARRAY) {
+		return type_array(subtype, (size) ? size->literal_value : -1);
+	}
+
+	if (kind != TYPE_FUNCTION) {
+		return &type_scalars[kind];
+	}
+
+	struct type* t = arena_alloc(&ast_arena, sizeof(*t));
 
 	// Add values to t
 	t->kind = kind;
 	t->subtype = subtype;
-	t->size = size;
+	t->size = 0;
 	t->params = params;
-	t->errorless = 1;
+	t->arrays = 0;
+	t->next_array = 0;
+
+	return t;
+}
+
+// Array of size elements of subtype, or of unknown size if size is -1
+// Each element type lists the arrays made of it, which are few, so looking
+// one up allocates nothing after the first time
+struct type* type_array(struct type* subtype, int size) {
+
+	struct type* t;
+	for(t = subtype->arrays; t; t = t->next_array) {
+		if ((t->size) ? t->size->literal_value == size : size < 0) {
+			return t;
+		}
+	}
+
+	t = arena_alloc(&ast_arena, sizeof(*t));
+	t->kind = TYPE_ARRAY;
+	t->subtype = subtype;
+	t->size = (size < 0) ? 0 : expr_create(EXPR_INTEGER_LITERAL, 10, 0, 0, 0, size, 0);
+	t->params = 0;
+	t->arrays = 0;
+	t->next_array = subtype->arrays;
+	subtype->arrays = t;
 
 	return t;
 }
@@ -55,57 +99,23 @@ void type_print(struct type* t) {
 
 int type_equals(struct type* a, struct type* b) {
 
-	if(!a && !b) {
+	if (a == b) {
 		return 1;
 	}
 
-	else if(!a || !b) {
+	if (!a || !b || a->kind != b->kind) {
 		return 0;
 	}
 
-	if (a->kind == b->kind) {
-		if (a->kind == TYPE_BOOLEAN || a->kind == TYPE_CHARACTER || a->kind == TYPE_INTEGER || a->kind == TYPE_STRING || a->kind == TYPE_VOID) {
-			return 1;
-		}
-		else if (a->kind == TYPE_FUNCTION) {
-			return type_equals(a->subtype, b->subtype) && param_list_equals(a->params, b->params);
-		}
-		else if (a->kind == TYPE_ARRAY) {
-			return type_equals(a->subtype, b->subtype);
-		}
+	// Sizes are checked where arrays are assigned, so only the elements must match
+	if (a->kind == TYPE_ARRAY) {
+		return type_equals(a->subtype, b->subtype);
 	}
-
-	return 0;
-
-}
-
-struct type* type_copy(struct type* t) {
-
-	if(!t) {
-		return 0;
+	else if (a->kind == TYPE_FUNCTION) {
+		return type_equals(a->subtype, b->subtype) && param_list_equals(a->params, b->params);
 	}
 
-	struct type* new_t = malloc(sizeof(*new_t));
-
-	new_t->kind = t->kind;
-	new_t->subtype = type_copy(t->subtype);
-	new_t->size = expr_copy(t->size);
-	new_t->params = param_list_copy(t->params);
-	new_t->errorless = t->errorless;
-
-	return new_t;
-
-}
-
-void type_delete(struct type* t) {
-
-	if(t) {
-		type_delete(t->subtype);
-		expr_delete(t->size);
-		param_list_delete(t->params);
-
-		free(t);
-	}
+	return 0;
 
 }
 
@@ -117,15 +127,32 @@ const char* type_get_x86_type_string(struct type* t) {
 		sprintf(x86_type, ".quad");
 	}
 	else if(t->kind == TYPE_STRING) {
-		sprintf(x86_type, ".string");
+		// Strings are stored as pointers to their characters
+		sprintf(x86_type, ".quad");
 	}
 	else if(t->kind == TYPE_ARRAY) {
+		if (type_element_size(t) == 1) {
+			sprintf(x86_type, ".byte");
+			return x86_type;
+		}
+		free(x86_type);
 		return type_get_x86_type_string(t->subtype);
 	}
 
 	return x86_type;
 }
 
+// Number of bytes taken by each element of array type t
+// Characters and booleans are packed one per byte
+int type_element_size(struct type* t) {
+
+	if (t->subtype->kind == TYPE_CHARACTER || t->subtype->kind == TYPE_BOOLEAN) {
+		return 1;
+	}
+
+	return 8;
+}
+
 const char* type_generate_default_literal_value(struct type* t) {
 
 	char* return_val;
@@ -137,22 +164,29 @@ const char* type_generate_default_literal_value(struct type* t) {
 		return_val = "0";
 	}
 	else if (t->kind == TYPE_CHARACTER) {
-		return_val = "a";
+		return_val = "0";
 	}
 	else if (t->kind == TYPE_STRING) {
-		return_val = "";
+		return_val = (char*) expr_intern_string("");
 	}
 	else if (t->kind == TYPE_ARRAY) {
+		// Repeat the default value of the element type
 		int size = t->size->literal_value;
-		char val[2*size];
-		val[0] = '0';
+		const char* element = type_generate_default_literal_value(t->subtype);
+		int element_length = strlen(element);
+		char* val = malloc(sizeof(char) * (size * (element_length + 1) + 1));
+		int length = 0;
 		int i;
-		for(i = 1; i < 2*size-1; i += 2) {
-			val[i] = ',';
-			val[i+1] = '0';
+		for(i = 0; i < size; i++) {
+			if (i > 0) {
+				val[length++] = ',';
+			}
+			memcpy(val + length, element, element_length);
+			length += element_length;
 		}
-		val[2*size-1] = '\0';
-		return strdup(val);
+		val[length] = '\0';
+		free((char*) element);
+		return val;
 	}
 	else if (t->kind == TYPE_BOOLEAN) {
 		return_val = "0";
@@ -16,20 +16,24 @@ typedef enum {
 	TYPE_VOID
 } type_t;
 
+// Types other than functions exist once each and never change, so they are
+// shared freely. A function type belongs to its declaration, which owns the
+// names and symbols of the parameters.
 struct type {
 	type_t kind;
 	struct type* subtype;
 	struct expr* size;
 	struct param_list* params;
-	int errorless;
+	struct type* arrays;
+	struct type* next_array;
 };
 
 struct type* type_create(type_t kind, struct type* subtype, struct expr* size, struct param_list* params);
+struct type* type_array(struct type* subtype, int size);
 void type_print(struct type* t);
 int type_equals(struct type* a, struct type* b);
-struct type* type_copy(struct type* t);
-void type_delete(struct type* t);
 const char* type_get_x86_type_string(struct type* t);
+int type_element_size(struct type* t);
 const char* type_generate_default_literal_value(struct type* t);
 
 #endif
@@ -0,0 +1,1167 @@
+// vm.c
+// Implementation of functions in vm.h
+// A program compiles to one image: a header, the functions, their
+// instructions, the initial values of the globals and the strings. The image
+// is written to a bytecode file as it is, and a file is run by mapping it into
+// memory, copying only the globals, which the program may change.
+// The interpreter dispatches through a table of label addresses. Comparisons
+// that only decide a branch and subscripts each compile to one instruction.
+
+#include "vm.h"
+#include "library.h"
+#include "type.h"
+#include "symbol.h"
+#include "param_list.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Functions of the runtime library that programs may call, indexed by the
+// k operand of VM_CALLR
+struct vm_binding vm_runtime[] = {
+	{"print_integer", (long (*)(long, long)) print_integer},
+	{"print_string", (long (*)(long, long)) print_string},
+	{"print_boolean", (long (*)(long, long)) print_boolean},
+	{"print_character", (long (*)(long, long)) print_character},
+	{"integer_power", (long (*)(long, long)) integer_power},
+	{"string_length", (long (*)(long, long)) string_length},
+	{"string_hash", (long (*)(long, long)) string_hash},
+	{"string_equals", (long (*)(long, long)) string_equals}
+};
+
+int vm_runtime_count = sizeof(vm_runtime) / sizeof(vm_runtime[0]);
+
+#define VM_VERSION 1
+#define VM_MAX_REGISTERS 65536
+#define VM_STACK_WORDS (1 << 21)
+#define VM_MAX_DEPTH (1 << 16)
+
+// Compile the program into a bytecode image
+// size receives the number of bytes in the image
+char* vm_compile(struct decl* program, int* size) {
+
+	struct vm_compiler c;
+	memset(&c, 0, sizeof(c));
+	c.global_index = hash_table_create(0, 0);
+	c.function_index = hash_table_create(0, 0);
+	c.string_index = hash_table_create(0, 0);
+
+	// Number the functions first, so calls may come before definitions
+	struct decl* d;
+	int num_functions = 0;
+	for(d = program; d; d = d->next) {
+		if (d->type->kind == TYPE_FUNCTION && d->code) {
+			struct vm_function f;
+			memset(&f, 0, sizeof(f));
+			vm_append(&c.functions, &f, sizeof(f));
+			hash_table_insert(c.function_index, d->name, (void*) (long) ++num_functions);
+		}
+	}
+
+	long main_function = (long) hash_table_lookup(c.function_index, "main");
+	if (!main_function) {
+		printf("codegen error: the program has no main function\n");
+		exit(1);
+	}
+
+	vm_compile_globals(&c, program);
+
+	for(d = program; d; d = d->next) {
+		if (d->type->kind == TYPE_FUNCTION && d->code) {
+			vm_compile_function(&c, d);
+		}
+	}
+
+	// Lay the tables out one after another, each aligned to 8 bytes
+	struct vm_header h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, "CMBC", 4);
+	h.version = VM_VERSION;
+	h.main_function = main_function - 1;
+	h.num_functions = num_functions;
+	h.num_insns = c.insns.size / sizeof(struct vm_insn);
+	h.num_globals = c.globals.size / sizeof(int64_t);
+	h.num_relocations = c.relocations.size / sizeof(int32_t);
+	h.string_bytes = c.strings.size;
+
+	int offset = (sizeof(h) + 7) / 8 * 8;
+	struct vm_buffer* tables[5] = {&c.functions, &c.insns, &c.globals, &c.relocations, &c.strings};
+	int32_t* offsets[5] = {&h.functions, &h.insns, &h.globals, &h.relocations, &h.strings};
+	int i;
+	for(i = 0; i < 5; i++) {
+		*offsets[i] = offset;
+		offset = (offset + tables[i]->size + 7) / 8 * 8;
+	}
+	h.size = offset;
+
+	char* image = calloc(1, offset);
+	memcpy(image, &h, sizeof(h));
+	for(i = 0; i < 5; i++) {
+		if (tables[i]->size) {
+			memcpy(image + *offsets[i], tables[i]->bytes, tables[i]->size);
+		}
+		free(tables[i]->bytes);
+	}
+	free(c.frame_addresses.bytes);
+
+	hash_table_delete(c.global_index);
+	hash_table_delete(c.function_index);
+	hash_table_delete(c.string_index);
+
+	*size = offset;
+	return image;
+}
+
+// Give each global its words and initial values
+void vm_compile_globals(struct vm_compiler* c, struct decl* d) {
+
+	for(; d; d = d->next) {
+		if (d->type->kind == TYPE_FUNCTION) {
+			continue;
+		}
+
+		int index = c->globals.size / sizeof(int64_t);
+		hash_table_insert(c->global_index, d->name, (void*) (long) (index + 1));
+
+		struct type* t = (d->type->kind == TYPE_ARRAY) ? d->type->subtype : d->type;
+		int words = (d->type->kind == TYPE_ARRAY) ? vm_array_words(d->type, d->name) : 1;
+		struct expr* e = (d->type->kind == TYPE_ARRAY && d->value) ? d->value->right : d->value;
+
+		int i;
+		for(i = 0; i < words; i++) {
+			int64_t value = 0;
+
+			if (e && (e->kind == EXPR_INTEGER_LITERAL || e->kind == EXPR_CHAR_LITERAL)) {
+				value = e->literal_value;
+			}
+			else if (e && e->kind == EXPR_TRUE) {
+				value = 1;
+			}
+			else if (e && e->kind == EXPR_STRING_LITERAL) {
+				int length = strlen(e->original_literal_value);
+				char* spelling = strndup(e->original_literal_value + 1, length - 2);
+				value = vm_string(c, spelling);
+				free(spelling);
+			}
+			else if (!e && t->kind == TYPE_STRING) {
+				value = vm_string(c, "");
+			}
+			else if (e && e->kind != EXPR_FALSE) {
+				printf("codegen error: global %s must be initialized with literals\n", d->name);
+				exit(1);
+			}
+
+			// Strings are stored as offsets until the image is loaded
+			if (t->kind == TYPE_STRING) {
+				int32_t word = index + i;
+				vm_append(&c->relocations, &word, sizeof(word));
+			}
+
+			vm_append(&c->globals, &value, sizeof(value));
+			if (e) {
+				e = e->next;
+			}
+		}
+	}
+
+}
+
+void vm_compile_function(struct vm_compiler* c, struct decl* f) {
+
+	int num_params = param_list_count_params(f->type->params);
+	c->registers = num_params + f->num_locals;
+	c->top = c->registers;
+	c->max_registers = c->registers;
+	c->array_words = 0;
+	c->frame_addresses.size = 0;
+
+	int entry = vm_here(c);
+	vm_compile_stmt(c, f->code);
+	vm_emit(c, VM_RETZ, 0, 0, 0, 0);
+
+	// Local arrays lie after the registers, whose number is only known now
+	struct vm_insn* insns = (struct vm_insn*) c->insns.bytes;
+	int* addresses = (int*) c->frame_addresses.bytes;
+	int i;
+	for(i = 0; i < c->frame_addresses.size / (int) sizeof(int); i++) {
+		insns[addresses[i]].k += c->max_registers;
+	}
+
+	long index = (long) hash_table_lookup(c->function_index, f->name) - 1;
+	struct vm_function* function = (struct vm_function*) c->functions.bytes + index;
+	function->entry = entry;
+	function->num_params = num_params;
+	function->num_registers = c->max_registers;
+	function->array_words = c->array_words;
+	function->name = vm_string(c, f->name);
+
+}
+
+void vm_compile_stmt(struct vm_compiler* c, struct stmt* s) {
+
+	for(; s; s = s->next) {
+		int jump;
+		int jump_over;
+		int top;
+
+		switch(s->kind) {
+			case STMT_DECL:
+				vm_compile_decl(c, s->decl);
+				break;
+			case STMT_EXPR:
+				vm_compile_effect(c, s->expr);
+				break;
+			case STMT_IF_ELSE:
+				jump = vm_compile_branch(c, s->expr);
+				c->top = c->registers;
+				vm_compile_stmt(c, s->body);
+				if (s->else_body) {
+					jump_over = vm_emit(c, VM_JMP, 0, 0, 0, 0);
+					vm_patch(c, jump, vm_here(c));
+					vm_compile_stmt(c, s->else_body);
+					vm_patch(c, jump_over, vm_here(c));
+				}
+				else {
+					vm_patch(c, jump, vm_here(c));
+				}
+				break;
+			case STMT_FOR:
+				vm_compile_effect(c, s->init_expr);
+				c->top = c->registers;
+				top = vm_here(c);
+				jump = (s->expr) ? vm_compile_branch(c, s->expr) : -1;
+				c->top = c->registers;
+				vm_compile_stmt(c, s->body);
+				vm_compile_effect(c, s->next_expr);
+				vm_emit(c, VM_JMP, 0, 0, 0, top);
+				if (jump >= 0) {
+					vm_patch(c, jump, vm_here(c));
+				}
+				break;
+			case STMT_PRINT:
+				;
+				struct expr* e;
+				for(e = s->expr; e; e = e->next) {
+					int r = vm_compile_expr(c, e);
+					struct type* t = e->type;
+					vm_opcode_t op = (t->kind == TYPE_BOOLEAN) ? VM_PRINTB : (t->kind == TYPE_CHARACTER) ? VM_PRINTC : (t->kind == TYPE_STRING) ? VM_PRINTS : VM_PRINTI;
+					vm_emit(c, op, r, 0, 0, 0);
+					c->top = c->registers;
+				}
+				break;
+			case STMT_RETURN:
+				if (s->expr) {
+					vm_emit(c, VM_RET, vm_compile_expr(c, s->expr), 0, 0, 0);
+				}
+				else {
+					vm_emit(c, VM_RETZ, 0, 0, 0, 0);
+				}
+				break;
+			case STMT_BLOCK:
+				vm_compile_stmt(c, s->body);
+				break;
+		}
+
+		// Temporaries only live within a statement
+		c->top = c->registers;
+	}
+
+}
+
+void vm_compile_decl(struct vm_compiler* c, struct decl* d) {
+
+	int reg = vm_register(c, d->symbol);
+
+	if (d->type->kind != TYPE_ARRAY) {
+		if (d->value) {
+			int r = vm_compile_expr(c, d->value);
+			if (r != reg) {
+				vm_emit(c, VM_MOV, reg, r, 0, 0);
+			}
+		}
+		return;
+	}
+
+	// Each local array has its own words in the frame
+	int words = vm_array_words(d->type, d->name);
+	int address = vm_emit(c, VM_LADDR, reg, 0, 0, c->array_words);
+	vm_append(&c->frame_addresses, &address, sizeof(address));
+	c->array_words += words;
+
+	if (d->value) {
+		if (d->value->kind == EXPR_ARRAY_INITIALIZER) {
+			printf("codegen error: local arrays not supported\n");
+			exit(1);
+		}
+		vm_emit(c, VM_COPY, reg, vm_compile_expr(c, d->value), 0, words);
+	}
+	else {
+		vm_emit(c, VM_ZERO, reg, 0, 0, words);
+	}
+
+}
+
+// Returns the register holding the value of e, which may be the register of
+// a variable and must then not be written
+int vm_compile_expr(struct vm_compiler* c, struct expr* e) {
+
+	int mark = c->top;
+	int t;
+	int l;
+	int r;
+	vm_opcode_t op;
+
+	switch(e->kind) {
+		case EXPR_INTEGER_LITERAL:
+		case EXPR_CHAR_LITERAL:
+		case EXPR_TRUE:
+		case EXPR_FALSE:
+			t = vm_temporary(c);
+			vm_emit(c, VM_LOADI, t, 0, 0, (e->kind == EXPR_TRUE) ? 1 : (e->kind == EXPR_FALSE) ? 0 : e->literal_value);
+			return t;
+		case EXPR_STRING_LITERAL:
+			;
+			int length = strlen(e->original_literal_value);
+			char* spelling = strndup(e->original_literal_value + 1, length - 2);
+			t = vm_temporary(c);
+			vm_emit(c, VM_LOADS, t, 0, 0, vm_string(c, spelling));
+			free(spelling);
+			return t;
+		case EXPR_NAME:
+			if (e->symbol->kind != SYMBOL_GLOBAL) {
+				return vm_register(c, e->symbol);
+			}
+			t = vm_temporary(c);
+			vm_emit(c, (e->symbol->type->kind == TYPE_ARRAY) ? VM_GADDR : VM_LOADG, t, 0, 0, vm_global(c, e->name));
+			return t;
+		case EXPR_PLUS:
+		case EXPR_MINUS:
+			// Adding a constant needs no register for it
+			if (vm_is_small_literal(e->right)) {
+				l = vm_compile_expr(c, e->left);
+				c->top = mark;
+				t = vm_temporary(c);
+				vm_emit(c, VM_ADDI, t, l, 0, (e->kind == EXPR_PLUS) ? e->right->literal_value : -e->right->literal_value);
+				return t;
+			}
+			op = (e->kind == EXPR_PLUS) ? VM_ADD : VM_SUB;
+			break;
+		case EXPR_MULT:
+			op = VM_MUL;
+			break;
+		case EXPR_DIVIDE:
+			op = VM_DIV;
+			break;
+		case EXPR_MODULUS:
+			op = VM_MOD;
+			break;
+		case EXPR_XOR:
+			op = VM_POW;
+			break;
+		case EXPR_AND:
+			op = VM_AND;
+			break;
+		case EXPR_OR:
+			op = VM_OR;
+			break;
+		case EXPR_LT:
+			op = VM_LT;
+			break;
+		case EXPR_LE:
+			op = VM_LE;
+			break;
+		case EXPR_GT:
+			op = VM_GT;
+			break;
+		case EXPR_GE:
+			op = VM_GE;
+			break;
+		case EXPR_EQUAL:
+			op = (vm_is_string(e->left)) ? VM_STREQ : VM_EQ;
+			break;
+		case EXPR_NE:
+			op = (vm_is_string(e->left)) ? VM_STRNE : VM_NE;
+			break;
+		case EXPR_SUBSCRIPT:
+			op = VM_LOADX;
+			break;
+		case EXPR_UNARY_MINUS:
+		case EXPR_NOT:
+			r = vm_compile_expr(c, e->right);
+			c->top = mark;
+			t = vm_temporary(c);
+			vm_emit(c, (e->kind == EXPR_NOT) ? VM_NOT : VM_NEG, t, r, 0, 0);
+			return t;
+		case EXPR_ASSIGN:
+			return vm_compile_assign(c, e);
+		case EXPR_INCREMENT:
+		case EXPR_DECREMENT:
+			return vm_compile_step(c, e, 1);
+		case EXPR_CALL:
+			return vm_compile_call(c, e);
+		default:
+			printf("codegen error: local arrays not supported\n");
+			exit(1);
+	}
+
+	l = vm_operand(c, e->left, e->right);
+	r = vm_compile_expr(c, e->right);
+	c->top = mark;
+	t = vm_temporary(c);
+	vm_emit(c, op, t, l, r, 0);
+	return t;
+}
+
+// Compile e for its side effects only
+void vm_compile_effect(struct vm_compiler* c, struct expr* e) {
+
+	if (!e) {
+		return;
+	}
+
+	if (e->kind == EXPR_INCREMENT || e->kind == EXPR_DECREMENT) {
+		vm_compile_step(c, e, 0);
+	}
+	else {
+		vm_compile_expr(c, e);
+	}
+
+}
+
+// Compile a jump taken when e is false, and return it for patching
+int vm_compile_branch(struct vm_compiler* c, struct expr* e) {
+
+	vm_opcode_t op;
+
+	switch(e->kind) {
+		case EXPR_LT:
+			op = VM_JGE;
+			break;
+		case EXPR_LE:
+			op = VM_JGT;
+			break;
+		case EXPR_GT:
+			op = VM_JLE;
+			break;
+		case EXPR_GE:
+			op = VM_JLT;
+			break;
+		case EXPR_EQUAL:
+			op = VM_JNE;
+			break;
+		case EXPR_NE:
+			op = VM_JEQ;
+			break;
+		default:
+			return vm_emit(c, VM_JZ, vm_compile_expr(c, e), 0, 0, 0);
+	}
+
+	if ((e->kind == EXPR_EQUAL || e->kind == EXPR_NE) && vm_is_string(e->left)) {
+		return vm_emit(c, VM_JZ, vm_compile_expr(c, e), 0, 0, 0);
+	}
+
+	int l = vm_operand(c, e->left, e->right);
+	if (vm_is_small_literal(e->right) && e->right->literal_value == (int16_t) e->right->literal_value) {
+		return vm_emit(c, op + (VM_JLTI - VM_JLT), l, (uint16_t) e->right->literal_value, 0, 0);
+	}
+
+	int r = vm_compile_expr(c, e->right);
+	return vm_emit(c, op, l, r, 0, 0);
+}
+
+int vm_compile_assign(struct vm_compiler* c, struct expr* e) {
+
+	struct expr* left = e->left;
+	int v;
+
+	// As in the native code, the value comes before the array and index
+	if (left->kind == EXPR_SUBSCRIPT) {
+		v = vm_operand(c, e->right, left);
+		int array = vm_operand(c, left->left, left->right);
+		int index = vm_compile_expr(c, left->right);
+		vm_emit(c, VM_STOREX, array, index, v, 0);
+		return v;
+	}
+
+	if (left->symbol->type->kind == TYPE_ARRAY) {
+		int array = vm_operand(c, left, e->right);
+		v = vm_compile_expr(c, e->right);
+		vm_emit(c, VM_COPY, array, v, 0, expr_array_assignment_size(e) / type_element_size(left->symbol->type));
+		return v;
+	}
+
+	v = vm_compile_expr(c, e->right);
+	if (left->symbol->kind == SYMBOL_GLOBAL) {
+		vm_emit(c, VM_STOREG, v, 0, 0, vm_global(c, left->name));
+		return v;
+	}
+
+	int reg = vm_register(c, left->symbol);
+	if (v != reg) {
+		vm_emit(c, VM_MOV, reg, v, 0, 0);
+	}
+	return reg;
+}
+
+// Compile ++ or --, returning the old value if value is set
+int vm_compile_step(struct vm_compiler* c, struct expr* e, int value) {
+
+	struct expr* left = e->left;
+	int delta = (e->kind == EXPR_INCREMENT) ? 1 : -1;
+	int old;
+	int updated;
+
+	if (left->kind == EXPR_NAME && left->symbol->kind != SYMBOL_GLOBAL) {
+		int reg = vm_register(c, left->symbol);
+		old = reg;
+		if (value) {
+			old = vm_temporary(c);
+			vm_emit(c, VM_MOV, old, reg, 0, 0);
+		}
+		vm_emit(c, VM_ADDI, reg, reg, 0, delta);
+		return old;
+	}
+
+	if (left->kind == EXPR_NAME) {
+		int index = vm_global(c, left->name);
+		old = vm_temporary(c);
+		updated = vm_temporary(c);
+		vm_emit(c, VM_LOADG, old, 0, 0, index);
+		vm_emit(c, VM_ADDI, updated, old, 0, delta);
+		vm_emit(c, VM_STOREG, updated, 0, 0, index);
+		return old;
+	}
+
+	int array = vm_operand(c, left->left, left->right);
+	int index = vm_compile_expr(c, left->right);
+	old = vm_temporary(c);
+	updated = vm_temporary(c);
+	vm_emit(c, VM_LOADX, old, array, index, 0);
+	vm_emit(c, VM_ADDI, updated, old, 0, delta);
+	vm_emit(c, VM_STOREX, array, index, updated, 0);
+	return old;
+}
+
+// Arguments go to consecutive registers, which become the callee's first ones
+int vm_compile_call(struct vm_compiler* c, struct expr* e) {
+
+	int count = 0;
+	struct expr* arg;
+	for(arg = e->right; arg; arg = arg->next) {
+		count++;
+	}
+
+	// Functions without a body must come from the runtime library
+	vm_opcode_t op = VM_CALL;
+	long function = (long) hash_table_lookup(c->function_index, e->left->name);
+	if (!function) {
+		op = VM_CALLR;
+		function = vm_lookup_runtime(e->left->name) + 1;
+		if (!function || count > 2) {
+			printf("codegen error: function %s is never defined\n", e->left->name);
+			exit(1);
+		}
+	}
+
+	int base = c->top;
+	int i;
+	for(i = 0; i < count; i++) {
+		vm_temporary(c);
+	}
+
+	for(arg = e->right, i = 0; arg; arg = arg->next, i++) {
+		int r = vm_compile_expr(c, arg);
+		if (r != base + i) {
+			vm_emit(c, VM_MOV, base + i, r, 0, 0);
+		}
+		c->top = base + count;
+	}
+
+	c->top = base;
+	int result = vm_temporary(c);
+	vm_emit(c, op, result, base, count, function - 1);
+	return result;
+}
+
+// Returns the index of the runtime function called name, or -1
+int vm_lookup_runtime(const char* name) {
+
+	int i;
+	for(i = 0; i < vm_runtime_count; i++) {
+		if (!strcmp(vm_runtime[i].name, name)) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+// Compile an operand whose value must survive the evaluation of later
+// A variable read directly from its register is copied first if later may
+// assign to it
+int vm_operand(struct vm_compiler* c, struct expr* e, struct expr* later) {
+
+	int r = vm_compile_expr(c, e);
+	if (r < c->registers && vm_writes_locals(later)) {
+		int t = vm_temporary(c);
+		vm_emit(c, VM_MOV, t, r, 0, 0);
+		return t;
+	}
+
+	return r;
+}
+
+// Determine whether e may assign to a local variable
+int vm_writes_locals(struct expr* e) {
+
+	if (!e) {
+		return 0;
+	}
+
+	if ((e->kind == EXPR_ASSIGN || e->kind == EXPR_INCREMENT || e->kind == EXPR_DECREMENT) && e->left->kind == EXPR_NAME && e->left->symbol->kind != SYMBOL_GLOBAL) {
+		return 1;
+	}
+
+	// Arguments of a call are chained through next
+	return vm_writes_locals(e->left) || vm_writes_locals(e->right) || vm_writes_locals(e->next);
+}
+
+int vm_is_string(struct expr* e) {
+
+	return e->type->kind == TYPE_STRING;
+}
+
+int vm_is_small_literal(struct expr* e) {
+
+	return e->kind == EXPR_INTEGER_LITERAL && e->literal_value != -2147483647 - 1;
+}
+
+int vm_temporary(struct vm_compiler* c) {
+
+	if (c->top == VM_MAX_REGISTERS) {
+		printf("codegen error: function needs more than %d registers\n", VM_MAX_REGISTERS);
+		exit(1);
+	}
+
+	int t = c->top++;
+	if (c->top > c->max_registers) {
+		c->max_registers = c->top;
+	}
+
+	return t;
+}
+
+// Parameters and locals keep the slot numbers of the frame layout
+int vm_register(struct vm_compiler* c, struct symbol* s) {
+
+	return s->which_total - 1;
+}
+
+// Returns the index of the new instruction
+int vm_emit(struct vm_compiler* c, vm_opcode_t op, int a, int b, int cc, long k) {
+
+	struct vm_insn insn = {op, a, b, cc, k};
+	vm_append(&c->insns, &insn, sizeof(insn));
+
+	return vm_here(c) - 1;
+}
+
+// Point the jump at index to target
+void vm_patch(struct vm_compiler* c, int jump, int target) {
+
+	((struct vm_insn*) c->insns.bytes)[jump].k = target;
+
+}
+
+int vm_here(struct vm_compiler* c) {
+
+	return c->insns.size / sizeof(struct vm_insn);
+}
+
+int vm_global(struct vm_compiler* c, const char* name) {
+
+	return (long) hash_table_lookup(c->global_index, name) - 1;
+}
+
+// Returns the offset of the decoded string in the image
+int vm_string(struct vm_compiler* c, const char* spelling) {
+
+	long offset = (long) hash_table_lookup(c->string_index, spelling);
+	if (offset) {
+		return offset - 1;
+	}
+
+	long length;
+	char* contents = expr_decode_string_spelling(spelling, &length);
+	offset = c->strings.size;
+	vm_append(&c->strings, contents, length + 1);
+	free(contents);
+
+	hash_table_insert(c->string_index, spelling, (void*) (offset + 1));
+	return offset;
+}
+
+// Words taken by an array of type t, one per element
+int vm_array_words(struct type* t, const char* name) {
+
+	if (!t->size || t->size->kind != EXPR_INTEGER_LITERAL) {
+		printf("codegen error: array %s must have constant size\n", name);
+		exit(1);
+	}
+
+	return t->size->literal_value;
+}
+
+void vm_append(struct vm_buffer* b, const void* data, int size) {
+
+	while(b->size + size > b->capacity) {
+		b->capacity = (b->capacity) ? b->capacity * 2 : 1024;
+		b->bytes = realloc(b->bytes, b->capacity);
+	}
+	memcpy(b->bytes + b->size, data, size);
+	b->size += size;
+
+}
+
+// Map the bytecode file at path
+// Returns 0 if path is not a bytecode file
+struct vm_program* vm_load(const char* path) {
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return 0;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) || st.st_size < (long) sizeof(struct vm_header)) {
+		close(fd);
+		return 0;
+	}
+
+	char* image = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (image == MAP_FAILED) {
+		return 0;
+	}
+
+	if (memcmp(image, "CMBC", 4)) {
+		munmap(image, st.st_size);
+		return 0;
+	}
+
+	return vm_open(image, st.st_size);
+}
+
+// Check the bytecode image and prepare it to run
+// Every table, operand and relocation is checked against the image, so a
+// damaged file stops here instead of reading or writing outside its frame
+struct vm_program* vm_open(const char* image, int size) {
+
+	const struct vm_header* h = (const struct vm_header*) image;
+
+	int valid = size >= (int) sizeof(*h) && !memcmp(h->magic, "CMBC", 4) && h->version == VM_VERSION && h->size == size;
+	valid = valid && h->num_functions > 0 && h->main_function >= 0 && h->main_function < h->num_functions;
+	valid = valid && h->num_insns > 0 && h->num_globals >= 0 && h->num_relocations >= 0 && h->string_bytes >= 0;
+	valid = valid && h->functions >= (int) sizeof(*h) && h->functions + (long) h->num_functions * sizeof(struct vm_function) <= size;
+	valid = valid && h->insns >= 0 && h->insns + (long) h->num_insns * sizeof(struct vm_insn) <= size;
+	valid = valid && h->globals >= 0 && h->globals + (long) h->num_globals * sizeof(int64_t) <= size;
+	valid = valid && h->relocations >= 0 && h->relocations + (long) h->num_relocations * sizeof(int32_t) <= size;
+	valid = valid && h->strings >= 0 && h->strings + (long) h->string_bytes <= size;
+	valid = valid && h->functions % 8 == 0 && h->insns % 8 == 0 && h->globals % 8 == 0 && h->relocations % 8 == 0;
+
+	// Strings end in a terminator, so any offset into them is a string
+	valid = valid && (!h->string_bytes || !image[h->strings + h->string_bytes - 1]);
+	if (!valid) {
+		vm_damaged();
+	}
+
+	struct vm_program* p = malloc(sizeof(struct vm_program));
+	p->header = h;
+	p->functions = (const struct vm_function*) (image + h->functions);
+	p->insns = (const struct vm_insn*) (image + h->insns);
+	p->strings = image + h->strings;
+
+	// Functions lie in order, each ending where the next begins
+	int i;
+	for(i = 0; i < h->num_functions; i++) {
+		const struct vm_function* f = &p->functions[i];
+		int last = (i + 1 < h->num_functions) ? p->functions[i + 1].entry : h->num_insns;
+		int fits = f->num_params >= 0 && f->num_registers >= f->num_params && f->array_words >= 0 && (long) f->num_registers + f->array_words <= VM_STACK_WORDS;
+		if ((!i && f->entry) || last <= f->entry || last > h->num_insns || !fits || f->name < 0 || f->name >= h->string_bytes) {
+			vm_damaged();
+		}
+
+		// Control may not run off the end into the next function
+		vm_opcode_t op = p->insns[last - 1].op;
+		if (op != VM_RET && op != VM_RETZ && op != VM_JMP) {
+			vm_damaged();
+		}
+
+		int j;
+		for(j = f->entry; j < last; j++) {
+			if (!vm_check_insn(p, f, last, &p->insns[j])) {
+				vm_damaged();
+			}
+		}
+	}
+
+	// Globals are the only part of the image the program changes
+	p->globals = malloc(sizeof(int64_t) * (h->num_globals + 1));
+	memcpy(p->globals, image + h->globals, sizeof(int64_t) * h->num_globals);
+
+	const int32_t* relocations = (const int32_t*) (image + h->relocations);
+	for(i = 0; i < h->num_relocations; i++) {
+		int32_t g = relocations[i];
+		if (g < 0 || g >= h->num_globals || p->globals[g] < 0 || p->globals[g] >= h->string_bytes) {
+			vm_damaged();
+		}
+		p->globals[g] += (int64_t) p->strings;
+	}
+
+	return p;
+}
+
+// Determine whether the operands of insn, in function f ending before
+// instruction last, stay within the frame of f and the tables of p
+int vm_check_insn(const struct vm_program* p, const struct vm_function* f, int last, const struct vm_insn* insn) {
+
+	const struct vm_header* h = p->header;
+	int registers = f->num_registers;
+	int a = insn->a < registers;
+	int ab = a && insn->b < registers;
+	int abc = ab && insn->c < registers;
+	int target = insn->k >= f->entry && insn->k < last;
+
+	switch(insn->op) {
+		case VM_MOV:
+		case VM_NEG:
+		case VM_NOT:
+		case VM_ADDI:
+			return ab;
+		case VM_LOADI:
+		case VM_RET:
+		case VM_PRINTI:
+		case VM_PRINTB:
+		case VM_PRINTC:
+		case VM_PRINTS:
+			return a;
+		case VM_LOADS:
+			return a && insn->k >= 0 && insn->k < h->string_bytes;
+		case VM_LOADG:
+		case VM_STOREG:
+		case VM_GADDR:
+			return a && insn->k >= 0 && insn->k < h->num_globals;
+		case VM_LADDR:
+			return a && insn->k >= 0 && insn->k < registers + f->array_words;
+		case VM_ADD:
+		case VM_SUB:
+		case VM_MUL:
+		case VM_DIV:
+		case VM_MOD:
+		case VM_POW:
+		case VM_AND:
+		case VM_OR:
+		case VM_LT:
+		case VM_LE:
+		case VM_GT:
+		case VM_GE:
+		case VM_EQ:
+		case VM_NE:
+		case VM_STREQ:
+		case VM_STRNE:
+		case VM_LOADX:
+		case VM_STOREX:
+			return abc;
+		case VM_COPY:
+			return ab && insn->k >= 0;
+		case VM_ZERO:
+			return a && insn->k >= 0;
+		case VM_JMP:
+			return target;
+		case VM_JZ:
+		case VM_JNZ:
+		case VM_JLTI:
+		case VM_JLEI:
+		case VM_JGTI:
+		case VM_JGEI:
+		case VM_JEQI:
+		case VM_JNEI:
+			return a && target;
+		case VM_JLT:
+		case VM_JLE:
+		case VM_JGT:
+		case VM_JGE:
+		case VM_JEQ:
+		case VM_JNE:
+			return ab && target;
+		case VM_CALL:
+			return a && insn->k >= 0 && insn->k < h->num_functions && insn->c == p->functions[insn->k].num_params && insn->b + insn->c <= registers;
+		case VM_CALLR:
+			return a && insn->k >= 0 && insn->k < vm_runtime_count && insn->c <= 2 && insn->b + insn->c <= registers;
+		case VM_RETZ:
+			return 1;
+		default:
+			return 0;
+	}
+
+}
+
+void vm_damaged() {
+
+	printf("Error: The bytecode is damaged or from another version. Exiting...\n");
+	exit(1);
+}
+
+// Returns 0 if the file could not be written
+int vm_write(const char* image, int size, const char* path) {
+
+	FILE* fp = fopen(path, "wb");
+	if (!fp) {
+		return 0;
+	}
+
+	int written = fwrite(image, 1, size, fp) == (size_t) size;
+	return !fclose(fp) && written;
+}
+
+// Run main with argc and argv and return what it returned
+long vm_execute(struct vm_program* p, int argc, char** argv) {
+
+	// Indexed by opcode
+	static void* dispatch[VM_OPCODES] = {
+		&&op_mov, &&op_loadi, &&op_loads, &&op_loadg, &&op_storeg, &&op_gaddr, &&op_laddr,
+		&&op_add, &&op_addi, &&op_sub, &&op_mul, &&op_div, &&op_mod, &&op_pow, &&op_neg, &&op_not, &&op_and, &&op_or,
+		&&op_lt, &&op_le, &&op_gt, &&op_ge, &&op_eq, &&op_ne, &&op_streq, &&op_strne,
+		&&op_loadx, &&op_storex, &&op_copy, &&op_zero,
+		&&op_jmp, &&op_jz, &&op_jnz, &&op_jlt, &&op_jle, &&op_jgt, &&op_jge, &&op_jeq, &&op_jne,
+		&&op_jlti, &&op_jlei, &&op_jgti, &&op_jgei, &&op_jeqi, &&op_jnei,
+		&&op_call, &&op_callr, &&op_ret, &&op_retz,
+		&&op_printi, &&op_printb, &&op_printc, &&op_prints
+	};
+
+	const struct vm_insn* insns = p->insns;
+	const struct vm_function* functions = p->functions;
+	int64_t* globals = p->globals;
+
+	int64_t* stack = malloc(sizeof(int64_t) * VM_STACK_WORDS);
+	int64_t* end = stack + VM_STACK_WORDS;
+	struct vm_frame* frames = malloc(sizeof(struct vm_frame) * VM_MAX_DEPTH);
+	int depth = 0;
+
+	const struct vm_function* f = &functions[p->header->main_function];
+	int64_t* r = stack;
+	int64_t* top = r + f->num_registers + f->array_words;
+	if (top > end) {
+		printf("Error: Stack overflow. Exiting...\n");
+		exit(1);
+	}
+	memset(r, 0, sizeof(int64_t) * f->num_registers);
+	if (f->num_params > 0) {
+		r[0] = argc;
+	}
+	if (f->num_params > 1) {
+		r[1] = (int64_t) argv;
+	}
+
+	const struct vm_insn* pc = insns + f->entry;
+	int64_t result;
+
+	#define DISPATCH() goto *dispatch[pc->op]
+	#define NEXT() pc++; DISPATCH()
+	#define BRANCH(condition) if (condition) { pc = insns + pc->k; DISPATCH(); } NEXT()
+
+	DISPATCH();
+
+op_mov:
+	r[pc->a] = r[pc->b];
+	NEXT();
+op_loadi:
+	r[pc->a] = pc->k;
+	NEXT();
+op_loads:
+	r[pc->a] = (int64_t) (p->strings + pc->k);
+	NEXT();
+op_loadg:
+	r[pc->a] = globals[pc->k];
+	NEXT();
+op_storeg:
+	globals[pc->k] = r[pc->a];
+	NEXT();
+op_gaddr:
+	r[pc->a] = (int64_t) (globals + pc->k);
+	NEXT();
+op_laddr:
+	r[pc->a] = (int64_t) (r + pc->k);
+	NEXT();
+op_add:
+	r[pc->a] = (int64_t) ((uint64_t) r[pc->b] + (uint64_t) r[pc->c]);
+	NEXT();
+op_addi:
+	r[pc->a] = (int64_t) ((uint64_t) r[pc->b] + (uint64_t) (int64_t) pc->k);
+	NEXT();
+op_sub:
+	r[pc->a] = (int64_t) ((uint64_t) r[pc->b] - (uint64_t) r[pc->c]);
+	NEXT();
+op_mul:
+	r[pc->a] = (int64_t) ((uint64_t) r[pc->b] * (uint64_t) r[pc->c]);
+	NEXT();
+op_div:
+	r[pc->a] = r[pc->b] / r[pc->c];
+	NEXT();
+op_mod:
+	r[pc->a] = r[pc->b] % r[pc->c];
+	NEXT();
+op_pow:
+	r[pc->a] = integer_power(r[pc->b], r[pc->c]);
+	NEXT();
+op_neg:
+	r[pc->a] = (int64_t) (0 - (uint64_t) r[pc->b]);
+	NEXT();
+op_not:
+	r[pc->a] = r[pc->b] ^ 1;
+	NEXT();
+op_and:
+	r[pc->a] = r[pc->b] & r[pc->c];
+	NEXT();
+op_or:
+	r[pc->a] = r[pc->b] | r[pc->c];
+	NEXT();
+op_lt:
+	r[pc->a] = r[pc->b] < r[pc->c];
+	NEXT();
+op_le:
+	r[pc->a] = r[pc->b] <= r[pc->c];
+	NEXT();
+op_gt:
+	r[pc->a] = r[pc->b] > r[pc->c];
+	NEXT();
+op_ge:
+	r[pc->a] = r[pc->b] >= r[pc->c];
+	NEXT();
+op_eq:
+	r[pc->a] = r[pc->b] == r[pc->c];
+	NEXT();
+op_ne:
+	r[pc->a] = r[pc->b] != r[pc->c];
+	NEXT();
+op_streq:
+	r[pc->a] = string_equals((const char*) r[pc->b], (const char*) r[pc->c]);
+	NEXT();
+op_strne:
+	r[pc->a] = !string_equals((const char*) r[pc->b], (const char*) r[pc->c]);
+	NEXT();
+op_loadx:
+	r[pc->a] = ((int64_t*) r[pc->b])[r[pc->c]];
+	NEXT();
+op_storex:
+	((int64_t*) r[pc->a])[r[pc->b]] = r[pc->c];
+	NEXT();
+op_copy:
+	memmove((int64_t*) r[pc->a], (int64_t*) r[pc->b], sizeof(int64_t) * pc->k);
+	NEXT();
+op_zero:
+	memset((int64_t*) r[pc->a], 0, sizeof(int64_t) * pc->k);
+	NEXT();
+op_jmp:
+	pc = insns + pc->k;
+	DISPATCH();
+op_jz:
+	BRANCH(!r[pc->a]);
+op_jnz:
+	BRANCH(r[pc->a]);
+op_jlt:
+	BRANCH(r[pc->a] < r[pc->b]);
+op_jle:
+	BRANCH(r[pc->a] <= r[pc->b]);
+op_jgt:
+	BRANCH(r[pc->a] > r[pc->b]);
+op_jge:
+	BRANCH(r[pc->a] >= r[pc->b]);
+op_jeq:
+	BRANCH(r[pc->a] == r[pc->b]);
+op_jne:
+	BRANCH(r[pc->a] != r[pc->b]);
+op_jlti:
+	BRANCH(r[pc->a] < (int16_t) pc->b);
+op_jlei:
+	BRANCH(r[pc->a] <= (int16_t) pc->b);
+op_jgti:
+	BRANCH(r[pc->a] > (int16_t) pc->b);
+op_jgei:
+	BRANCH(r[pc->a] >= (int16_t) pc->b);
+op_jeqi:
+	BRANCH(r[pc->a] == (int16_t) pc->b);
+op_jnei:
+	BRANCH(r[pc->a] != (int16_t) pc->b);
+op_call:
+	;
+	const struct vm_function* callee = &functions[pc->k];
+	int64_t* callee_registers = top;
+	int64_t* callee_top = top + callee->num_registers + callee->array_words;
+	if (callee_top > end || depth == VM_MAX_DEPTH) {
+		printf("Error: Stack overflow. Exiting...\n");
+		exit(1);
+	}
+
+	int i;
+	for(i = 0; i < pc->c; i++) {
+		callee_registers[i] = r[pc->b + i];
+	}
+	memset(callee_registers + pc->c, 0, sizeof(int64_t) * (callee->num_registers - pc->c));
+
+	frames[depth].pc = pc + 1;
+	frames[depth].registers = r;
+	frames[depth].top = top;
+	frames[depth].dest = pc->a;
+	depth++;
+
+	r = callee_registers;
+	top = callee_top;
+	pc = insns + callee->entry;
+	DISPATCH();
+op_callr:
+	r[pc->a] = vm_runtime[pc->k].address((pc->c > 0) ? r[pc->b] : 0, (pc->c > 1) ? r[pc->b + 1] : 0);
+	NEXT();
+op_ret:
+	result = r[pc->a];
+	goto done;
+op_retz:
+	result = 0;
+	goto done;
+op_printi:
+	print_integer(r[pc->a]);
+	NEXT();
+op_printb:
+	print_boolean(r[pc->a]);
+	NEXT();
+op_printc:
+	print_character(r[pc->a]);
+	NEXT();
+op_prints:
+	print_string((const char*) r[pc->a]);
+	NEXT();
+
+done:
+	if (depth) {
+		depth--;
+		pc = frames[depth].pc;
+		r = frames[depth].registers;
+		top = frames[depth].top;
+		r[frames[depth].dest] = result;
+		DISPATCH();
+	}
+
+	#undef DISPATCH
+	#undef NEXT
+	#undef BRANCH
+
+	fflush(stdout);
+	free(stack);
+	free(frames);
+
+	return result;
+}
@@ -0,0 +1,192 @@
+// vm.h
+// Header file for the bytecode interpreter, which compiles the typed program
+// to instructions over virtual registers and runs them without an assembler,
+// linker or executable
+
+#ifndef VM_H
+#define VM_H
+
+#include "decl.h"
+#include "stmt.h"
+#include "expr.h"
+#include "hash_table.h"
+#include <stdint.h>
+
+typedef enum {
+	VM_MOV,      // a = b
+	VM_LOADI,    // a = k
+	VM_LOADS,    // a = address of the string at offset k
+	VM_LOADG,    // a = globals[k]
+	VM_STOREG,   // globals[k] = a
+	VM_GADDR,    // a = address of globals[k]
+	VM_LADDR,    // a = address of frame word k
+	VM_ADD,      // a = b + c
+	VM_ADDI,     // a = b + k
+	VM_SUB,
+	VM_MUL,
+	VM_DIV,
+	VM_MOD,
+	VM_POW,
+	VM_NEG,      // a = -b
+	VM_NOT,      // a = b ^ 1
+	VM_AND,
+	VM_OR,
+	VM_LT,       // a = b < c
+	VM_LE,
+	VM_GT,
+	VM_GE,
+	VM_EQ,
+	VM_NE,
+	VM_STREQ,    // a = the strings b and c are equal
+	VM_STRNE,
+	VM_LOADX,    // a = b[c]
+	VM_STOREX,   // a[b] = c
+	VM_COPY,     // copy k words from b to a
+	VM_ZERO,     // clear k words at a
+	VM_JMP,      // go to k
+	VM_JZ,       // go to k if a is 0
+	VM_JNZ,      // go to k if a is not 0
+	VM_JLT,      // go to k if a < b
+	VM_JLE,
+	VM_JGT,
+	VM_JGE,
+	VM_JEQ,
+	VM_JNE,
+	VM_JLTI,     // go to k if a < b, with b read as a signed 16 bit constant
+	VM_JLEI,
+	VM_JGTI,
+	VM_JGEI,
+	VM_JEQI,
+	VM_JNEI,
+	VM_CALL,     // a = functions[k] called with the c registers from b
+	VM_CALLR,    // a = runtime function k called with the c registers from b
+	VM_RET,      // return a
+	VM_RETZ,     // return 0
+	VM_PRINTI,
+	VM_PRINTB,
+	VM_PRINTC,
+	VM_PRINTS,
+	VM_OPCODES
+} vm_opcode_t;
+
+// One instruction, with registers a to c and a 32 bit operand k, which
+// holds constants, jump targets and table indices
+struct vm_insn {
+	uint16_t op;
+	uint16_t a;
+	uint16_t b;
+	uint16_t c;
+	int32_t k;
+};
+
+// Registers start with the parameters, then the frame slots of the locals,
+// then temporaries. Local arrays follow the registers in the frame.
+struct vm_function {
+	int32_t entry;
+	int32_t num_params;
+	int32_t num_registers;
+	int32_t array_words;
+	int32_t name;
+};
+
+// Layout of a bytecode file, with every table at a byte offset from the start
+// Global words listed in the relocations hold string offsets to turn into
+// addresses when the file is loaded
+struct vm_header {
+	char magic[4];
+	int32_t version;
+	int32_t main_function;
+	int32_t num_functions;
+	int32_t num_insns;
+	int32_t num_globals;
+	int32_t num_relocations;
+	int32_t string_bytes;
+	int32_t functions;
+	int32_t insns;
+	int32_t globals;
+	int32_t relocations;
+	int32_t strings;
+	int32_t size;
+};
+
+// A program ready to run, pointing into a bytecode image
+struct vm_program {
+	const struct vm_header* header;
+	const struct vm_function* functions;
+	const struct vm_insn* insns;
+	const char* strings;
+	int64_t* globals;
+};
+
+struct vm_buffer {
+	char* bytes;
+	int size;
+	int capacity;
+};
+
+// Frame of a function being compiled
+struct vm_compiler {
+	struct vm_buffer insns;
+	struct vm_buffer strings;
+	struct vm_buffer functions;
+	struct vm_buffer globals;
+	struct vm_buffer relocations;
+	struct hash_table* global_index;
+	struct hash_table* function_index;
+	struct hash_table* string_index;
+	int registers;
+	int top;
+	int max_registers;
+	int array_words;
+	struct vm_buffer frame_addresses;
+};
+
+// A function of the runtime library that programs may declare and call,
+// taking at most two words
+struct vm_binding {
+	const char* name;
+	long (*address)(long, long);
+};
+
+// Call made by the interpreter, to return to
+struct vm_frame {
+	const struct vm_insn* pc;
+	int64_t* registers;
+	int64_t* top;
+	int dest;
+};
+
+char* vm_compile(struct decl* program, int* size);
+void vm_compile_globals(struct vm_compiler* c, struct decl* d);
+void vm_compile_function(struct vm_compiler* c, struct decl* f);
+void vm_compile_stmt(struct vm_compiler* c, struct stmt* s);
+void vm_compile_decl(struct vm_compiler* c, struct decl* d);
+int vm_compile_expr(struct vm_compiler* c, struct expr* e);
+void vm_compile_effect(struct vm_compiler* c, struct expr* e);
+int vm_compile_branch(struct vm_compiler* c, struct expr* e);
+int vm_compile_assign(struct vm_compiler* c, struct expr* e);
+int vm_compile_step(struct vm_compiler* c, struct expr* e, int value);
+int vm_compile_call(struct vm_compiler* c, struct expr* e);
+int vm_lookup_runtime(const char* name);
+int vm_operand(struct vm_compiler* c, struct expr* e, struct expr* later);
+int vm_writes_locals(struct expr* e);
+int vm_is_string(struct expr* e);
+int vm_is_small_literal(struct expr* e);
+int vm_temporary(struct vm_compiler* c);
+int vm_register(struct vm_compiler* c, struct symbol* s);
+int vm_emit(struct vm_compiler* c, vm_opcode_t op, int a, int b, int cc, long k);
+void vm_patch(struct vm_compiler* c, int jump, int target);
+int vm_here(struct vm_compiler* c);
+int vm_global(struct vm_compiler* c, const char* name);
+int vm_string(struct vm_compiler* c, const char* spelling);
+int vm_array_words(struct type* t, const char* name);
+void vm_append(struct vm_buffer* b, const void* data, int size);
+
+struct vm_program* vm_load(const char* path);
+struct vm_program* vm_open(const char* image, int size);
+int vm_check_insn(const struct vm_program* p, const struct vm_function* f, int last, const struct vm_insn* insn);
+void vm_damaged();
+int vm_write(const char* image, int size, const char* path);
+long vm_execute(struct vm_program* p, int argc, char** argv);
+
+#endif